@@ -315,6 +315,8 @@ HEADERS += \
     src/crypto/argon2d/core.h \
     src/crypto/argon2d/encoding.h \
     src/crypto/argon2d/thread.h \
+    src/crypto/argon2d_arena.h \
+    src/crypto/argon2d_dispatch.h \
     src/crypto/blake2/blake2-impl.h \
     src/crypto/blake2/blake2.h \
     src/crypto/blake2/blamka-round-opt.h \
@@ -501,6 +503,8 @@ SOURCES += \
     src/crypto/argon2d/encoding.c \
     src/crypto/argon2d/opt.c \
     src/crypto/argon2d/thread.c \
+    src/crypto/argon2d_arena.cpp \
+    src/crypto/argon2d_dispatch.cpp \
     src/crypto/blake2/blake2b.c \
     src/policy/fees.cpp \
     src/policy/policy.cpp \
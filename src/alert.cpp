@@ -134,7 +134,7 @@ bool CAlert::RelayTo(CNode* pnode, CConnman& connman) const
     if (pnode->nVersion == 0)
         return false;
     // returns true if wasn't already contained in the set
-    if (pnode->setKnown.insert(GetHash()).second) {
+    if (pnode->AddKnown(GetHash())) {
         if (AppliesTo(pnode->nVersion, pnode->strSubVer) ||
             AppliesToMe() ||
             GetAdjustedTime() < nRelayUntil) {
@@ -45,120 +45,156 @@ bool UndoAddAudit(const CAudit& audit)
     return pAuditDB->EraseAuditTxId(vchFromString(audit.txHash.ToString()));
 }
 
+// Owner and audit hash indexes, one key per audit transaction:
+// ("mi", (owner full path, txid)) -> empty
+// ("ai", (audit hash, txid)) -> empty
+// They replace the "mn" and "audit" records that kept every txid of an
+// owner or hash in one vector.
+typedef std::pair<CharString, CharString> AuditIndexPos;
+typedef std::pair<std::string, AuditIndexPos> AuditIndexKey;
+
+static const std::string AUDIT_OWNER_INDEX_KEY = "mi";
+static const std::string AUDIT_HASH_INDEX_KEY = "ai";
+static const std::string AUDIT_INDEX_VERSION_KEY = "aiversion";
+static const int AUDIT_INDEX_VERSION = 1;
+// Bytes of index records written at once while converting the old records
+static const size_t AUDIT_INDEX_BATCH_SIZE = 16 << 20;
+
 bool CAuditDB::AddAudit(const CAudit& audit) 
 { 
-    bool writeState = false;
-    bool writeStateMN = false;
-    bool auditHashWriteState = true;
-    {
-        LOCK(cs_bdap_audit);
-        CAuditData auditData = audit.GetAuditData();
-        for(const std::vector<unsigned char>& vchAuditHash : auditData.vAuditData) {
-            std::vector<std::vector<unsigned char>> vvTxHash;
-            CDBWrapper::Read(make_pair(std::string("audit"), vchAuditHash), vvTxHash);
-            vvTxHash.push_back(vchFromString(audit.txHash.ToString()));
-            // each hash points to a txid. The txid record stores the audit record.
-            if (!Write(make_pair(std::string("audit"), vchAuditHash), vvTxHash)) {
-                auditHashWriteState = false;
-            }
-        }
-        if (audit.vchOwnerFullObjectPath.size() > 0) {
-            std::vector<std::vector<unsigned char>> vvTxId;
-            CDBWrapper::Read(make_pair(std::string("mn"), audit.vchOwnerFullObjectPath), vvTxId);
-            vvTxId.push_back(vchFromString(audit.txHash.ToString()));
-
-            writeStateMN = Write(make_pair(std::string("mn"), audit.vchOwnerFullObjectPath), vvTxId);
-        }
-        else {
-            writeStateMN = true;
-        }
-        writeState = Write(make_pair(std::string("txid"), vchFromString(audit.txHash.ToString())), audit);
-    }
-
-    return writeState && auditHashWriteState && writeStateMN;
+    LOCK(cs_bdap_audit);
+    // each hash points to a txid. The txid record stores the audit record.
+    const CharString vchTxId = vchFromString(audit.txHash.ToString());
+    CBDAPDBBatch batch;
+    CAuditData auditData = audit.GetAuditData();
+    for (const std::vector<unsigned char>& vchAuditHash : auditData.vAuditData)
+        batch.Write(make_pair(AUDIT_HASH_INDEX_KEY, make_pair(vchAuditHash, vchTxId)), CharString());
+    if (audit.vchOwnerFullObjectPath.size() > 0)
+        batch.Write(make_pair(AUDIT_OWNER_INDEX_KEY, make_pair(audit.vchOwnerFullObjectPath, vchTxId)), CharString());
+    batch.Write(make_pair(std::string("txid"), vchTxId), audit);
+    return WriteBatch(batch);
 }
 
 bool CAuditDB::ReadAuditTxId(const std::vector<unsigned char>& vchTxId, CAudit& audit) 
 {
     LOCK(cs_bdap_audit);
-    return CDBWrapper::Read(make_pair(std::string("txid"), vchTxId), audit);
+    return Read(make_pair(std::string("txid"), vchTxId), audit);
 }
 
-bool CAuditDB::ReadAuditMN(const std::vector<unsigned char>& vchOwnerFullObjectPath, std::vector<CAudit>& vAudits) 
+// Reads the audits of one owner or hash, skipping nOffset of them and
+// returning at most nLimit, in txid order.
+bool CAuditDB::ReadAuditIndex(const std::string& strIndexKey, const std::vector<unsigned char>& vchIndexValue, std::vector<CAudit>& vAudits, unsigned int nOffset, unsigned int nLimit)
 {
     LOCK(cs_bdap_audit);
-    std::vector<std::vector<unsigned char>> vvTxId;
-    bool readState = false;
-    readState = CDBWrapper::Read(make_pair(std::string("mn"), vchOwnerFullObjectPath), vvTxId);
-
-    if (readState) {
-        for (const std::vector<unsigned char>& vchTxId : vvTxId) {
+    AuditIndexKey key;
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(make_pair(strIndexKey, vchIndexValue));
+    while (pcursor->Valid() && vAudits.size() < nLimit) {
+        boost::this_thread::interruption_point();
+        if (!pcursor->GetKey(key) || key.first != strIndexKey || key.second.first != vchIndexValue)
+            break;
+        if (nOffset > 0) {
+            nOffset--;
+        } else {
             CAudit audit;
-            if (ReadAuditTxId(vchTxId, audit)) {
+            if (ReadAuditTxId(key.second.second, audit))
                 vAudits.push_back(audit);
-            }
         }
+        pcursor->Next();
     }
-
     return (vAudits.size() > 0);
 }
 
-bool CAuditDB::ReadAuditHash(const std::vector<unsigned char>& vchAudit, std::vector<CAudit>& vAudits) 
+bool CAuditDB::ReadAuditMN(const std::vector<unsigned char>& vchOwnerFullObjectPath, std::vector<CAudit>& vAudits, const unsigned int nOffset, const unsigned int nLimit)
 {
-    LOCK(cs_bdap_audit);
-    std::vector<std::vector<unsigned char>> vvTxId;
-    bool readState = false;
-    readState = CDBWrapper::Read(make_pair(std::string("audit"), vchAudit), vvTxId);
-
-    if (readState) {
-        for (const std::vector<unsigned char>& vchTxId : vvTxId) {
-            CAudit audit;
-            if (ReadAuditTxId(vchTxId, audit)) {
-                vAudits.push_back(audit);
-            }
-        }
-    }
+    return ReadAuditIndex(AUDIT_OWNER_INDEX_KEY, vchOwnerFullObjectPath, vAudits, nOffset, nLimit);
+}
 
-    return (vAudits.size() > 0);
+bool CAuditDB::ReadAuditHash(const std::vector<unsigned char>& vchAudit, std::vector<CAudit>& vAudits, const unsigned int nOffset, const unsigned int nLimit)
+{
+    return ReadAuditIndex(AUDIT_HASH_INDEX_KEY, vchAudit, vAudits, nOffset, nLimit);
 }
 
 bool CAuditDB::AuditExists(const std::vector<unsigned char>& vchAudit)
 {
     LOCK(cs_bdap_audit);
-    return CDBWrapper::Exists(make_pair(std::string("audit"), vchAudit));
+    AuditIndexKey key;
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(make_pair(AUDIT_HASH_INDEX_KEY, vchAudit));
+    return pcursor->Valid() && pcursor->GetKey(key) && key.first == AUDIT_HASH_INDEX_KEY && key.second.first == vchAudit;
 }
 
 bool CAuditDB::EraseAuditTxId(const std::vector<unsigned char>& vchTxId)
 {
     LOCK(cs_bdap_audit);
+    CBDAPDBBatch batch;
     CAudit audit;
     if (ReadAuditTxId(vchTxId, audit)) {
         for(const std::vector<unsigned char>& vchAudit : audit.GetAudits())
-            CDBWrapper::Erase(make_pair(std::string("audit"), vchAudit));
-    }
-    if (audit.vchOwnerFullObjectPath.size() > 0) {
-        std::vector<std::vector<unsigned char>> vvTxId;
-        CDBWrapper::Read(make_pair(std::string("mn"), audit.vchOwnerFullObjectPath), vvTxId);
-        if (vvTxId.size() == 1 && vvTxId[0] == vchTxId) {
-            CDBWrapper::Erase(make_pair(std::string("mn"), audit.vchOwnerFullObjectPath));
-        }
-        else {
-            std::vector<std::vector<unsigned char>> vvTxIdNew;
-            for (const std::vector<unsigned char>& txid : vvTxId) {
-                if (txid != vchTxId) {
-                    vvTxIdNew.push_back(txid);
-                }
-            }
-            Write(make_pair(std::string("mn"), audit.vchOwnerFullObjectPath), vvTxIdNew);
-        }
+            batch.Erase(make_pair(AUDIT_HASH_INDEX_KEY, make_pair(vchAudit, vchTxId)));
+        if (audit.vchOwnerFullObjectPath.size() > 0)
+            batch.Erase(make_pair(AUDIT_OWNER_INDEX_KEY, make_pair(audit.vchOwnerFullObjectPath, vchTxId)));
     }
-    return CDBWrapper::Erase(make_pair(std::string("txid"), vchTxId));
+    batch.Erase(make_pair(std::string("txid"), vchTxId));
+    return WriteBatch(batch);
 }
 
 bool CAuditDB::EraseAudit(const std::vector<unsigned char>& vchAudit)
 {
     LOCK(cs_bdap_audit);
-    return CDBWrapper::Erase(make_pair(std::string("audit"), vchAudit));
+    CBDAPDBBatch batch;
+    AuditIndexKey key;
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(make_pair(AUDIT_HASH_INDEX_KEY, vchAudit));
+    while (pcursor->Valid()) {
+        if (!pcursor->GetKey(key) || key.first != AUDIT_HASH_INDEX_KEY || key.second.first != vchAudit)
+            break;
+        batch.Erase(key);
+        pcursor->Next();
+    }
+    return WriteBatch(batch);
+}
+
+// Converts the vector-valued "mn" and "audit" records into per-txid index keys
+bool CAuditDB::UpgradeAuditIndex()
+{
+    LOCK(cs_bdap_audit);
+    int nVersion = 0;
+    if (Read(AUDIT_INDEX_VERSION_KEY, nVersion) && nVersion >= AUDIT_INDEX_VERSION)
+        return true;
+
+    LogPrintf("CAuditDB::%s -- Building BDAP audit indexes\n", __func__);
+    int nConverted = 0;
+    CBDAPDBBatch batch;
+    const std::vector<std::pair<std::string, std::string> > vLegacy = {{"mn", AUDIT_OWNER_INDEX_KEY}, {"audit", AUDIT_HASH_INDEX_KEY}};
+    for (const std::pair<std::string, std::string>& legacy : vLegacy) {
+        std::pair<std::string, CharString> key;
+        std::unique_ptr<CDBIterator> pcursor(NewIterator());
+        pcursor->Seek(legacy.first);
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            if (!pcursor->GetKey(key) || key.first != legacy.first)
+                break;
+            std::vector<std::vector<unsigned char>> vvTxId;
+            if (!pcursor->GetValue(vvTxId))
+                return error("%s() : deserialize error", __PRETTY_FUNCTION__);
+            for (const std::vector<unsigned char>& vchTxId : vvTxId)
+                batch.Write(make_pair(legacy.second, make_pair(key.second, vchTxId)), CharString());
+            batch.Erase(key);
+            nConverted++;
+            if (batch.SizeEstimate() > AUDIT_INDEX_BATCH_SIZE) {
+                WriteBatch(batch);
+                batch.Clear();
+            }
+            pcursor->Next();
+        }
+    }
+    batch.Write(AUDIT_INDEX_VERSION_KEY, AUDIT_INDEX_VERSION);
+    if (!WriteBatch(batch, true))
+        return error("%s() : failed to write audit indexes", __PRETTY_FUNCTION__);
+
+    LogPrintf("CAuditDB::%s -- Converted %d BDAP audit index records\n", __func__, nConverted);
+    return true;
 }
 
 bool CheckAuditDB()
@@ -241,16 +277,9 @@ static bool CommonDataCheck(const CAudit& audit, const vchCharString& vvchOpPara
     return true;
 }
 
-static bool CheckNewAuditTxInputs(const CAudit& audit, const CScript& scriptOp, const vchCharString& vvchOpParameters, const uint256& txHash,
-                               std::string& errorMessage, bool fJustCheck)
+// Checks the signature of an audit that requires one against the wallet address of its owner account
+static bool CheckAuditSignature(const CAudit& audit, const vchCharString& vvchOpParameters, std::string& errorMessage)
 {
-    if (!CommonDataCheck(audit, vvchOpParameters, errorMessage))
-        return error(errorMessage.c_str());
-
-    if (fJustCheck)
-        return true;
-
-    // check audit signature if required.
     if (audit.SignatureRequired()) {
         if (!audit.IsSigned()) {
             errorMessage = "CheckNewAuditTxInputs: - The audit requires a signature.  Add new audit failed!";
@@ -283,6 +312,21 @@ static bool CheckNewAuditTxInputs(const CAudit& audit, const CScript& scriptOp,
         }
 
     }
+    return true;
+}
+
+static bool CheckNewAuditTxInputs(const CAudit& audit, const CScript& scriptOp, const vchCharString& vvchOpParameters, const uint256& txHash,
+                               std::string& errorMessage, bool fJustCheck, bool fPreChecked)
+{
+    if (!CommonDataCheck(audit, vvchOpParameters, errorMessage))
+        return error(errorMessage.c_str());
+
+    if (fJustCheck)
+        return true;
+
+    // check audit signature if required.
+    if (!fPreChecked && !CheckAuditSignature(audit, vvchOpParameters, errorMessage))
+        return false;
 
     CAudit getAudit;
     if (GetAuditTxId(audit.txHash.ToString(), getAudit)) {
@@ -309,7 +353,7 @@ static bool CheckNewAuditTxInputs(const CAudit& audit, const CScript& scriptOp,
 }
 
 bool CheckAuditTx(const CTransactionRef& tx, const CScript& scriptOp, const int& op1, const int& op2, const std::vector<std::vector<unsigned char> >& vvchArgs, 
-                                const bool fJustCheck, const int& nHeight, const uint32_t& nBlockTime, const bool bSanityCheck, std::string& errorMessage) 
+                                const bool fJustCheck, const int& nHeight, const uint32_t& nBlockTime, const bool bSanityCheck, std::string& errorMessage, const bool fPreChecked) 
 {
     if (tx->IsCoinBase() && !fJustCheck && !bSanityCheck) {
         LogPrintf("*Trying to add BDAP audit in coinbase transaction, skipping...");
@@ -376,8 +420,28 @@ bool CheckAuditTx(const CTransactionRef& tx, const CScript& scriptOp, const int&
                                     FormatMoney(opAmount), FormatMoney(depositFee));
         }
 
-        return CheckNewAuditTxInputs(audit, scriptOp, vvchArgs, tx->GetHash(), errorMessage, fJustCheck);
+        return CheckNewAuditTxInputs(audit, scriptOp, vvchArgs, tx->GetHash(), errorMessage, fJustCheck, fPreChecked);
     }
 
     return false;
 }
+
+bool PreCheckAuditTx(const CTransactionRef& tx, const std::vector<std::vector<unsigned char> >& vvchArgs, const int& nHeight,
+                                std::vector<std::vector<unsigned char> >& vvchObjectPaths, std::string& errorMessage)
+{
+    CAudit audit;
+    std::vector<unsigned char> vchData;
+    std::vector<unsigned char> vchHash;
+    int nDataOut;
+    bool bData = GetBDAPData(tx, vchData, vchHash, nDataOut);
+    if(bData && !audit.UnserializeFromTx(tx, nHeight))
+    {
+        errorMessage = ("UnserializeFromData data in tx failed!");
+        return false;
+    }
+    if (!CommonDataCheck(audit, vvchArgs, errorMessage))
+        return false;
+
+    vvchObjectPaths.push_back(audit.vchOwnerFullObjectPath);
+    return CheckAuditSignature(audit, vvchArgs, errorMessage);
+}
@@ -6,26 +6,32 @@
 #define CASH_BDAP_AUDITDB_H
 
 #include "bdap/audit.h"
-#include "dbwrapper.h"
+#include "bdap/bdapdb.h"
 #include "sync.h"
 
+#include <limits>
+
 class CCoinsViewCache;
 class UniValue;
 
 static CCriticalSection cs_bdap_audit;
 
-class CAuditDB : public CDBWrapper {
+class CAuditDB : public CBDAPDB {
 public:
-    CAuditDB(size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate) : CDBWrapper(GetDataDir() / "blocks" / "bdap-audits", nCacheSize, fMemory, fWipe, obfuscate) {
+    CAuditDB(size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate) : CBDAPDB(GetDataDir() / "blocks" / "bdap-audits", nCacheSize, fMemory, fWipe, obfuscate) {
     }
     bool AddAudit(const CAudit& audit);
     bool ReadAudit(const std::vector<unsigned char>& vchAudit, CAudit& audit);
     bool ReadAuditTxId(const std::vector<unsigned char>& vchTxId, CAudit& audit);
-    bool ReadAuditMN(const std::vector<unsigned char>& vchOwnerFullObjectPath, std::vector<CAudit>& vAudits);
-    bool ReadAuditHash(const std::vector<unsigned char>& vchAudit, std::vector<CAudit>& vAudits);
+    bool ReadAuditMN(const std::vector<unsigned char>& vchOwnerFullObjectPath, std::vector<CAudit>& vAudits, const unsigned int nOffset = 0, const unsigned int nLimit = std::numeric_limits<unsigned int>::max());
+    bool ReadAuditHash(const std::vector<unsigned char>& vchAudit, std::vector<CAudit>& vAudits, const unsigned int nOffset = 0, const unsigned int nLimit = std::numeric_limits<unsigned int>::max());
     bool EraseAuditTxId(const std::vector<unsigned char>& vchTxId);
     bool EraseAudit(const std::vector<unsigned char>& vchAudit);
     bool AuditExists(const std::vector<unsigned char>& vchAudit);
+    bool UpgradeAuditIndex();
+
+private:
+    bool ReadAuditIndex(const std::string& strIndexKey, const std::vector<unsigned char>& vchIndexValue, std::vector<CAudit>& vAudits, unsigned int nOffset, unsigned int nLimit);
 };
 
 bool GetAuditTxId(const std::string& strTxId, CAudit& audit);
@@ -34,7 +40,14 @@ bool UndoAddAudit(const CAudit& audit);
 bool CheckAuditDB();
 bool FlushAuditLevelDB();
 bool CheckAuditTx(const CTransactionRef& tx, const CScript& scriptOp, const int& op1, const int& op2, const std::vector<std::vector<unsigned char> >& vvchArgs, 
-                                const bool fJustCheck, const int& nHeight, const uint32_t& nBlockTime, const bool bSanityCheck, std::string& errorMessage);
+                                const bool fJustCheck, const int& nHeight, const uint32_t& nBlockTime, const bool bSanityCheck, std::string& errorMessage, const bool fPreChecked = false);
+/**
+ * Checks the owner signature of a new audit without changing any database, so
+ * it can run on several threads. vvchObjectPaths returns the accounts it read.
+ * CheckAuditTx skips this check when fPreChecked is set.
+ */
+bool PreCheckAuditTx(const CTransactionRef& tx, const std::vector<std::vector<unsigned char> >& vvchArgs, const int& nHeight,
+                                std::vector<std::vector<unsigned char> >& vvchObjectPaths, std::string& errorMessage);
 
 extern CAuditDB *pAuditDB;
 
@@ -0,0 +1,267 @@
+// Copyright (c) 2019-2021 Duality Blockchain Solutions Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bdap/bdapdb.h"
+
+/** A block height serialized big-endian, so undo records sort by height */
+struct CUndoHeight {
+    uint32_t nHeight;
+
+    explicit CUndoHeight(uint32_t nHeightIn = 0) : nHeight(nHeightIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata32be(s, nHeight);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        nHeight = ser_readdata32be(s);
+    }
+};
+
+// Undo record of a block: ("blockundo", (height, block hash)) -> CBDAPBlockUndo
+// Redo record of a disconnected block: ("blockredo", (height, block hash)) -> CBDAPBlockRedo
+typedef std::pair<std::string, std::pair<CUndoHeight, uint256> > UndoKey;
+
+static const std::string UNDO_KEY = "blockundo";
+static const std::string REDO_KEY = "blockredo";
+
+static UndoKey GetUndoKey(const CBDAPBlock& block)
+{
+    return std::make_pair(UNDO_KEY, std::make_pair(CUndoHeight(block.nHeight), block.hash));
+}
+
+static UndoKey GetRedoKey(const CBDAPBlock& block)
+{
+    return std::make_pair(REDO_KEY, std::make_pair(CUndoHeight(block.nHeight), block.hash));
+}
+
+// Best block: "bestblock" -> CBDAPBlock
+static const std::string BEST_BLOCK_KEY = "bestblock";
+
+static void WriteChanges(CDBBatch& batch, const BDAPDBChanges& changes)
+{
+    for (const BDAPDBChanges::value_type& change : changes) {
+        if (change.second.first)
+            batch.Write(CDBRawData(change.first), CDBRawData(change.second.second));
+        else
+            batch.Erase(CDBRawData(change.first));
+    }
+}
+
+bool CBDAPDB::IsStaging() const
+{
+    LOCK(cs_stage);
+    return fStaging && stagingThread == std::this_thread::get_id();
+}
+
+bool CBDAPDB::ReadStaged(const std::string& strKey, bool& fPresent, std::string& strValue) const
+{
+    LOCK(cs_stage);
+    if (!fStaging)
+        return false;
+    BDAPDBChanges::const_iterator it = mapStaged.find(strKey);
+    if (it == mapStaged.end())
+        return false;
+
+    fPresent = it->second.first;
+    strValue = it->second.second;
+    return true;
+}
+
+void CBDAPDB::StageChange(const std::string& strKey, bool fPresent, const std::string& strValue)
+{
+    AssertLockHeld(cs_stage);
+    // Keep the value from before the block the first time a key changes
+    if (mapUndo.count(strKey) == 0) {
+        CDBRawData value;
+        bool fFound = CDBWrapper::Read(CDBRawData(strKey), value);
+        mapUndo[strKey] = std::make_pair(fFound, value.data);
+    }
+    mapStaged[strKey] = std::make_pair(fPresent, strValue);
+}
+
+bool CBDAPDB::WriteBatch(CBDAPDBBatch& batch, bool fSync)
+{
+    {
+        LOCK(cs_stage);
+        if (fStaging) {
+            // BDAP state only changes while blocks connect, so no other thread writes
+            assert(stagingThread == std::this_thread::get_id());
+            for (const BDAPDBChanges::value_type& change : batch.changes)
+                StageChange(change.first, change.second.first, change.second.second);
+            return true;
+        }
+    }
+
+    CDBBatch dbBatch(*this);
+    WriteChanges(dbBatch, batch.changes);
+    return CDBWrapper::WriteBatch(dbBatch, fSync);
+}
+
+void CBDAPDB::BeginBlock(const CBDAPBlock& block)
+{
+    LOCK(cs_stage);
+    fStaging = true;
+    stagingThread = std::this_thread::get_id();
+    stagedBlock = block;
+    mapStaged.clear();
+    mapUndo.clear();
+}
+
+bool CBDAPDB::CommitBlock()
+{
+    LOCK(cs_stage);
+    if (!fStaging)
+        return true;
+
+    bool fResult = true;
+    if (!mapStaged.empty()) {
+        CDBBatch batch(*this);
+        WriteChanges(batch, mapStaged);
+        CBDAPBlockUndo undo;
+        undo.prevBlock = GetBestBlock();
+        undo.changes.swap(mapUndo);
+        batch.Write(GetUndoKey(stagedBlock), undo);
+        batch.Erase(GetRedoKey(stagedBlock));
+        batch.Write(BEST_BLOCK_KEY, stagedBlock);
+        fResult = CDBWrapper::WriteBatch(batch);
+    }
+    fStaging = false;
+    stagedBlock = CBDAPBlock();
+    mapStaged.clear();
+    mapUndo.clear();
+    return fResult;
+}
+
+void CBDAPDB::AbortBlock()
+{
+    LOCK(cs_stage);
+    fStaging = false;
+    stagedBlock = CBDAPBlock();
+    mapStaged.clear();
+    mapUndo.clear();
+}
+
+bool CBDAPDB::DisconnectBlock(const CBDAPBlock& block, bool& fFound)
+{
+    CBDAPBlockRedo redo;
+    fFound = CDBWrapper::Read(GetUndoKey(block), redo.undo);
+    if (!fFound)
+        return true;
+
+    // The block is the best one, so the values it wrote are still in place
+    for (const BDAPDBChanges::value_type& item : redo.undo.changes) {
+        CDBRawData value;
+        bool fPresent = CDBWrapper::Read(CDBRawData(item.first), value);
+        redo.changes[item.first] = std::make_pair(fPresent, value.data);
+    }
+
+    CDBBatch batch(*this);
+    WriteChanges(batch, redo.undo.changes);
+    batch.Erase(GetUndoKey(block));
+    batch.Write(GetRedoKey(block), redo);
+    if (redo.undo.prevBlock.IsNull())
+        batch.Erase(BEST_BLOCK_KEY);
+    else
+        batch.Write(BEST_BLOCK_KEY, redo.undo.prevBlock);
+    bool fResult = CDBWrapper::WriteBatch(batch);
+    ResetCaches();
+    return fResult;
+}
+
+CBDAPBlock CBDAPDB::GetBestBlock() const
+{
+    CBDAPBlock block;
+    if (!CDBWrapper::Read(BEST_BLOCK_KEY, block))
+        return CBDAPBlock();
+    return block;
+}
+
+bool CBDAPDB::SyncToChain(const CChain& chain)
+{
+    CBDAPBlock block = GetBestBlock();
+    while (!block.IsNull()) {
+        const CBlockIndex* pindex = chain[block.nHeight];
+        if (pindex && pindex->GetBlockHash() == block.hash)
+            break;
+
+        LogPrintf("%s -- Reverting BDAP changes of block %s at height %d, which is not in the active chain\n", __func__, block.hash.ToString(), block.nHeight);
+        bool fFound = false;
+        if (!DisconnectBlock(block, fFound))
+            return false;
+        if (!fFound)
+            return error("%s: no undo record of block %s at height %d", __func__, block.hash.ToString(), block.nHeight);
+        block = GetBestBlock();
+    }
+
+    // Blocks of the chain above the best block were disconnected here but not
+    // in the chainstate on disk, apply them again
+    std::vector<std::pair<UndoKey, CBDAPBlockRedo> > vRedo;
+    {
+        std::unique_ptr<CDBIterator> pcursor(NewIterator());
+        pcursor->Seek(std::make_pair(REDO_KEY, std::make_pair(CUndoHeight(block.nHeight + 1), uint256())));
+        while (pcursor->Valid()) {
+            UndoKey key;
+            if (!pcursor->GetKey(key) || key.first != REDO_KEY)
+                break;
+            const CBlockIndex* pindex = chain[key.second.first.nHeight];
+            if (pindex && pindex->GetBlockHash() == key.second.second) {
+                CBDAPBlockRedo redo;
+                if (!pcursor->GetValue(redo))
+                    return error("%s: failed to read redo record of block %s", __func__, key.second.second.ToString());
+                vRedo.push_back(std::make_pair(key, redo));
+            }
+            pcursor->Next();
+        }
+    }
+    for (const std::pair<UndoKey, CBDAPBlockRedo>& item : vRedo) {
+        const CBDAPBlock redoBlock(item.first.second.first.nHeight, item.first.second.second);
+        const CBDAPBlockRedo& redo = item.second;
+        if (redo.undo.prevBlock.hash != GetBestBlock().hash)
+            return error("%s: redo record of block %s at height %d does not follow the best block", __func__, redoBlock.hash.ToString(), redoBlock.nHeight);
+
+        LogPrintf("%s -- Applying BDAP changes of block %s at height %d again, which is in the active chain\n", __func__, redoBlock.hash.ToString(), redoBlock.nHeight);
+        CDBBatch batch(*this);
+        WriteChanges(batch, redo.changes);
+        batch.Write(GetUndoKey(redoBlock), redo.undo);
+        batch.Erase(item.first);
+        batch.Write(BEST_BLOCK_KEY, redoBlock);
+        if (!CDBWrapper::WriteBatch(batch))
+            return false;
+        ResetCaches();
+    }
+    return true;
+}
+
+bool CBDAPDB::PruneUndo(int nPruneHeight)
+{
+    if (nPruneHeight <= 0)
+        return true;
+
+    CDBBatch batch(*this);
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    for (const std::string& strKey : {UNDO_KEY, REDO_KEY}) {
+        pcursor->Seek(std::make_pair(strKey, std::make_pair(CUndoHeight(0), uint256())));
+        while (pcursor->Valid()) {
+            UndoKey key;
+            if (!pcursor->GetKey(key) || key.first != strKey || key.second.first.nHeight >= (uint32_t)nPruneHeight)
+                break;
+            batch.Erase(key);
+            pcursor->Next();
+        }
+    }
+    if (batch.SizeEstimate() == 0)
+        return true;
+    return CDBWrapper::WriteBatch(batch);
+}
+
+bool CBDAPDB::Sync()
+{
+    CDBBatch batch(*this);
+    return CDBWrapper::WriteBatch(batch, true);
+}
@@ -0,0 +1,268 @@
+// Copyright (c) 2019-2021 Duality Blockchain Solutions Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef CASH_BDAP_BDAPDB_H
+#define CASH_BDAP_BDAPDB_H
+
+#include "chain.h"
+#include "clientversion.h"
+#include "dbwrapper.h"
+#include "streams.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <map>
+#include <string>
+#include <thread>
+
+/** Serialized database keys mapped to their serialized value, or to not present */
+typedef std::map<std::string, std::pair<bool, std::string> > BDAPDBChanges;
+
+/** A block whose BDAP changes a database committed, null if none */
+class CBDAPBlock
+{
+public:
+    int nHeight;
+    uint256 hash;
+
+    CBDAPBlock() : nHeight(-1) {}
+    CBDAPBlock(int nHeightIn, const uint256& hashIn) : nHeight(nHeightIn), hash(hashIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(nHeight);
+        READWRITE(hash);
+    }
+
+    bool IsNull() const { return hash.IsNull(); }
+};
+
+/** The values a block replaced, and the block committed before it */
+class CBDAPBlockUndo
+{
+public:
+    CBDAPBlock prevBlock;
+    BDAPDBChanges changes;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(prevBlock);
+        READWRITE(changes);
+    }
+};
+
+/** The values a disconnected block had written, to apply them again if it turns out to still be in the chain */
+class CBDAPBlockRedo
+{
+public:
+    CBDAPBlockUndo undo;
+    BDAPDBChanges changes;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(undo);
+        READWRITE(changes);
+    }
+};
+
+/** Already serialized database data, written and read without a length prefix */
+class CDBRawData
+{
+public:
+    std::string data;
+
+    CDBRawData() {}
+    explicit CDBRawData(const std::string& dataIn) : data(dataIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s.write(data.data(), data.size());
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        data.resize(s.size());
+        if (!data.empty())
+            s.read(&data[0], data.size());
+    }
+};
+
+template <typename T>
+std::string SerializeBDAPData(const T& obj)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << obj;
+    return std::string(ss.begin(), ss.end());
+}
+
+/** Changes applied together to a CBDAPDB by CBDAPDB::WriteBatch */
+class CBDAPDBBatch
+{
+    friend class CBDAPDB;
+
+private:
+    BDAPDBChanges changes;
+    size_t size_estimate;
+
+public:
+    CBDAPDBBatch() : size_estimate(0) {}
+
+    template <typename K, typename V>
+    void Write(const K& key, const V& value)
+    {
+        std::pair<bool, std::string>& change = changes[SerializeBDAPData(key)];
+        change.first = true;
+        change.second = SerializeBDAPData(value);
+        size_estimate += change.second.size() + 32;
+    }
+
+    template <typename K>
+    void Erase(const K& key)
+    {
+        std::pair<bool, std::string>& change = changes[SerializeBDAPData(key)];
+        change.first = false;
+        change.second.clear();
+        size_estimate += 32;
+    }
+
+    void Clear()
+    {
+        changes.clear();
+        size_estimate = 0;
+    }
+
+    size_t SizeEstimate() const { return size_estimate; }
+};
+
+/**
+ * A BDAP database whose changes made while a block connects are staged in
+ * memory. They are read back from the stage by later operations of the same
+ * block and written in one batch together with an undo record of the block
+ * once the whole block is valid, or dropped if it is not. Disconnecting the
+ * block restores the values its undo record holds.
+ *
+ * The batch also moves the best block of the database, the last block whose
+ * changes it committed. Each undo record links to the best block before it,
+ * so changes of blocks that left the active chain without being disconnected,
+ * as after a crash, are undone newest first by SyncToChain.
+ *
+ * The chainstate is flushed later than these batches. Disconnecting a block
+ * therefore swaps its undo record for a redo record of the values it wrote.
+ * If the chainstate on disk still holds the block after a crash, SyncToChain
+ * applies them again, oldest first. Undo and redo records of blocks deep
+ * enough in the chain on disk are pruned with PruneUndo.
+ *
+ * Only the thread that began the block reads the staged changes and may
+ * write while it is staged. Other threads, and iterators, see committed data.
+ */
+class CBDAPDB : public CDBWrapper
+{
+private:
+    mutable CCriticalSection cs_stage;
+    bool fStaging;
+    std::thread::id stagingThread;
+    CBDAPBlock stagedBlock;
+    // Changes of the staged block, and the values they replace
+    BDAPDBChanges mapStaged;
+    BDAPDBChanges mapUndo;
+
+    bool IsStaging() const;
+    bool ReadStaged(const std::string& strKey, bool& fPresent, std::string& strValue) const;
+    void StageChange(const std::string& strKey, bool fPresent, const std::string& strValue);
+
+protected:
+    /** Drop cached copies of database values after they changed underneath them */
+    virtual void ResetCaches() {}
+
+    /** Whether the block being staged changed key, whichever thread stages it. Its value must not be cached. */
+    template <typename K>
+    bool IsStaged(const K& key) const
+    {
+        bool fPresent;
+        std::string strValue;
+        return ReadStaged(SerializeBDAPData(key), fPresent, strValue);
+    }
+
+public:
+    CBDAPDB(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
+        : CDBWrapper(path, nCacheSize, fMemory, fWipe, obfuscate), fStaging(false) {}
+    virtual ~CBDAPDB() {}
+
+    template <typename K, typename V>
+    bool Read(const K& key, V& value) const
+    {
+        bool fPresent;
+        std::string strValue;
+        if (IsStaging() && ReadStaged(SerializeBDAPData(key), fPresent, strValue)) {
+            if (!fPresent)
+                return false;
+            try {
+                CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
+                ssValue >> value;
+            } catch (const std::exception&) {
+                return false;
+            }
+            return true;
+        }
+        return CDBWrapper::Read(key, value);
+    }
+
+    template <typename K, typename V>
+    bool Write(const K& key, const V& value, bool fSync = false)
+    {
+        CBDAPDBBatch batch;
+        batch.Write(key, value);
+        return WriteBatch(batch, fSync);
+    }
+
+    template <typename K>
+    bool Exists(const K& key) const
+    {
+        bool fPresent;
+        std::string strValue;
+        if (IsStaging() && ReadStaged(SerializeBDAPData(key), fPresent, strValue))
+            return fPresent;
+        return CDBWrapper::Exists(key);
+    }
+
+    template <typename K>
+    bool Erase(const K& key, bool fSync = false)
+    {
+        CBDAPDBBatch batch;
+        batch.Erase(key);
+        return WriteBatch(batch, fSync);
+    }
+
+    bool WriteBatch(CBDAPDBBatch& batch, bool fSync = false);
+
+    /** Stage the changes of a block from now on */
+    void BeginBlock(const CBDAPBlock& block);
+    /** Write the staged changes and the undo record of the block in one batch */
+    bool CommitBlock();
+    /** Drop the staged changes */
+    void AbortBlock();
+    /** Restore the values a block replaced and keep a redo record. fFound is false if it has no undo record. */
+    bool DisconnectBlock(const CBDAPBlock& block, bool& fFound);
+    /** The last block whose changes were committed and not disconnected */
+    CBDAPBlock GetBestBlock() const;
+    /** Disconnect the committed blocks that are not in chain, newest first, then redo the disconnected blocks that are */
+    bool SyncToChain(const CChain& chain);
+    /** Erase the undo and redo records of the blocks below nPruneHeight */
+    bool PruneUndo(int nPruneHeight);
+    /** Sync the database log to disk */
+    bool Sync();
+};
+
+#endif // CASH_BDAP_BDAPDB_H
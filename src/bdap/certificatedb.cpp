@@ -56,88 +56,96 @@ bool UndoAddCertificate(const CX509Certificate& certificate)
 
 }
 
+// Request and approve indexes, one key per certificate transaction:
+// (index, (subject or issuer full path, txid)) -> empty
+// The pending indexes hold the requests that were not approved yet. They
+// replace the "subjectmn..." and "issuermn..." records that kept every txid
+// of an account in one vector.
+typedef std::pair<CharString, CharString> CertificateIndexPos;
+typedef std::pair<std::string, CertificateIndexPos> CertificateIndexKey;
+
+static const std::string CERTIFICATE_SUBJECT_REQUEST_KEY = "csq";
+static const std::string CERTIFICATE_ISSUER_REQUEST_KEY = "ciq";
+static const std::string CERTIFICATE_SUBJECT_PENDING_KEY = "csp";
+static const std::string CERTIFICATE_ISSUER_PENDING_KEY = "cip";
+static const std::string CERTIFICATE_SUBJECT_APPROVE_KEY = "csa";
+static const std::string CERTIFICATE_ISSUER_APPROVE_KEY = "cia";
+static const std::string CERTIFICATE_INDEX_VERSION_KEY = "civersion";
+static const int CERTIFICATE_INDEX_VERSION = 1;
+// Bytes of index records written at once while converting the old records
+static const size_t CERTIFICATE_INDEX_BATCH_SIZE = 16 << 20;
+
+static void WriteCertificateIndex(CBDAPDBBatch& batch, const std::string& strIndexKey, const CharString& vchAccount, const CharString& vchTxId)
+{
+    batch.Write(make_pair(strIndexKey, make_pair(vchAccount, vchTxId)), CharString());
+}
+
+static void EraseCertificateIndex(CBDAPDBBatch& batch, const std::string& strIndexKey, const CharString& vchAccount, const CharString& vchTxId)
+{
+    batch.Erase(make_pair(strIndexKey, make_pair(vchAccount, vchTxId)));
+}
+
 bool CCertificateDB::AddCertificate(const CX509Certificate& certificate) 
 { 
-    bool writeState = false;
-    bool writeStateCA = true;
-    bool writeStateSerial = true;
-    bool updateState = true;
-    bool writeStateIssuerMN = true;
-    bool writeStateSubjectMN = true;
-    {
-        LOCK(cs_bdap_certificate);
+    LOCK(cs_bdap_certificate);
 
-        std::string labelTxId;
-        std::string labelSubjectMN;
-        std::string labelIssuerMN;
-        std::vector<unsigned char> vchTxHash;
-        std::vector<unsigned char> vchTxHashRequest;
-
-        if (certificate.IsRootCA){  //Root certificate
-            vchTxHash = vchFromString(certificate.txHashSigned.ToString());
-            labelTxId = "txrootcaid";
-            //labelSubjectMN = "subjectmnrootca";
-            //labelIssuerMN = "issuermnrootca";
-        }
-        else if (certificate.IsApproved()){  //Approve
-            vchTxHash = vchFromString(certificate.txHashSigned.ToString());
-            vchTxHashRequest = vchFromString(certificate.txHashRequest.ToString());
-            labelTxId = "txapproveid";
-            labelSubjectMN = "subjectmnapprove";
-            labelIssuerMN = "issuermnapprove";
-        }
-        else { //Request
-            vchTxHash = vchFromString(certificate.txHashRequest.ToString());
-            labelTxId = "txrequestid";
-            labelSubjectMN = "subjectmnrequest";
-            labelIssuerMN = "issuermnrequest";
-        }
+    std::string labelTxId;
+    std::vector<unsigned char> vchTxHash;
+    std::vector<unsigned char> vchTxHashRequest;
+    CBDAPDBBatch batch;
 
-        if (!certificate.IsRootCA) {
-            //Subject
-            std::vector<std::vector<unsigned char>> vvTxIdSubject;
-            CDBWrapper::Read(make_pair(labelSubjectMN, certificate.Subject), vvTxIdSubject);
-            vvTxIdSubject.push_back(vchTxHash);
-            writeStateSubjectMN = Write(make_pair(labelSubjectMN, certificate.Subject), vvTxIdSubject);
-
-            //Issuer
-            std::vector<std::vector<unsigned char>> vvTxIdIssuer;
-            CDBWrapper::Read(make_pair(labelIssuerMN, certificate.Issuer), vvTxIdIssuer);
-            vvTxIdIssuer.push_back(vchTxHash);
-            writeStateIssuerMN = Write(make_pair(labelIssuerMN, certificate.Issuer), vvTxIdIssuer);
-        }
+    if (certificate.IsRootCA){  //Root certificate
+        vchTxHash = vchFromString(certificate.txHashSigned.ToString());
+        labelTxId = "txrootcaid";
+    }
+    else if (certificate.IsApproved()){  //Approve
+        vchTxHash = vchFromString(certificate.txHashSigned.ToString());
+        vchTxHashRequest = vchFromString(certificate.txHashRequest.ToString());
+        labelTxId = "txapproveid";
+        WriteCertificateIndex(batch, CERTIFICATE_SUBJECT_APPROVE_KEY, certificate.Subject, vchTxHash);
+        WriteCertificateIndex(batch, CERTIFICATE_ISSUER_APPROVE_KEY, certificate.Issuer, vchTxHash);
+    }
+    else { //Request
+        vchTxHash = vchFromString(certificate.txHashRequest.ToString());
+        labelTxId = "txrequestid";
+        WriteCertificateIndex(batch, CERTIFICATE_SUBJECT_REQUEST_KEY, certificate.Subject, vchTxHash);
+        WriteCertificateIndex(batch, CERTIFICATE_ISSUER_REQUEST_KEY, certificate.Issuer, vchTxHash);
+        WriteCertificateIndex(batch, CERTIFICATE_SUBJECT_PENDING_KEY, certificate.Subject, vchTxHash);
+        WriteCertificateIndex(batch, CERTIFICATE_ISSUER_PENDING_KEY, certificate.Issuer, vchTxHash);
+    }
 
-        //Certificate
-        writeState = Write(make_pair(labelTxId, vchTxHash), certificate);
+    //Certificate
+    batch.Write(make_pair(labelTxId, vchTxHash), certificate);
 
-        //Serial Number
-        if (certificate.SerialNumber != 0) {
-            writeStateSerial = Write(make_pair(std::string("serialnumber"), certificate.SerialNumber), vchTxHash);
-        }
+    //Serial Number
+    if (certificate.SerialNumber != 0) {
+        batch.Write(make_pair(std::string("serialnumber"), certificate.SerialNumber), vchTxHash);
+    }
 
-        //if root certificate, index the issuer (subject=issuer). only one root certificate per bdap account
-        if (certificate.IsRootCA){
-            writeStateCA = Write(make_pair(std::string("issuerrootca"), certificate.Issuer), vchTxHash);
-        }
-        //if an approve (not self-signed), update the previous request certificate with txHashSigned
-        else if ((certificate.IsApproved()) && (!certificate.SelfSignedX509Certificate())) {
-            CX509Certificate requestCertificate;
-            if (ReadCertificateTxId(vchTxHashRequest, requestCertificate)) {
-                requestCertificate.txHashSigned = certificate.txHashSigned;
-                updateState = Write(make_pair(std::string("txrequestid"), vchTxHashRequest), requestCertificate);
-            }
+    //if root certificate, index the issuer (subject=issuer). only one root certificate per bdap account
+    if (certificate.IsRootCA){
+        batch.Write(make_pair(std::string("issuerrootca"), certificate.Issuer), vchTxHash);
+    }
+    //if an approve (not self-signed), update the previous request certificate with txHashSigned
+    else if ((certificate.IsApproved()) && (!certificate.SelfSignedX509Certificate())) {
+        CX509Certificate requestCertificate;
+        if (ReadCertificateTxId(vchTxHashRequest, requestCertificate)) {
+            requestCertificate.txHashSigned = certificate.txHashSigned;
+            batch.Write(make_pair(std::string("txrequestid"), vchTxHashRequest), requestCertificate);
+            EraseCertificateIndex(batch, CERTIFICATE_SUBJECT_PENDING_KEY, requestCertificate.Subject, vchTxHashRequest);
+            EraseCertificateIndex(batch, CERTIFICATE_ISSUER_PENDING_KEY, requestCertificate.Issuer, vchTxHashRequest);
         }
-
     }
-    return writeState && writeStateIssuerMN && writeStateSubjectMN && updateState && writeStateCA && writeStateSerial;
+
+    return WriteBatch(batch);
 }
 
 bool CCertificateDB::ReadCertificateTxId(const std::vector<unsigned char>& vchTxId, CX509Certificate& certificate) 
 {
     LOCK(cs_bdap_certificate);
-    if(!(CDBWrapper::Read(make_pair(std::string("txrequestid"), vchTxId), certificate))) {
-        if(!(CDBWrapper::Read(make_pair(std::string("txapproveid"), vchTxId), certificate))) {
-            return CDBWrapper::Read(make_pair(std::string("txrootcaid"), vchTxId), certificate);
+    if(!(Read(make_pair(std::string("txrequestid"), vchTxId), certificate))) {
+        if(!(Read(make_pair(std::string("txapproveid"), vchTxId), certificate))) {
+            return Read(make_pair(std::string("txrootcaid"), vchTxId), certificate);
         }
     }
     return true;
@@ -148,7 +156,7 @@ bool CCertificateDB::ReadCertificateIssuerRootCA(const std::vector<unsigned char
     LOCK(cs_bdap_certificate);
     std::vector<unsigned char> vchTxId;
     bool readState = false;
-    readState = CDBWrapper::Read(make_pair(std::string("issuerrootca"), vchIssuer), vchTxId);
+    readState = Read(make_pair(std::string("issuerrootca"), vchIssuer), vchTxId);
 
     if (readState) {
         return ReadCertificateTxId(vchTxId, certificate);
@@ -163,7 +171,7 @@ bool CCertificateDB::ReadCertificateSerialNumber(const uint64_t& nSerialNumber,
     LOCK(cs_bdap_certificate);
     std::vector<unsigned char> vchTxId;
     bool readState = false;
-    readState = CDBWrapper::Read(make_pair(std::string("serialnumber"), nSerialNumber), vchTxId);
+    readState = Read(make_pair(std::string("serialnumber"), nSerialNumber), vchTxId);
 
     if (readState) {
         return ReadCertificateTxId(vchTxId, certificate);
@@ -174,86 +182,51 @@ bool CCertificateDB::ReadCertificateSerialNumber(const uint64_t& nSerialNumber,
     return true;
 }
 
-bool CCertificateDB::ReadCertificateSubjectMNRequest(const std::vector<unsigned char>& vchSubject, std::vector<CX509Certificate>& vCertificates, bool getAll) 
+// Reads the certificates of one account in an index, skipping nOffset of
+// them and returning at most nLimit, in txid order.
+bool CCertificateDB::ReadCertificateIndex(const std::string& strIndexKey, const std::vector<unsigned char>& vchAccount, std::vector<CX509Certificate>& vCertificates, unsigned int nOffset, unsigned int nLimit)
 {
     LOCK(cs_bdap_certificate);
-    std::vector<std::vector<unsigned char>> vvTxId;
-    std::vector<std::vector<unsigned char>> vvTxIdApprove;
-    bool readState = false;
-    readState = CDBWrapper::Read(make_pair(std::string("subjectmnrequest"), vchSubject), vvTxId);
-
-    if (readState) {
-        for (const std::vector<unsigned char>& vchTxId : vvTxId) {
+    CertificateIndexKey key;
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(make_pair(strIndexKey, vchAccount));
+    unsigned int nRead = 0;
+    while (pcursor->Valid() && nRead < nLimit) {
+        boost::this_thread::interruption_point();
+        if (!pcursor->GetKey(key) || key.first != strIndexKey || key.second.first != vchAccount)
+            break;
+        if (nOffset > 0) {
+            nOffset--;
+        } else {
             CX509Certificate certificate;
-            if (ReadCertificateTxId(vchTxId, certificate)) {
-                if (getAll || (!certificate.IsApproved())) {
-                    vCertificates.push_back(certificate);
-                }
+            if (ReadCertificateTxId(key.second.second, certificate)) {
+                vCertificates.push_back(certificate);
+                nRead++;
             }
         }
+        pcursor->Next();
     }
-
     return (vCertificates.size() > 0);
 }
 
-bool CCertificateDB::ReadCertificateIssuerMNRequest(const std::vector<unsigned char>& vchIssuer, std::vector<CX509Certificate>& vCertificates, bool getAll) 
+bool CCertificateDB::ReadCertificateSubjectMNRequest(const std::vector<unsigned char>& vchSubject, std::vector<CX509Certificate>& vCertificates, bool getAll, const unsigned int nOffset, const unsigned int nLimit) 
 {
-    LOCK(cs_bdap_certificate);
-    std::vector<std::vector<unsigned char>> vvTxId;
-    std::vector<std::vector<unsigned char>> vvTxIdApprove;
-    bool readState = false;
-    readState = CDBWrapper::Read(make_pair(std::string("issuermnrequest"), vchIssuer), vvTxId);
-
-    if (readState) {
-        for (const std::vector<unsigned char>& vchTxId : vvTxId) {
-            CX509Certificate certificate;
-            if (ReadCertificateTxId(vchTxId, certificate)) {
-                if (getAll || (!certificate.IsApproved())) {
-                    vCertificates.push_back(certificate);
-                }
-            }
-        }
-    }
-
-    return (vCertificates.size() > 0);
+    return ReadCertificateIndex(getAll ? CERTIFICATE_SUBJECT_REQUEST_KEY : CERTIFICATE_SUBJECT_PENDING_KEY, vchSubject, vCertificates, nOffset, nLimit);
 }
 
-bool CCertificateDB::ReadCertificateSubjectMNApprove(const std::vector<unsigned char>& vchSubject, std::vector<CX509Certificate>& vCertificates) 
+bool CCertificateDB::ReadCertificateIssuerMNRequest(const std::vector<unsigned char>& vchIssuer, std::vector<CX509Certificate>& vCertificates, bool getAll, const unsigned int nOffset, const unsigned int nLimit) 
 {
-    LOCK(cs_bdap_certificate);
-    std::vector<std::vector<unsigned char>> vvTxId;
-    bool readState = false;
-    readState = CDBWrapper::Read(make_pair(std::string("subjectmnapprove"), vchSubject), vvTxId);
-
-    if (readState) {
-        for (const std::vector<unsigned char>& vchTxId : vvTxId) {
-            CX509Certificate certificate;
-            if (ReadCertificateTxId(vchTxId, certificate)) {
-                vCertificates.push_back(certificate);
-            }
-        }
-    }
-
-    return (vCertificates.size() > 0);
+    return ReadCertificateIndex(getAll ? CERTIFICATE_ISSUER_REQUEST_KEY : CERTIFICATE_ISSUER_PENDING_KEY, vchIssuer, vCertificates, nOffset, nLimit);
 }
 
-bool CCertificateDB::ReadCertificateIssuerMNApprove(const std::vector<unsigned char>& vchIssuer, std::vector<CX509Certificate>& vCertificates) 
+bool CCertificateDB::ReadCertificateSubjectMNApprove(const std::vector<unsigned char>& vchSubject, std::vector<CX509Certificate>& vCertificates, const unsigned int nOffset, const unsigned int nLimit) 
 {
-    LOCK(cs_bdap_certificate);
-    std::vector<std::vector<unsigned char>> vvTxId;
-    bool readState = false;
-    readState = CDBWrapper::Read(make_pair(std::string("issuermnapprove"), vchIssuer), vvTxId);
-
-    if (readState) {
-        for (const std::vector<unsigned char>& vchTxId : vvTxId) {
-            CX509Certificate certificate;
-            if (ReadCertificateTxId(vchTxId, certificate)) {
-                vCertificates.push_back(certificate);
-            }
-        }
-    }
+    return ReadCertificateIndex(CERTIFICATE_SUBJECT_APPROVE_KEY, vchSubject, vCertificates, nOffset, nLimit);
+}
 
-    return (vCertificates.size() > 0);
+bool CCertificateDB::ReadCertificateIssuerMNApprove(const std::vector<unsigned char>& vchIssuer, std::vector<CX509Certificate>& vCertificates, const unsigned int nOffset, const unsigned int nLimit) 
+{
+    return ReadCertificateIndex(CERTIFICATE_ISSUER_APPROVE_KEY, vchIssuer, vCertificates, nOffset, nLimit);
 }
 
 bool CCertificateDB::EraseCertificateTxId(const std::vector<unsigned char>& vchTxId)
@@ -264,84 +237,81 @@ bool CCertificateDB::EraseCertificateTxId(const std::vector<unsigned char>& vchT
     if (!ReadCertificateTxId(vchTxId, certificate))
         return false;
 
-    //subjectrequest
-    std::vector<std::vector<unsigned char>> vvSubjectRequestTxId;
-    CDBWrapper::Read(make_pair(std::string("subjectmnrequest"), certificate.Subject), vvSubjectRequestTxId);
-    if (vvSubjectRequestTxId.size() == 1 && vvSubjectRequestTxId[0] == vchTxId) {
-        CDBWrapper::Erase(make_pair(std::string("subjectmnrequest"), certificate.Subject));
-    }
-    else {
-        std::vector<std::vector<unsigned char>> vvTxIdSubjectRequestNew;
-        for (const std::vector<unsigned char>& txid : vvSubjectRequestTxId) {
-            if (txid != vchTxId) {
-                vvTxIdSubjectRequestNew.push_back(txid);
-            }
-        }
-        Write(make_pair(std::string("subjectmnrequest"), certificate.Subject), vvTxIdSubjectRequestNew);
-    }
+    CBDAPDBBatch batch;
+    EraseCertificateIndex(batch, CERTIFICATE_SUBJECT_REQUEST_KEY, certificate.Subject, vchTxId);
+    EraseCertificateIndex(batch, CERTIFICATE_ISSUER_REQUEST_KEY, certificate.Issuer, vchTxId);
+    EraseCertificateIndex(batch, CERTIFICATE_SUBJECT_PENDING_KEY, certificate.Subject, vchTxId);
+    EraseCertificateIndex(batch, CERTIFICATE_ISSUER_PENDING_KEY, certificate.Issuer, vchTxId);
+    EraseCertificateIndex(batch, CERTIFICATE_SUBJECT_APPROVE_KEY, certificate.Subject, vchTxId);
+    EraseCertificateIndex(batch, CERTIFICATE_ISSUER_APPROVE_KEY, certificate.Issuer, vchTxId);
 
-    //issuerrequest
-    std::vector<std::vector<unsigned char>> vvIssuerRequestTxId;
-    CDBWrapper::Read(make_pair(std::string("issuermnrequest"), certificate.Issuer), vvIssuerRequestTxId);
-    if (vvIssuerRequestTxId.size() == 1 && vvIssuerRequestTxId[0] == vchTxId) {
-        CDBWrapper::Erase(make_pair(std::string("issuermnrequest"), certificate.Issuer));
-    }
-    else {
-        std::vector<std::vector<unsigned char>> vvTxIdIssuerRequestNew;
-        for (const std::vector<unsigned char>& txid : vvIssuerRequestTxId) {
-            if (txid != vchTxId) {
-                vvTxIdIssuerRequestNew.push_back(txid);
-            }
-        }
-        Write(make_pair(std::string("issuermnrequest"), certificate.Issuer), vvTxIdIssuerRequestNew);
+    if (certificate.SerialNumber != 0) {
+        batch.Erase(make_pair(std::string("serialnumber"), certificate.SerialNumber));
     }
 
-    //subjectapprove
-    std::vector<std::vector<unsigned char>> vvSubjectApproveTxId;
-    CDBWrapper::Read(make_pair(std::string("subjectmnapprove"), certificate.Subject), vvSubjectApproveTxId);
-    if (vvSubjectApproveTxId.size() == 1 && vvSubjectApproveTxId[0] == vchTxId) {
-        CDBWrapper::Erase(make_pair(std::string("subjectmnapprove"), certificate.Subject));
+    if (certificate.IsRootCA) {
+        batch.Erase(make_pair(std::string("issuerrootca"), certificate.Issuer));
+        batch.Erase(make_pair(std::string("txrootcaid"), vchTxId));
+    }
+    else if (certificate.IsApproved()) {
+        batch.Erase(make_pair(std::string("txapproveid"), vchTxId));
     }
     else {
-        std::vector<std::vector<unsigned char>> vvTxIdSubjectApproveNew;
-        for (const std::vector<unsigned char>& txid : vvSubjectApproveTxId) {
-            if (txid != vchTxId) {
-                vvTxIdSubjectApproveNew.push_back(txid);
-            }
-        }
-        Write(make_pair(std::string("subjectmnapprove"), certificate.Subject), vvTxIdSubjectApproveNew);
+        batch.Erase(make_pair(std::string("txrequestid"), vchTxId));
     }
+    return WriteBatch(batch);
+}
 
-    //issuerapprove
-    std::vector<std::vector<unsigned char>> vvIssuerApproveTxId;
-    CDBWrapper::Read(make_pair(std::string("issuermnapprove"), certificate.Issuer), vvIssuerApproveTxId);
-    if (vvIssuerApproveTxId.size() == 1 && vvIssuerApproveTxId[0] == vchTxId) {
-        CDBWrapper::Erase(make_pair(std::string("issuermnapprove"), certificate.Issuer));
-    }
-    else {
-        std::vector<std::vector<unsigned char>> vvTxIdIssuerApproveNew;
-        for (const std::vector<unsigned char>& txid : vvIssuerApproveTxId) {
-            if (txid != vchTxId) {
-                vvTxIdIssuerApproveNew.push_back(txid);
+// Converts the vector-valued request and approve records into per-txid index keys
+bool CCertificateDB::UpgradeCertificateIndex()
+{
+    LOCK(cs_bdap_certificate);
+    int nVersion = 0;
+    if (Read(CERTIFICATE_INDEX_VERSION_KEY, nVersion) && nVersion >= CERTIFICATE_INDEX_VERSION)
+        return true;
+
+    LogPrintf("CCertificateDB::%s -- Building BDAP certificate indexes\n", __func__);
+    int nConverted = 0;
+    CBDAPDBBatch batch;
+    const std::vector<std::pair<std::string, std::string> > vLegacy = {
+        {"subjectmnrequest", CERTIFICATE_SUBJECT_REQUEST_KEY},
+        {"issuermnrequest", CERTIFICATE_ISSUER_REQUEST_KEY},
+        {"subjectmnapprove", CERTIFICATE_SUBJECT_APPROVE_KEY},
+        {"issuermnapprove", CERTIFICATE_ISSUER_APPROVE_KEY}};
+    for (const std::pair<std::string, std::string>& legacy : vLegacy) {
+        std::pair<std::string, CharString> key;
+        std::unique_ptr<CDBIterator> pcursor(NewIterator());
+        pcursor->Seek(legacy.first);
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            if (!pcursor->GetKey(key) || key.first != legacy.first)
+                break;
+            std::vector<std::vector<unsigned char>> vvTxId;
+            if (!pcursor->GetValue(vvTxId))
+                return error("%s() : deserialize error", __PRETTY_FUNCTION__);
+            for (const std::vector<unsigned char>& vchTxId : vvTxId) {
+                WriteCertificateIndex(batch, legacy.second, key.second, vchTxId);
+                CX509Certificate certificate;
+                if (legacy.second == CERTIFICATE_SUBJECT_REQUEST_KEY && ReadCertificateTxId(vchTxId, certificate) && !certificate.IsApproved())
+                    WriteCertificateIndex(batch, CERTIFICATE_SUBJECT_PENDING_KEY, key.second, vchTxId);
+                else if (legacy.second == CERTIFICATE_ISSUER_REQUEST_KEY && ReadCertificateTxId(vchTxId, certificate) && !certificate.IsApproved())
+                    WriteCertificateIndex(batch, CERTIFICATE_ISSUER_PENDING_KEY, key.second, vchTxId);
             }
+            batch.Erase(key);
+            nConverted++;
+            if (batch.SizeEstimate() > CERTIFICATE_INDEX_BATCH_SIZE) {
+                WriteBatch(batch);
+                batch.Clear();
+            }
+            pcursor->Next();
         }
-        Write(make_pair(std::string("issuermnapprove"), certificate.Issuer), vvTxIdIssuerApproveNew);
     }
+    batch.Write(CERTIFICATE_INDEX_VERSION_KEY, CERTIFICATE_INDEX_VERSION);
+    if (!WriteBatch(batch, true))
+        return error("%s() : failed to write certificate indexes", __PRETTY_FUNCTION__);
 
-    if (certificate.SerialNumber != 0) {
-        CDBWrapper::Erase(make_pair(std::string("serialnumber"), certificate.SerialNumber));
-    }
-
-    if (certificate.IsRootCA) {
-        return (CDBWrapper::Erase(make_pair(std::string("issuerrootca"), certificate.Issuer))) && (CDBWrapper::Erase(make_pair(std::string("txrootcaid"), vchTxId)));
-    }
-    else if (certificate.IsApproved()) {
-        return CDBWrapper::Erase(make_pair(std::string("txapproveid"), vchTxId));
-    }
-    else {
-        return CDBWrapper::Erase(make_pair(std::string("txrequestid"), vchTxId));
-    }
-    
+    LogPrintf("CCertificateDB::%s -- Converted %d BDAP certificate index records\n", __func__, nConverted);
+    return true;
 }
 
 bool CheckCertificateDB()
@@ -462,8 +432,45 @@ static bool CommonDataCheck(const CX509Certificate& certificate, const vchCharSt
     return true;
 }
 
+// Checks the subject signature of a request and the issuer signature of an approval against their accounts
+static bool CheckCertificateSignatures(const CX509Certificate& certificate, std::string& errorMessage)
+{
+    CDomainEntry entrySubject;
+    if (!GetDomainEntry(certificate.Subject, entrySubject)) {
+        errorMessage = "CheckNewCertificateTxInputs: - Could not find specified certificate subject! " + stringFromVch(certificate.Subject);
+        return error(errorMessage.c_str());
+    }
+   CharString vchSubjectPubKey = entrySubject.DHTPublicKey;
+
+    if ( (!certificate.SelfSignedX509Certificate()) && (!certificate.IsApproved()) ) {
+        //check subject signature (only if Request)
+        if (!certificate.CheckSubjectSignature(EncodedPubKeyToBytes(vchSubjectPubKey))) { //test in rpc, should work
+            errorMessage = "CheckNewCertificateTxInputs: - Could not validate subject signature. ";
+            return error(errorMessage.c_str());
+        }
+    }
+
+    //if approved check issuer signature
+    if (certificate.IsApproved()) {
+        CDomainEntry entryIssuer;
+        if (!GetDomainEntry(certificate.Issuer, entryIssuer)) {
+            errorMessage = "CheckNewCertificateTxInputs: - Could not find specified certificate issuer! " + stringFromVch(certificate.Issuer);
+            return error(errorMessage.c_str());
+        }
+        CDebitAddress address = entryIssuer.GetWalletAddress();
+
+        CharString vchIssuerPubKey = entryIssuer.DHTPublicKey;
+
+        if (!certificate.CheckIssuerSignature(EncodedPubKeyToBytes(vchIssuerPubKey))) { //test in rpc, should work
+            errorMessage = "CheckNewCertificateTxInputs: - Could not validate issuer signature. ";
+            return error(errorMessage.c_str());
+        }
+    }
+    return true;
+}
+
 static bool CheckNewCertificateTxInputs(const CX509Certificate& certificate, const CScript& scriptOp, const vchCharString& vvchOpParameters, const uint256& txHash,
-                               const std::string& strOpType, std::string& errorMessage, bool fJustCheck)
+                               const std::string& strOpType, std::string& errorMessage, bool fJustCheck, bool fPreChecked)
 {
     if (!CommonDataCheck(certificate, vvchOpParameters, errorMessage))
         return error(errorMessage.c_str());
@@ -494,38 +501,11 @@ static bool CheckNewCertificateTxInputs(const CX509Certificate& certificate, con
         strTxHashToUse = certificate.txHashRequest.ToString();
     }
 
-    CDomainEntry entrySubject;
-    if (!GetDomainEntry(certificate.Subject, entrySubject)) {
-        errorMessage = "CheckNewCertificateTxInputs: - Could not find specified certificate subject! " + stringFromVch(certificate.Subject);
-        return error(errorMessage.c_str());
-    }
-   CharString vchSubjectPubKey = entrySubject.DHTPublicKey;
-
-    if ( (!certificate.SelfSignedX509Certificate()) && (!certificate.IsApproved()) ) {
-        //check subject signature (only if Request)
-        if (!certificate.CheckSubjectSignature(EncodedPubKeyToBytes(vchSubjectPubKey))) { //test in rpc, should work
-            errorMessage = "CheckNewCertificateTxInputs: - Could not validate subject signature. ";
-            return error(errorMessage.c_str());
-        }
-    }
+    if (!fPreChecked && !CheckCertificateSignatures(certificate, errorMessage))
+        return false;
 
-    //if approved check issuer signature and if not self signed check if request exists
+    //if approved and not self signed, check if request exists
     if (certificate.IsApproved()) {
-        CDomainEntry entryIssuer;
-        if (!GetDomainEntry(certificate.Issuer, entryIssuer)) {
-            errorMessage = "CheckNewCertificateTxInputs: - Could not find specified certificate issuer! " + stringFromVch(certificate.Issuer);
-            return error(errorMessage.c_str());
-        }
-        CDebitAddress address = entryIssuer.GetWalletAddress();
-
-        CharString vchIssuerPubKey = entryIssuer.DHTPublicKey;
-
-        if (!certificate.CheckIssuerSignature(EncodedPubKeyToBytes(vchIssuerPubKey))) { //test in rpc, should work
-            errorMessage = "CheckNewCertificateTxInputs: - Could not validate issuer signature. ";
-            return error(errorMessage.c_str());
-        }
-
-        //if not self signed, check if request exists
         if (!certificate.SelfSignedX509Certificate()) {
             CX509Certificate certificateRequest;
             if (!GetCertificateTxId(certificate.txHashRequest.ToString(), certificateRequest)) {
@@ -571,7 +551,7 @@ static bool CheckNewCertificateTxInputs(const CX509Certificate& certificate, con
 }
 
 bool CheckCertificateTx(const CTransactionRef& tx, const CScript& scriptOp, const int& op1, const int& op2, const std::vector<std::vector<unsigned char> >& vvchArgs, 
-                                const bool fJustCheck, const int& nHeight, const uint32_t& nBlockTime, const bool bSanityCheck, std::string& errorMessage) 
+                                const bool fJustCheck, const int& nHeight, const uint32_t& nBlockTime, const bool bSanityCheck, std::string& errorMessage, const bool fPreChecked) 
 {
     if (tx->IsCoinBase() && !fJustCheck && !bSanityCheck) {
         LogPrintf("*Trying to add BDAP certificate in coinbase transaction, skipping...");
@@ -595,7 +575,7 @@ bool CheckCertificateTx(const CTransactionRef& tx, const CScript& scriptOp, cons
     const std::string strOperationType = GetBDAPOpTypeString(op1, op2);
     CAmount monthlyFee, oneTimeFee, depositFee;
     if (strOperationType == "bdap_new_certificate" || strOperationType == "bdap_approve_certificate") {
-        if (!certificate.ValidatePEM(errorMessage))
+        if (!fPreChecked && !certificate.ValidatePEM(errorMessage))
             return false;
 
         if (!certificate.ValidateValues(errorMessage))
@@ -652,9 +632,29 @@ bool CheckCertificateTx(const CTransactionRef& tx, const CScript& scriptOp, cons
                                     FormatMoney(opAmount), FormatMoney(depositFee));
         }
 
-        return CheckNewCertificateTxInputs(certificate, scriptOp, vvchArgs, tx->GetHash(), strOperationType, errorMessage, fJustCheck);
+        return CheckNewCertificateTxInputs(certificate, scriptOp, vvchArgs, tx->GetHash(), strOperationType, errorMessage, fJustCheck, fPreChecked);
     }
 
     return false;
 
 }
+
+bool PreCheckCertificateTx(const CTransactionRef& tx, const int& nHeight, std::vector<std::vector<unsigned char> >& vvchObjectPaths, std::string& errorMessage)
+{
+    CX509Certificate certificate;
+    std::vector<unsigned char> vchData;
+    std::vector<unsigned char> vchHash;
+    int nDataOut;
+    bool bData = GetBDAPData(tx, vchData, vchHash, nDataOut);
+    if(bData && !certificate.UnserializeFromTx(tx, nHeight))
+    {
+        errorMessage = ("UnserializeFromData data in tx failed!");
+        return false;
+    }
+    if (!certificate.ValidatePEM(errorMessage))
+        return false;
+
+    vvchObjectPaths.push_back(certificate.Subject);
+    vvchObjectPaths.push_back(certificate.Issuer);
+    return CheckCertificateSignatures(certificate, errorMessage);
+}
@@ -5,30 +5,36 @@
 #ifndef CASH_BDAP_CERTIFICATEDB_H
 #define CASH_BDAP_CERTIFICATEDB_H
 
+#include "bdap/bdapdb.h"
 #include "bdap/x509certificate.h"
-#include "dbwrapper.h"
 #include "sync.h"
 
+#include <limits>
+
 class CCoinsViewCache;
 class UniValue;
 
 static CCriticalSection cs_bdap_certificate;
 
-class CCertificateDB : public CDBWrapper {
+class CCertificateDB : public CBDAPDB {
 public:
-    CCertificateDB(size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate) : CDBWrapper(GetDataDir() / "blocks" / "bdap-certificates", nCacheSize, fMemory, fWipe, obfuscate) {
+    CCertificateDB(size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate) : CBDAPDB(GetDataDir() / "blocks" / "bdap-certificates", nCacheSize, fMemory, fWipe, obfuscate) {
     }
     bool AddCertificate(const CX509Certificate& certificate);
     bool ReadCertificateTxId(const std::vector<unsigned char>& vchTxId, CX509Certificate& certificate);
     bool ReadCertificateIssuerRootCA(const std::vector<unsigned char>& vchIssuer, CX509Certificate& certificate); 
     bool ReadCertificateSerialNumber(const uint64_t& nSerialNumber, CX509Certificate& certificate); 
 
-    bool ReadCertificateSubjectMNRequest(const std::vector<unsigned char>& vchSubject, std::vector<CX509Certificate>& vCertificates, bool getAll = true);
-    bool ReadCertificateIssuerMNRequest(const std::vector<unsigned char>& vchIssuer, std::vector<CX509Certificate>& vCertificates, bool getAll = true);
-    bool ReadCertificateSubjectMNApprove(const std::vector<unsigned char>& vchSubject, std::vector<CX509Certificate>& vCertificates);
-    bool ReadCertificateIssuerMNApprove(const std::vector<unsigned char>& vchSubject, std::vector<CX509Certificate>& vCertificates);
+    bool ReadCertificateSubjectMNRequest(const std::vector<unsigned char>& vchSubject, std::vector<CX509Certificate>& vCertificates, bool getAll = true, const unsigned int nOffset = 0, const unsigned int nLimit = std::numeric_limits<unsigned int>::max());
+    bool ReadCertificateIssuerMNRequest(const std::vector<unsigned char>& vchIssuer, std::vector<CX509Certificate>& vCertificates, bool getAll = true, const unsigned int nOffset = 0, const unsigned int nLimit = std::numeric_limits<unsigned int>::max());
+    bool ReadCertificateSubjectMNApprove(const std::vector<unsigned char>& vchSubject, std::vector<CX509Certificate>& vCertificates, const unsigned int nOffset = 0, const unsigned int nLimit = std::numeric_limits<unsigned int>::max());
+    bool ReadCertificateIssuerMNApprove(const std::vector<unsigned char>& vchIssuer, std::vector<CX509Certificate>& vCertificates, const unsigned int nOffset = 0, const unsigned int nLimit = std::numeric_limits<unsigned int>::max());
 
     bool EraseCertificateTxId(const std::vector<unsigned char>& vchTxId);
+    bool UpgradeCertificateIndex();
+
+private:
+    bool ReadCertificateIndex(const std::string& strIndexKey, const std::vector<unsigned char>& vchAccount, std::vector<CX509Certificate>& vCertificates, unsigned int nOffset, unsigned int nLimit);
 };
 
 bool GetCertificateTxId(const std::string& strTxId, CX509Certificate& certificate);
@@ -37,7 +43,14 @@ bool UndoAddCertificate(const CX509Certificate& certificate);
 bool CheckCertificateDB();
 bool FlushCertificateLevelDB();
 bool CheckCertificateTx(const CTransactionRef& tx, const CScript& scriptOp, const int& op1, const int& op2, const std::vector<std::vector<unsigned char> >& vvchArgs, 
-                                const bool fJustCheck, const int& nHeight, const uint32_t& nBlockTime, const bool bSanityCheck, std::string& errorMessage);
+                                const bool fJustCheck, const int& nHeight, const uint32_t& nBlockTime, const bool bSanityCheck, std::string& errorMessage, const bool fPreChecked = false);
+/**
+ * Checks the PEM and the subject and issuer signatures of a certificate without
+ * changing any database, so it can run on several threads. vvchObjectPaths
+ * returns the accounts it read. CheckCertificateTx skips these checks when
+ * fPreChecked is set.
+ */
+bool PreCheckCertificateTx(const CTransactionRef& tx, const int& nHeight, std::vector<std::vector<unsigned char> >& vvchObjectPaths, std::string& errorMessage);
 
 extern CCertificateDB *pCertificateDB;
 
@@ -8,6 +8,7 @@
 #include "base58.h"
 #include "bdap/fees.h"
 #include "coins.h"
+#include "memusage.h"
 #include "bdap/utils.h"
 #include "utilmoneystr.h"
 #include "utiltime.h"
@@ -18,9 +19,132 @@
 
 #include <boost/thread.hpp>
 
+#include <algorithm>
+#include <limits>
+#include <set>
+
 
 CDomainEntryDB *pDomainEntryDB = NULL;
 
+// Secondary index for listing entries by object location and type:
+// ("dl", ((object location, object type), object ID)) -> full object path
+typedef std::pair<std::pair<CharString, unsigned int>, CharString> DirectoryIndexPos;
+typedef std::pair<std::string, DirectoryIndexPos> DirectoryIndexKey;
+
+static const std::string DIRECTORY_INDEX_KEY = "dl";
+static const std::string DIRECTORY_INDEX_VERSION_KEY = "dlversion";
+static const int DIRECTORY_INDEX_VERSION = 3;
+// Bytes of index records written at once while building the index
+static const size_t DIRECTORY_INDEX_BATCH_SIZE = 16 << 20;
+
+static DirectoryIndexPos GetDirectoryIndexPos(const CDomainEntry& entry)
+{
+    return std::make_pair(std::make_pair(entry.vchObjectLocation(), entry.nObjectType), entry.ObjectID);
+}
+
+/** An expiry time serialized big-endian, so the expiry index sorts by time */
+struct CExpiryIndexTime {
+    uint64_t nTime;
+
+    explicit CExpiryIndexTime(uint64_t nTimeIn = 0) : nTime(nTimeIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata64be(s, nTime);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        nTime = ser_readdata64be(s);
+    }
+};
+
+// Expiry index for removing expired entries oldest first:
+// ("de", (expire time, full object path)) -> empty
+typedef std::pair<CExpiryIndexTime, CharString> ExpiryIndexPos;
+typedef std::pair<std::string, ExpiryIndexPos> ExpiryIndexKey;
+
+static const std::string EXPIRY_INDEX_KEY = "de";
+
+static ExpiryIndexKey GetExpiryIndexKey(const CDomainEntry& entry)
+{
+    return std::make_pair(EXPIRY_INDEX_KEY, std::make_pair(CExpiryIndexTime(entry.nExpireTime), entry.vchFullObjectPath()));
+}
+
+// Search index over ObjectID and CommonName:
+// ("ds", (gram, full object path)) -> empty
+// Every substring of SEARCH_GRAM_SIZE characters is a gram, as are the last
+// shorter tails of a field padded with zero bytes, so all grams have the same
+// serialized size. A longer search string is answered by intersecting the
+// entries of its grams; a shorter one by a prefix scan over the grams.
+typedef std::pair<CharString, CharString> SearchIndexPos;
+typedef std::pair<std::string, SearchIndexPos> SearchIndexKey;
+
+static const std::string SEARCH_INDEX_KEY = "ds";
+static const size_t SEARCH_GRAM_SIZE = 3;
+
+static void AddSearchGrams(const CharString& vchField, std::set<CharString>& setGrams)
+{
+    for (size_t i = 0; i < vchField.size(); i++) {
+        CharString vchGram(vchField.begin() + i, vchField.begin() + std::min(i + SEARCH_GRAM_SIZE, vchField.size()));
+        vchGram.resize(SEARCH_GRAM_SIZE, 0);
+        setGrams.insert(vchGram);
+    }
+}
+
+static std::set<CharString> GetSearchGrams(const CDomainEntry& entry)
+{
+    std::set<CharString> setGrams;
+    AddSearchGrams(entry.ObjectID, setGrams);
+    AddSearchGrams(entry.CommonName, setGrams);
+    return setGrams;
+}
+
+// Adds the directory, expiry and search index records of an entry to batch
+static void WriteEntryIndexes(CBDAPDBBatch& batch, const CDomainEntry& entry)
+{
+    const CharString vchObjectPath = entry.vchFullObjectPath();
+    batch.Write(make_pair(DIRECTORY_INDEX_KEY, GetDirectoryIndexPos(entry)), vchObjectPath);
+    batch.Write(GetExpiryIndexKey(entry), CharString());
+    for (const CharString& vchGram : GetSearchGrams(entry))
+        batch.Write(make_pair(SEARCH_INDEX_KEY, make_pair(vchGram, vchObjectPath)), CharString());
+}
+
+static void EraseEntryIndexes(CBDAPDBBatch& batch, const CDomainEntry& entry)
+{
+    const CharString vchObjectPath = entry.vchFullObjectPath();
+    batch.Erase(make_pair(DIRECTORY_INDEX_KEY, GetDirectoryIndexPos(entry)));
+    batch.Erase(GetExpiryIndexKey(entry));
+    for (const CharString& vchGram : GetSearchGrams(entry))
+        batch.Erase(make_pair(SEARCH_INDEX_KEY, make_pair(vchGram, vchObjectPath)));
+}
+
+// Search results rank exact and prefix matches on the ObjectID first
+static int GetSearchRank(const CDomainEntry& entry, const std::string& searchString)
+{
+    const std::string strObjectID = stringFromVch(entry.ObjectID);
+    if (strObjectID == searchString)
+        return 0;
+    if (strObjectID.compare(0, searchString.size(), searchString) == 0)
+        return 1;
+    if (stringFromVch(entry.CommonName).compare(0, searchString.size(), searchString) == 0)
+        return 2;
+    return 3;
+}
+
+static bool MatchesSearchString(const CDomainEntry& entry, const std::string& searchString)
+{
+    if (searchString.empty())
+        return true;
+
+    //compare to ObjectID and Common Name
+    std::string compareString(entry.ObjectID.begin(), entry.ObjectID.end());
+    std::string compareCommonString(entry.CommonName.begin(), entry.CommonName.end());
+    return compareString.find(searchString) != std::string::npos || compareCommonString.find(searchString) != std::string::npos;
+}
+
 bool GetDomainEntry(const std::vector<unsigned char>& vchObjectPath, CDomainEntry& entry)
 {
     if (!pDomainEntryDB || !pDomainEntryDB->ReadDomainEntry(vchObjectPath, entry))
@@ -87,13 +211,65 @@ bool UndoDeleteDomainEntry(const CDomainEntry& entry)
     return false;
 }
 
+size_t CDomainEntryCache::ItemUsage(const item_t& item)
+{
+    // The key is held by both the list item and the index
+    return memusage::MallocUsage(sizeof(item_t) + 2 * sizeof(void*)) + memusage::MallocUsage(sizeof(CharString) + sizeof(list_t::iterator) + 4 * sizeof(void*))
+               + 2 * memusage::DynamicUsage(item.first) + ::GetSerializeSize(item.second, SER_DISK, CLIENT_VERSION);
+}
+
+bool CDomainEntryCache::Get(const CharString& vchKey, CDomainEntry& entry)
+{
+    std::map<CharString, list_t::iterator>::iterator it = mapIndex.find(vchKey);
+    if (it == mapIndex.end())
+        return false;
+    listItems.splice(listItems.begin(), listItems, it->second);
+    entry = it->second->second;
+    return true;
+}
+
+void CDomainEntryCache::Insert(const CharString& vchKey, const CDomainEntry& entry)
+{
+    Erase(vchKey);
+    listItems.emplace_front(vchKey, entry);
+    mapIndex.emplace(vchKey, listItems.begin());
+    nUsage += ItemUsage(listItems.front());
+    while (nUsage > nMaxUsage && !listItems.empty()) {
+        nUsage -= ItemUsage(listItems.back());
+        mapIndex.erase(listItems.back().first);
+        listItems.pop_back();
+    }
+}
+
+void CDomainEntryCache::Erase(const CharString& vchKey)
+{
+    std::map<CharString, list_t::iterator>::iterator it = mapIndex.find(vchKey);
+    if (it == mapIndex.end())
+        return;
+    nUsage -= ItemUsage(*it->second);
+    listItems.erase(it->second);
+    mapIndex.erase(it);
+}
+
+void CDomainEntryCache::Clear()
+{
+    mapIndex.clear();
+    listItems.clear();
+    nUsage = 0;
+}
+
 bool CDomainEntryDB::AddDomainEntry(const CDomainEntry& entry, const int op) 
 { 
     bool writeState = false;
     {
         LOCK(cs_bdap_entry);
-        writeState = Write(make_pair(std::string("dc"), entry.vchFullObjectPath()), entry) 
-                         && Write(make_pair(std::string("pk"), entry.DHTPublicKey), entry);
+        entryCache.Erase(entry.vchFullObjectPath());
+        pubKeyCache.Erase(entry.DHTPublicKey);
+        CBDAPDBBatch batch;
+        batch.Write(make_pair(std::string("dc"), entry.vchFullObjectPath()), entry);
+        batch.Write(make_pair(std::string("pk"), entry.DHTPublicKey), entry);
+        WriteEntryIndexes(batch, entry);
+        writeState = WriteBatch(batch);
     }
     if (writeState)
         AddDomainEntryIndex(entry, op);
@@ -114,13 +290,36 @@ void CDomainEntryDB::AddDomainEntryIndex(const CDomainEntry& entry, const int op
 bool CDomainEntryDB::ReadDomainEntry(const std::vector<unsigned char>& vchObjectPath, CDomainEntry& entry) 
 {
     LOCK(cs_bdap_entry);
-    return CDBWrapper::Read(make_pair(std::string("dc"), vchObjectPath), entry);
+    const std::pair<std::string, CharString> key = make_pair(std::string("dc"), vchObjectPath);
+    // Values of the block being staged are only seen by its thread, and never cached
+    if (IsStaged(key))
+        return Read(key, entry);
+    if (entryCache.Get(vchObjectPath, entry)) {
+        nCacheHits++;
+        return true;
+    }
+    nCacheMisses++;
+    if (!Read(key, entry))
+        return false;
+    entryCache.Insert(vchObjectPath, entry);
+    return true;
 }
 
 bool CDomainEntryDB::ReadDomainEntryPubKey(const std::vector<unsigned char>& vchPubKey, CDomainEntry& entry) 
 {
     LOCK(cs_bdap_entry);
-    return CDBWrapper::Read(make_pair(std::string("pk"), vchPubKey), entry);
+    const std::pair<std::string, CharString> key = make_pair(std::string("pk"), vchPubKey);
+    if (IsStaged(key))
+        return Read(key, entry);
+    if (pubKeyCache.Get(vchPubKey, entry)) {
+        nCacheHits++;
+        return true;
+    }
+    nCacheMisses++;
+    if (!Read(key, entry))
+        return false;
+    pubKeyCache.Insert(vchPubKey, entry);
+    return true;
 }
 
 bool CDomainEntryDB::EraseDomainEntry(const std::vector<unsigned char>& vchObjectPath) 
@@ -132,7 +331,11 @@ bool CDomainEntryDB::EraseDomainEntry(const std::vector<unsigned char>& vchObjec
         return false;
     }
 
-    return CDBWrapper::Erase(make_pair(std::string("dc"), vchObjectPath));
+    entryCache.Erase(vchObjectPath);
+    CBDAPDBBatch batch;
+    batch.Erase(make_pair(std::string("dc"), vchObjectPath));
+    EraseEntryIndexes(batch, entry);
+    return WriteBatch(batch);
 }
 
 bool CDomainEntryDB::EraseDomainEntryPubKey(const std::vector<unsigned char>& vchPubKey) 
@@ -142,53 +345,74 @@ bool CDomainEntryDB::EraseDomainEntryPubKey(const std::vector<unsigned char>& vc
     if (!ReadDomainEntryPubKey(vchPubKey, entry)) 
         return false;
 
-    return CDBWrapper::Erase(make_pair(std::string("pk"), vchPubKey));
+    pubKeyCache.Erase(vchPubKey);
+    return Erase(make_pair(std::string("pk"), vchPubKey));
 }
 
 bool CDomainEntryDB::DomainEntryExists(const std::vector<unsigned char>& vchObjectPath)
 {
     LOCK(cs_bdap_entry);
-    return CDBWrapper::Exists(make_pair(std::string("dc"), vchObjectPath));
+    const std::pair<std::string, CharString> key = make_pair(std::string("dc"), vchObjectPath);
+    if (IsStaged(key))
+        return Exists(key);
+    if (entryCache.HasKey(vchObjectPath)) {
+        nCacheHits++;
+        return true;
+    }
+    nCacheMisses++;
+    return Exists(key);
 }
 
 bool CDomainEntryDB::DomainEntryExistsPubKey(const std::vector<unsigned char>& vchPubKey) 
 {
     LOCK(cs_bdap_entry);
-    return CDBWrapper::Exists(make_pair(std::string("pk"), vchPubKey));
+    const std::pair<std::string, CharString> key = make_pair(std::string("pk"), vchPubKey);
+    if (IsStaged(key))
+        return Exists(key);
+    if (pubKeyCache.HasKey(vchPubKey)) {
+        nCacheHits++;
+        return true;
+    }
+    nCacheMisses++;
+    return Exists(key);
 }
 
-bool CDomainEntryDB::RemoveExpired(int& entriesRemoved)
+// Removes entries that expired at or before nExpiredTime, oldest first, and
+// stops after nMaxRemove of them. Only the expired range of the expiry index
+// is read, so the cost follows the number of expired entries. ConnectBlock
+// runs it for every block, so the index is read as committed before the
+// block and entries added by the block are removed by a later one.
+bool CDomainEntryDB::RemoveExpired(const uint64_t nExpiredTime, const unsigned int nMaxRemove, int& entriesRemoved)
 {
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
-    pcursor->SeekToFirst();
-    CDomainEntry entry;
-    std::pair<std::string, std::vector<unsigned char> > key;
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        try {
-            if (pcursor->GetKey(key) && key.first == "dc") {
-                pcursor->GetValue(entry);
-                  if ((unsigned int)chainActive.Tip()->GetMedianTimePast() >= entry.nExpireTime)
-                {
-                    entriesRemoved++;
-                    EraseDomainEntry(key.second);
-                }
-            }
-            else if (pcursor->GetKey(key) && key.first == "txid") {
-                std::vector<unsigned char> value;
-                CDomainEntry entry;
-                pcursor->GetValue(value);
-                if (GetDomainEntry(value, entry) && (unsigned int)chainActive.Tip()->GetMedianTimePast() >= entry.nExpireTime)
-                {
-                    entriesRemoved++;
-                    EraseDomainEntryPubKey(entry.DHTPublicKey);
-                }
-            }
+    LOCK(cs_bdap_entry);
+    std::vector<ExpiryIndexPos> vExpired;
+    {
+        ExpiryIndexKey key;
+        std::unique_ptr<CDBIterator> pcursor(NewIterator());
+        pcursor->Seek(EXPIRY_INDEX_KEY);
+        while (pcursor->Valid() && vExpired.size() < nMaxRemove) {
+            if (!pcursor->GetKey(key) || key.first != EXPIRY_INDEX_KEY || key.second.first.nTime > nExpiredTime)
+                break;
+            vExpired.push_back(key.second);
             pcursor->Next();
-        } catch (std::exception &e) {
-            return error("%s() : deserialize error", __PRETTY_FUNCTION__);
         }
     }
+
+    for (const ExpiryIndexPos& pos : vExpired) {
+        CDomainEntry entry;
+        if (!ReadDomainEntry(pos.second, entry) || entry.nExpireTime != pos.first.nTime) {
+            // The entry is gone or was rewritten with a new expiry time, drop the stale index key
+            Erase(make_pair(EXPIRY_INDEX_KEY, pos));
+            continue;
+        }
+        if (!EraseDomainEntry(pos.second))
+            return error("%s() : failed to erase %s", __PRETTY_FUNCTION__, stringFromVch(pos.second));
+        // The public key may have moved on to a newer entry
+        CDomainEntry pubKeyEntry;
+        if (ReadDomainEntryPubKey(entry.DHTPublicKey, pubKeyEntry) && pubKeyEntry.vchFullObjectPath() == pos.second)
+            EraseDomainEntryPubKey(entry.DHTPublicKey);
+        entriesRemoved++;
+    }
     return true;
 }
 
@@ -219,18 +443,28 @@ bool CDomainEntryDB::UpdateDomainEntry(const std::vector<unsigned char>& vchObje
 {
     LOCK(cs_bdap_entry);
 
-    if (!EraseDomainEntry(vchObjectPath)) {
-        LogPrintf("CDomainEntryDB::%s -- EraseDomainEntry failed. vchObjectPath = %s\n", __func__, stringFromVch(vchObjectPath));
+    CDomainEntry prevEntry;
+    if (!ReadDomainEntry(vchObjectPath, prevEntry)) {
+        LogPrintf("CDomainEntryDB::%s -- ReadDomainEntry failed. vchObjectPath = %s\n", __func__, stringFromVch(vchObjectPath));
         return false;
     }
-    if (!EraseDomainEntryPubKey(entry.DHTPublicKey)) {
-        LogPrintf("CDomainEntryDB::%s -- EraseDomainEntryPubKey failed. vchObjectPath = %s\n", __func__, stringFromVch(entry.DHTPublicKey));
+    CDomainEntry prevPubKeyEntry;
+    if (!ReadDomainEntryPubKey(entry.DHTPublicKey, prevPubKeyEntry)) {
+        LogPrintf("CDomainEntryDB::%s -- ReadDomainEntryPubKey failed. vchObjectPath = %s\n", __func__, stringFromVch(entry.DHTPublicKey));
         return false;
     }
 
-    bool writeState = false;
-    writeState = Update(make_pair(std::string("dc"), entry.vchFullObjectPath()), entry) 
-                    && Update(make_pair(std::string("pk"), entry.DHTPublicKey), entry);
+    entryCache.Erase(vchObjectPath);
+    entryCache.Erase(entry.vchFullObjectPath());
+    pubKeyCache.Erase(entry.DHTPublicKey);
+    // The old records and indexes are replaced in the same batch
+    CBDAPDBBatch batch;
+    batch.Erase(make_pair(std::string("dc"), vchObjectPath));
+    EraseEntryIndexes(batch, prevEntry);
+    batch.Write(make_pair(std::string("dc"), entry.vchFullObjectPath()), entry);
+    batch.Write(make_pair(std::string("pk"), entry.DHTPublicKey), entry);
+    WriteEntryIndexes(batch, entry);
+    bool writeState = WriteBatch(batch);
     if (writeState)
         AddDomainEntryIndex(entry, OP_BDAP_MODIFY);
 
@@ -240,88 +474,223 @@ bool CDomainEntryDB::UpdateDomainEntry(const std::vector<unsigned char>& vchObje
 // Removes expired records from databases.
 bool CDomainEntryDB::CleanupLevelDB(int& nRemoved)
 {
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
-    pcursor->SeekToFirst();
-    CDomainEntry dirEntry;
-    std::pair<std::string, std::vector<unsigned char> > key;
+    return RemoveExpired((unsigned int)chainActive.Tip()->GetMedianTimePast(), std::numeric_limits<unsigned int>::max(), nRemoved);
+}
+
+// Builds the directory, expiry and search indexes for entries written before they existed
+bool CDomainEntryDB::UpgradeDirectoryIndex()
+{
+    LOCK(cs_bdap_entry);
+    int nVersion = 0;
+    if (Read(DIRECTORY_INDEX_VERSION_KEY, nVersion) && nVersion >= DIRECTORY_INDEX_VERSION)
+        return true;
+
+    LogPrintf("CDomainEntryDB::%s -- Building BDAP directory index\n", __func__);
+    int nIndexed = 0;
+    CBDAPDBBatch batch;
+    std::pair<std::string, CharString> key;
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(std::string("dc"));
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
-        try {
-            if (pcursor->GetKey(key) && key.first == "dc") 
-            {
-                pcursor->GetValue(dirEntry);
-                if ((unsigned int)chainActive.Tip()->GetMedianTimePast() >= dirEntry.nExpireTime)
-                {
-                    nRemoved++;
-                    EraseDomainEntry(key.second);
-                }
-            }
-            else if (pcursor->GetKey(key) && key.first == "pk") 
-            {
-                pcursor->GetValue(dirEntry);
-                if ((unsigned int)chainActive.Tip()->GetMedianTimePast() >= dirEntry.nExpireTime)
-                {
-                    nRemoved++;
-                    EraseDomainEntryPubKey(dirEntry.DHTPublicKey);
-                }
-            }
-            pcursor->Next();
-        } catch (std::exception& e) {
+        if (!pcursor->GetKey(key) || key.first != "dc")
+            break;
+        CDomainEntry entry;
+        if (!pcursor->GetValue(entry))
             return error("%s() : deserialize error", __PRETTY_FUNCTION__);
+        WriteEntryIndexes(batch, entry);
+        nIndexed++;
+        if (batch.SizeEstimate() > DIRECTORY_INDEX_BATCH_SIZE) {
+            WriteBatch(batch);
+            batch.Clear();
         }
+        pcursor->Next();
     }
+    batch.Write(DIRECTORY_INDEX_VERSION_KEY, DIRECTORY_INDEX_VERSION);
+    if (!WriteBatch(batch, true))
+        return error("%s() : failed to write directory index", __PRETTY_FUNCTION__);
+
+    LogPrintf("CDomainEntryDB::%s -- Indexed %d BDAP entries\n", __func__, nIndexed);
     return true;
 }
 
 // Lists active entries by domain name with paging support
 bool CDomainEntryDB::ListDirectories(const std::vector<unsigned char>& vchObjectLocation, const unsigned int& nResultsPerPage, const unsigned int& nPage, UniValue& oDomainEntryList, const BDAP::ObjectType& accountType, const std::string searchString)
 {
-    // TODO: (bdap) implement paging
     // if vchObjectLocation is empty, list entries from all domains
-    int index = 0;
-    bool addEntry = true;
-    std::pair<std::string, CharString> key;
+    std::vector<CDomainEntry> vEntries;
+    std::vector<unsigned char> vchNextCursor;
+    unsigned int nSkip = nPage > 0 ? (nPage - 1) * nResultsPerPage : 0;
+    if (!searchString.empty()) {
+        if (!SearchDomainEntries(searchString, vchObjectLocation, accountType, nSkip, nResultsPerPage, vEntries))
+            return false;
+    } else if (!ScanDirectoryIndex(vchObjectLocation, accountType, std::vector<unsigned char>(), nSkip, nResultsPerPage, searchString, vEntries, vchNextCursor)) {
+        return false;
+    }
+
+    for (const CDomainEntry& entry : vEntries) {
+        UniValue oDomainEntryEntry(UniValue::VOBJ);
+        BuildBDAPJson(entry, oDomainEntryEntry, false);
+        oDomainEntryList.push_back(oDomainEntryEntry);
+    }
+    return true;
+}
+
+// Lists up to nMaxResults entries following vchCursor (empty for the first
+// page). When the page fills up vchNextCursor is set to continue after its
+// last entry, otherwise it is left empty as the listing has no more entries.
+bool CDomainEntryDB::ListDirectories(const std::vector<unsigned char>& vchObjectLocation, const BDAP::ObjectType& accountType, const std::vector<unsigned char>& vchCursor, const unsigned int& nMaxResults, std::vector<CDomainEntry>& vEntries, std::vector<unsigned char>& vchNextCursor, const std::string searchString)
+{
+    return ScanDirectoryIndex(vchObjectLocation, accountType, vchCursor, 0, nMaxResults, searchString, vEntries, vchNextCursor);
+}
+
+// Finds the entries whose ObjectID or CommonName contains searchString,
+// optionally within one location and type. Matches are ranked by
+// GetSearchRank and then by full path; nSkip of them are skipped and up to
+// nMaxResults returned.
+bool CDomainEntryDB::SearchDomainEntries(const std::string& searchString, const std::vector<unsigned char>& vchObjectLocation, const BDAP::ObjectType& accountType, const unsigned int nSkip, const unsigned int nMaxResults, std::vector<CDomainEntry>& vEntries)
+{
+    if (searchString.empty() || nMaxResults == 0)
+        return true;
+
+    const CharString vchSearch = vchFromString(searchString);
+    std::set<CharString> setCandidates;
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
-    pcursor->SeekToFirst();
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
+    SearchIndexKey key;
+    if (vchSearch.size() < SEARCH_GRAM_SIZE) {
+        // Every occurrence starts some gram
+        CharString vchStart = vchSearch;
+        vchStart.resize(SEARCH_GRAM_SIZE, 0);
+        pcursor->Seek(make_pair(SEARCH_INDEX_KEY, make_pair(vchStart, CharString())));
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            if (!pcursor->GetKey(key) || key.first != SEARCH_INDEX_KEY || !std::equal(vchSearch.begin(), vchSearch.end(), key.second.first.begin()))
+                break;
+            setCandidates.insert(key.second.second);
+            pcursor->Next();
+        }
+    } else {
+        // Candidates hold every gram of the search string
+        for (size_t i = 0; i + SEARCH_GRAM_SIZE <= vchSearch.size(); i++) {
+            const CharString vchGram(vchSearch.begin() + i, vchSearch.begin() + i + SEARCH_GRAM_SIZE);
+            std::set<CharString> setGramEntries;
+            pcursor->Seek(make_pair(SEARCH_INDEX_KEY, make_pair(vchGram, CharString())));
+            while (pcursor->Valid()) {
+                boost::this_thread::interruption_point();
+                if (!pcursor->GetKey(key) || key.first != SEARCH_INDEX_KEY || key.second.first != vchGram)
+                    break;
+                if (i == 0 || setCandidates.count(key.second.second))
+                    setGramEntries.insert(key.second.second);
+                pcursor->Next();
+            }
+            setCandidates.swap(setGramEntries);
+            if (setCandidates.empty())
+                break;
+        }
+    }
+
+    // Grams may match across fields, so candidates are checked against the entry itself
+    const bool fAllTypes = (accountType == DEFAULT_ACCOUNT_TYPE);
+    const unsigned int nObjectType = GetObjectTypeInt(accountType);
+    std::vector<std::pair<int, CDomainEntry> > vMatches;
+    for (const CharString& vchObjectPath : setCandidates) {
         CDomainEntry entry;
+        if (!ReadDomainEntry(vchObjectPath, entry))
+            continue;
+        if (!vchObjectLocation.empty() && entry.vchObjectLocation() != vchObjectLocation)
+            continue;
+        if (!fAllTypes && entry.nObjectType != nObjectType)
+            continue;
+        if (!MatchesSearchString(entry, searchString))
+            continue;
+        vMatches.emplace_back(GetSearchRank(entry, searchString), entry);
+    }
+
+    std::sort(vMatches.begin(), vMatches.end(), [](const std::pair<int, CDomainEntry>& a, const std::pair<int, CDomainEntry>& b) {
+        if (a.first != b.first)
+            return a.first < b.first;
+        return a.second.vchFullObjectPath() < b.second.vchFullObjectPath();
+    });
+    for (size_t i = nSkip; i < vMatches.size() && vEntries.size() < nMaxResults; i++)
+        vEntries.push_back(vMatches[i].second);
+    return true;
+}
+
+bool CDomainEntryDB::ScanDirectoryIndex(const std::vector<unsigned char>& vchObjectLocation, const BDAP::ObjectType& accountType, const std::vector<unsigned char>& vchCursor, unsigned int nSkip, const unsigned int nMaxResults, const std::string& searchString, std::vector<CDomainEntry>& vEntries, std::vector<unsigned char>& vchNextCursor)
+{
+    vchNextCursor.clear();
+    if (nMaxResults == 0)
+        return true;
+
+    const bool fAllTypes = (accountType == DEFAULT_ACCOUNT_TYPE);
+    const unsigned int nObjectType = GetObjectTypeInt(accountType);
+
+    // Entries of one location, and of one type within it, are contiguous in
+    // the index, so the scan starts at the first key with the matching prefix
+    // and stops at the first one past it.
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    DirectoryIndexPos posCursor;
+    if (!vchCursor.empty()) {
         try {
-            if (pcursor->GetKey(key) && key.first == "dc") {
-                pcursor->GetValue(entry);
-                //filter by accountType, unless DEFAULT
-                if ((entry.nObjectType == GetObjectTypeInt(accountType)) ||  (accountType == DEFAULT_ACCOUNT_TYPE)) {
-                    if (vchObjectLocation.empty() || entry.vchObjectLocation() == vchObjectLocation)
-                    {
-                        addEntry = true; //always reset to true
-
-                        if (searchString.size() > 0) {
-                            //compare to ObjectID and Common Name
-                            std::string compareString(entry.ObjectID.begin(), entry.ObjectID.end());
-                            std::string compareCommonString(entry.CommonName.begin(), entry.CommonName.end());
-                            std::size_t found = compareString.find(searchString);
-                            std::size_t foundCommon = compareCommonString.find(searchString);
-
-                            if ((found==std::string::npos) && (foundCommon==std::string::npos))
-                                addEntry = false;
-                        }
-
-                        if (addEntry) 
-                        {
-                            UniValue oDomainEntryEntry(UniValue::VOBJ);
-                            BuildBDAPJson(entry, oDomainEntryEntry, false);
-                            oDomainEntryList.push_back(oDomainEntryEntry);
-                            index++;
-                        }
-                    }
-                } //if entry.nObjectType
-            }
+            CDataStream ssCursor(vchCursor, SER_DISK, CLIENT_VERSION);
+            ssCursor >> posCursor;
+        } catch (const std::exception& e) {
+            return error("%s() : invalid cursor", __PRETTY_FUNCTION__);
+        }
+        pcursor->Seek(make_pair(DIRECTORY_INDEX_KEY, posCursor));
+    } else if (vchObjectLocation.empty()) {
+        pcursor->Seek(DIRECTORY_INDEX_KEY);
+    } else if (fAllTypes) {
+        pcursor->Seek(make_pair(DIRECTORY_INDEX_KEY, vchObjectLocation));
+    } else {
+        pcursor->Seek(make_pair(DIRECTORY_INDEX_KEY, make_pair(vchObjectLocation, nObjectType)));
+    }
+
+    DirectoryIndexKey key;
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        if (!pcursor->GetKey(key) || key.first != DIRECTORY_INDEX_KEY)
+            break;
+        const DirectoryIndexPos& pos = key.second;
+        if (!vchObjectLocation.empty() && pos.first.first != vchObjectLocation)
+            break;
+        if (!fAllTypes && pos.first.second != nObjectType) {
+            if (!vchObjectLocation.empty())
+                break;
             pcursor->Next();
+            continue;
+        }
+        if (!vchCursor.empty() && pos == posCursor) {
+            pcursor->Next();
+            continue;
         }
-        catch (std::exception& e) {
-            return error("%s() : deserialize error", __PRETTY_FUNCTION__);
-        } //try-catch
 
+        // Without a search string skipped entries are counted on the index alone
+        if (searchString.empty() && nSkip > 0) {
+            nSkip--;
+            pcursor->Next();
+            continue;
+        }
+
+        CharString vchObjectPath;
+        CDomainEntry entry;
+        if (!pcursor->GetValue(vchObjectPath) || !ReadDomainEntry(vchObjectPath, entry))
+            return error("%s() : missing entry for index key %s", __PRETTY_FUNCTION__, stringFromVch(pos.second));
+
+        if (MatchesSearchString(entry, searchString)) {
+            if (nSkip > 0) {
+                nSkip--;
+            } else {
+                vEntries.push_back(entry);
+                if (vEntries.size() == nMaxResults) {
+                    CDataStream ssCursor(SER_DISK, CLIENT_VERSION);
+                    ssCursor << pos;
+                    vchNextCursor.assign(ssCursor.begin(), ssCursor.end());
+                    break;
+                }
+            }
+        }
+        pcursor->Next();
     }
     return true;
 }
@@ -349,6 +718,22 @@ bool CDomainEntryDB::GetDomainEntryInfo(const std::vector<unsigned char>& vchFul
     return true;
 }
 
+void CDomainEntryDB::GetCacheInfo(size_t& nEntries, size_t& nUsage, uint64_t& nHits, uint64_t& nMisses)
+{
+    LOCK(cs_bdap_entry);
+    nEntries = entryCache.GetSize() + pubKeyCache.GetSize();
+    nUsage = entryCache.DynamicMemoryUsage() + pubKeyCache.DynamicMemoryUsage();
+    nHits = nCacheHits;
+    nMisses = nCacheMisses;
+}
+
+void CDomainEntryDB::ResetCaches()
+{
+    LOCK(cs_bdap_entry);
+    entryCache.Clear();
+    pubKeyCache.Clear();
+}
+
 bool CheckDomainEntryDB()
 {
     if (!pDomainEntryDB)
@@ -5,19 +5,63 @@
 #ifndef CASH_BDAP_DOMAINENTRYDB_H
 #define CASH_BDAP_DOMAINENTRYDB_H
 
+#include "bdap/bdapdb.h"
 #include "bdap/domainentry.h"
-#include "dbwrapper.h"
 #include "sync.h"
 
+#include <list>
+#include <map>
+
 class CCoinsViewCache;
 
 static CCriticalSection cs_bdap_entry;
 
 const BDAP::ObjectType DEFAULT_ACCOUNT_TYPE = BDAP::ObjectType::BDAP_DEFAULT_TYPE;
 
-class CDomainEntryDB : public CDBWrapper {
+/** Default for -bdapentrycache, the memory in MiB of decoded BDAP entries kept */
+static const int64_t DEFAULT_BDAP_ENTRY_CACHE = 16;
+
+/**
+ * The most recently used entries of one key space of the BDAP entry
+ * database, bounded by their estimated memory usage.
+ */
+class CDomainEntryCache
+{
+private:
+    typedef std::pair<CharString, CDomainEntry> item_t;
+    typedef std::list<item_t> list_t;
+
+    size_t nMaxUsage;
+    size_t nUsage;
+    list_t listItems;
+    std::map<CharString, list_t::iterator> mapIndex;
+
+    static size_t ItemUsage(const item_t& item);
+
+public:
+    explicit CDomainEntryCache(size_t nMaxUsageIn) : nMaxUsage(nMaxUsageIn), nUsage(0) {}
+
+    bool Get(const CharString& vchKey, CDomainEntry& entry);
+    bool HasKey(const CharString& vchKey) const { return mapIndex.count(vchKey) > 0; }
+    void Insert(const CharString& vchKey, const CDomainEntry& entry);
+    void Erase(const CharString& vchKey);
+    void Clear();
+    size_t GetSize() const { return listItems.size(); }
+    size_t DynamicMemoryUsage() const { return nUsage; }
+};
+
+class CDomainEntryDB : public CBDAPDB {
+private:
+    // Entries by full object path ("dc") and by DHT public key ("pk")
+    CDomainEntryCache entryCache;
+    CDomainEntryCache pubKeyCache;
+    uint64_t nCacheHits;
+    uint64_t nCacheMisses;
+
 public:
-    CDomainEntryDB(size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate) : CDBWrapper(GetDataDir() / "blocks" / "bdap-entries", nCacheSize, fMemory, fWipe, obfuscate) {
+    CDomainEntryDB(size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate, size_t nEntryCacheSize = DEFAULT_BDAP_ENTRY_CACHE << 20)
+        : CBDAPDB(GetDataDir() / "blocks" / "bdap-entries", nCacheSize, fMemory, fWipe, obfuscate),
+          entryCache(nEntryCacheSize / 2), pubKeyCache(nEntryCacheSize / 2), nCacheHits(0), nCacheMisses(0) {
     }
 
     // Add, Read, Modify, ModifyRDN, Delete, List, Search, Bind, and Compare
@@ -29,14 +73,24 @@ public:
     bool EraseDomainEntryPubKey(const std::vector<unsigned char>& vchPubKey);
     bool DomainEntryExists(const std::vector<unsigned char>& vchObjectPath);
     bool DomainEntryExistsPubKey(const std::vector<unsigned char>& vchPubKey);
-    bool RemoveExpired(int& entriesRemoved);
+    bool RemoveExpired(const uint64_t nExpiredTime, const unsigned int nMaxRemove, int& entriesRemoved);
     void WriteDomainEntryIndex(const CDomainEntry& entry, const int op);
     void WriteDomainEntryIndexHistory(const CDomainEntry& entry, const int op);
     bool UpdateDomainEntry(const std::vector<unsigned char>& vchObjectPath, const CDomainEntry& entry);
     bool CleanupLevelDB(int& nRemoved);
     bool ListDirectories(const std::vector<unsigned char>& vchObjectLocation, const unsigned int& nResultsPerPage, const unsigned int& nPage, UniValue& oDomainEntryList, const BDAP::ObjectType& accountType = DEFAULT_ACCOUNT_TYPE, const std::string searchString = "");
+    bool ListDirectories(const std::vector<unsigned char>& vchObjectLocation, const BDAP::ObjectType& accountType, const std::vector<unsigned char>& vchCursor, const unsigned int& nMaxResults, std::vector<CDomainEntry>& vEntries, std::vector<unsigned char>& vchNextCursor, const std::string searchString = "");
+    bool SearchDomainEntries(const std::string& searchString, const std::vector<unsigned char>& vchObjectLocation, const BDAP::ObjectType& accountType, const unsigned int nSkip, const unsigned int nMaxResults, std::vector<CDomainEntry>& vEntries);
+    bool UpgradeDirectoryIndex();
     bool GetDomainEntryInfo(const std::vector<unsigned char>& vchFullObjectPath, UniValue& oDomainEntryInfo);
     bool GetDomainEntryInfo(const std::vector<unsigned char>& vchFullObjectPath, CDomainEntry& entry);
+    void GetCacheInfo(size_t& nEntries, size_t& nUsage, uint64_t& nHits, uint64_t& nMisses);
+
+protected:
+    void ResetCaches() override;
+
+private:
+    bool ScanDirectoryIndex(const std::vector<unsigned char>& vchObjectLocation, const BDAP::ObjectType& accountType, const std::vector<unsigned char>& vchCursor, unsigned int nSkip, const unsigned int nMaxResults, const std::string& searchString, std::vector<CDomainEntry>& vEntries, std::vector<unsigned char>& vchNextCursor);
 };
 
 bool GetDomainEntry(const std::vector<unsigned char>& vchObjectPath, CDomainEntry& entry);
@@ -40,7 +40,7 @@ bool CLinkDB::AddLinkIndex(const vchCharString& vvchOpParameters, const uint256&
 bool CLinkDB::ReadLinkIndex(const std::vector<unsigned char>& vchPubKey, uint256& txid)
 {
     LOCK(cs_link);
-    return CDBWrapper::Read(make_pair(std::string("pubkey"), vchPubKey), txid);
+    return Read(make_pair(std::string("pubkey"), vchPubKey), txid);
 }
 
 bool CLinkDB::EraseLinkIndex(const std::vector<unsigned char>& vchPubKey, const std::vector<unsigned char>& vchSharedPubKey)
@@ -52,17 +52,17 @@ bool CLinkDB::EraseLinkIndex(const std::vector<unsigned char>& vchPubKey, const
 
     bool result = false;
     LOCK(cs_link);
-    result = CDBWrapper::Erase(make_pair(std::string("pubkey"), vchPubKey));
+    result = Erase(make_pair(std::string("pubkey"), vchPubKey));
     if (!result)
         return false;
 
-    return CDBWrapper::Erase(make_pair(std::string("pubkey"), vchSharedPubKey));
+    return Erase(make_pair(std::string("pubkey"), vchSharedPubKey));
 }
 
 bool CLinkDB::LinkExists(const std::vector<unsigned char>& vchPubKey)
 {
     LOCK(cs_link);
-    return CDBWrapper::Exists(make_pair(std::string("pubkey"), vchPubKey));
+    return Exists(make_pair(std::string("pubkey"), vchPubKey));
 }
 
 bool GetLinkIndex(const std::vector<unsigned char>& vchPubKey, uint256& txid)
@@ -5,17 +5,17 @@
 #ifndef CASH_BDAP_LINKINGDB_H
 #define CASH_BDAP_LINKINGDB_H
 
+#include "bdap/bdapdb.h"
 #include "bdap/linking.h"
-#include "dbwrapper.h"
 #include "sync.h"
 
 class uint256;
 
 static CCriticalSection cs_link;
 
-class CLinkDB : public CDBWrapper {
+class CLinkDB : public CBDAPDB {
 public:
-    CLinkDB(size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate) : CDBWrapper(GetDataDir() / "blocks" / "links", nCacheSize, fMemory, fWipe, obfuscate) {
+    CLinkDB(size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate) : CBDAPDB(GetDataDir() / "blocks" / "links", nCacheSize, fMemory, fWipe, obfuscate) {
     }
 
     bool AddLinkIndex(const vchCharString& vvchOpParameters, const uint256& txid);
@@ -10,11 +10,22 @@
 #include "bdap/utils.h"
 #include "bdap/vgp/include/encryption.h" // for VGP DecryptBDAPData
 #include "dht/ed25519.h"
+#include "hash.h"
 #include "pubkey.h"
+#include "random.h"
 #include "wallet/wallet.h"
 
+#include <limits>
+
 CLinkManager* pLinkManager = NULL;
 
+LinkPubKeyHasher::LinkPubKeyHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+size_t LinkPubKeyHasher::operator()(const std::vector<unsigned char>& vchPubKey) const
+{
+    return CSipHasher(k0, k1).Write(vchPubKey.data(), vchPubKey.size()).Finalize();
+}
+
 //#ifdef ENABLE_WALLET
 
 std::string CLink::LinkState() const
@@ -123,24 +134,9 @@ bool CLinkManager::IsLinkForMe(const std::vector<unsigned char>& vchLinkPubKey,
     if (!pwalletMain)
         return false;
 
-    std::vector<std::vector<unsigned char>> vvchMyDHTPubKeys;
-    if (!pwalletMain->GetDHTPubKeys(vvchMyDHTPubKeys))
-        return false;
-
-    if (vvchMyDHTPubKeys.size() == 0)
-        return false;
-
-    for (const std::vector<unsigned char>& vchMyDHTPubKey : vvchMyDHTPubKeys) {
-        CKeyID keyID(Hash160(vchMyDHTPubKey.begin(), vchMyDHTPubKey.end()));
-        CKeyEd25519 dhtKey;
-        if (pwalletMain->GetDHTKey(keyID, dhtKey)) {
-            std::vector<unsigned char> vchGetSharedPubKey = GetLinkSharedPubKey(dhtKey, vchLinkPubKey);
-            if (vchGetSharedPubKey == vchSharedPubKey)
-                return true;
-        }
-    }
-
-    return false;
+    CKeyID keyID;
+    std::vector<unsigned char> vchMyPubKey;
+    return pwalletMain->GetLinkSharedKey(vchLinkPubKey, vchSharedPubKey, keyID, vchMyPubKey);
 }
 
 bool CLinkManager::GetLinkPrivateKey(const std::vector<unsigned char>& vchSenderPubKey, const std::vector<unsigned char>& vchSharedPubKey, std::array<char, 32>& sharedSeed, std::string& strErrorMessage)
@@ -148,29 +144,23 @@ bool CLinkManager::GetLinkPrivateKey(const std::vector<unsigned char>& vchSender
     if (!pwalletMain)
         return false;
 
-    std::vector<std::vector<unsigned char>> vvchDHTPubKeys;
-    if (!pwalletMain->GetDHTPubKeys(vvchDHTPubKeys)) {
-        strErrorMessage = "Failed to get DHT key vector.";
+    // find the account key that shares the key with the sender
+    CKeyID keyID;
+    std::vector<unsigned char> vchPubKey;
+    if (!pwalletMain->GetLinkSharedKey(vchSenderPubKey, vchSharedPubKey, keyID, vchPubKey))
+        return false;
+
+    CDomainEntry entry;
+    if (!pDomainEntryDB->ReadDomainEntryPubKey(vchPubKey, entry))
+        return false;
+
+    CKeyEd25519 dhtKey;
+    if (!pwalletMain->GetDHTKey(keyID, dhtKey)) {
+        strErrorMessage = strErrorMessage + "Error getting DHT private key.\n";
         return false;
     }
-    // loop through each account key to check if it matches the shared key
-    for (const std::vector<unsigned char>& vchPubKey : vvchDHTPubKeys) {
-        CDomainEntry entry;
-        if (pDomainEntryDB->ReadDomainEntryPubKey(vchPubKey, entry)) {
-            CKeyEd25519 dhtKey;
-            CKeyID keyID(Hash160(vchPubKey.begin(), vchPubKey.end()));
-            if (pwalletMain->GetDHTKey(keyID, dhtKey)) {
-                if (vchSharedPubKey == GetLinkSharedPubKey(dhtKey, vchSenderPubKey)) {
-                    sharedSeed = GetLinkSharedPrivateKey(dhtKey, vchSenderPubKey);
-                    return true;
-                }
-            }
-            else {
-                strErrorMessage = strErrorMessage + "Error getting DHT private key.\n";
-            }
-        }
-    }
-    return false;
+    sharedSeed = GetLinkSharedPrivateKey(dhtKey, vchSenderPubKey);
+    return true;
 }
 #endif // ENABLE_WALLET
 
@@ -185,15 +175,69 @@ bool CLinkManager::FindLink(const uint256& id, CLink& link)
 
 bool CLinkManager::FindLinkBySubjectID(const uint256& subjectID, CLink& getLink)
 {
-    for (const std::pair<uint256, CLink>& link : m_Links)
-    {
-        if (link.second.SubjectID == subjectID) // pending request
-        {
-            getLink = link.second;
-            return true;
-        }
+    std::unordered_map<uint256, uint256, LinkIDHasher>::const_iterator it = m_LinksBySubjectID.find(subjectID);
+    if (it == m_LinksBySubjectID.end())
+        return false;
+
+    return FindLink(it->second, getLink);
+}
+
+bool CLinkManager::FindLinkByPubKey(const std::vector<unsigned char>& vchPubKey, CLink& getLink)
+{
+    std::unordered_map<std::vector<unsigned char>, uint256, LinkPubKeyHasher>::const_iterator it = m_LinksByPubKey.find(vchPubKey);
+    if (it == m_LinksByPubKey.end())
+        return false;
+
+    return FindLink(it->second, getLink);
+}
+
+void CLinkManager::AddLink(const CLink& link)
+{
+    std::map<uint256, CLink>::iterator it = m_Links.find(link.LinkID);
+    if (it != m_Links.end()) {
+        EraseLinkIndexes(it->second);
+        it->second = link;
+    }
+    else {
+        m_Links[link.LinkID] = link;
+    }
+
+    // Links without message info yet have no SubjectID
+    if (!link.SubjectID.IsNull())
+        m_LinksBySubjectID[link.SubjectID] = link.LinkID;
+    if (!link.RequestorPubKey.empty())
+        m_LinksByPubKey[link.RequestorPubKey] = link.LinkID;
+    if (!link.RecipientPubKey.empty())
+        m_LinksByPubKey[link.RecipientPubKey] = link.LinkID;
+    m_LinksByState[link.nLinkState].insert(link.LinkID);
+}
+
+void CLinkManager::RemoveLink(const uint256& id)
+{
+    std::map<uint256, CLink>::iterator it = m_Links.find(id);
+    if (it == m_Links.end())
+        return;
+
+    EraseLinkIndexes(it->second);
+    m_Links.erase(it);
+}
+
+void CLinkManager::EraseLinkIndexes(const CLink& link)
+{
+    std::unordered_map<uint256, uint256, LinkIDHasher>::iterator itSubject = m_LinksBySubjectID.find(link.SubjectID);
+    if (itSubject != m_LinksBySubjectID.end() && itSubject->second == link.LinkID)
+        m_LinksBySubjectID.erase(itSubject);
+    for (const std::vector<unsigned char>* pvchPubKey : {&link.RequestorPubKey, &link.RecipientPubKey}) {
+        std::unordered_map<std::vector<unsigned char>, uint256, LinkPubKeyHasher>::iterator itPubKey = m_LinksByPubKey.find(*pvchPubKey);
+        if (itPubKey != m_LinksByPubKey.end() && itPubKey->second == link.LinkID)
+            m_LinksByPubKey.erase(itPubKey);
+    }
+    std::map<uint8_t, std::set<uint256>>::iterator itState = m_LinksByState.find(link.nLinkState);
+    if (itState != m_LinksByState.end()) {
+        itState->second.erase(link.LinkID);
+        if (itState->second.empty())
+            m_LinksByState.erase(itState);
     }
-    return false;
 }
 
 #ifdef ENABLE_WALLET
@@ -230,11 +274,12 @@ void CLinkManager::ProcessQueue()
 
 bool CLinkManager::ListMyPendingRequests(std::vector<CLink>& vchLinks)
 {
-    for (const std::pair<uint256, CLink>& link : m_Links)
+    for (const uint256& linkID : m_LinksByState[BDAP::LinkState::pending_state])
     {
-        if (link.second.nLinkState == 1 && link.second.fRequestFromMe) // pending request
+        const CLink& link = m_Links.at(linkID);
+        if (link.fRequestFromMe) // pending request
         {
-            vchLinks.push_back(link.second);
+            vchLinks.push_back(link);
         }
     }
     return true;
@@ -242,12 +287,12 @@ bool CLinkManager::ListMyPendingRequests(std::vector<CLink>& vchLinks)
 
 bool CLinkManager::ListMyPendingAccepts(std::vector<CLink>& vchLinks)
 {
-    for (const std::pair<uint256, CLink>& link : m_Links)
+    for (const uint256& linkID : m_LinksByState[BDAP::LinkState::pending_state])
     {
-        //LogPrintf("%s -- link:\n%s\n", __func__, link.second.ToString());
-        if (link.second.nLinkState == 1 && (!link.second.fRequestFromMe || (link.second.fRequestFromMe && link.second.fAcceptFromMe))) // pending accept
+        const CLink& link = m_Links.at(linkID);
+        if (!link.fRequestFromMe || (link.fRequestFromMe && link.fAcceptFromMe)) // pending accept
         {
-            vchLinks.push_back(link.second);
+            vchLinks.push_back(link);
         }
     }
     return true;
@@ -255,11 +300,12 @@ bool CLinkManager::ListMyPendingAccepts(std::vector<CLink>& vchLinks)
 
 bool CLinkManager::ListMyCompleted(std::vector<CLink>& vchLinks)
 {
-    for (const std::pair<uint256, CLink>& link : m_Links)
+    for (const uint256& linkID : m_LinksByState[BDAP::LinkState::complete_state])
     {
-        if (link.second.nLinkState == 2 && !link.second.txHashRequest.IsNull()) // completed link
+        const CLink& link = m_Links.at(linkID);
+        if (!link.txHashRequest.IsNull()) // completed link
         {
-            vchLinks.push_back(link.second);
+            vchLinks.push_back(link);
         }
     }
     return true;
@@ -335,7 +381,7 @@ bool CLinkManager::ProcessLink(const CLinkStorage& storage, const bool fStoreInQ
                         //LogPrintf("%s -- link request = %s\n", __func__, record.ToString());
                     }
                     LogPrint("bdap", "%s -- Clear text link request added to map id = %s\n", __func__, linkID.ToString());
-                    m_Links[linkID] = record;
+                    AddLink(record);
 
                 }
                 else
@@ -392,7 +438,7 @@ bool CLinkManager::ProcessLink(const CLinkStorage& storage, const bool fStoreInQ
                         //LogPrintf("%s -- link accept = %s\n", __func__, record.ToString());
                     }
                     LogPrint("bdap", "%s -- Clear text accept added to map id = %s, %s\n", __func__, linkID.ToString(), record.ToString());
-                    m_Links[linkID] = record;
+                    AddLink(record);
                 }
                 else
                     LogPrintf("%s -- Warning! Link accept found with an invalid signature proof! Link requestor = %s, recipient = %s, pubkey = %s\n", __func__, link.RequestorFQDN(), link.RecipientFQDN(), stringFromVch(storage.vchLinkPubKey));
@@ -479,7 +525,7 @@ bool CLinkManager::ProcessLink(const CLinkStorage& storage, const bool fStoreInQ
                             //LogPrintf("%s -- link request = %s\n", __func__, record.ToString());
                         }
                         LogPrint("bdap", "%s -- Encrypted link request from me added to map id = %s\n%s\n", __func__, linkID.ToString(), record.ToString());
-                        m_Links[linkID] = record;
+                        AddLink(record);
                     }
                     else {
                         LogPrintf("%s -- Link request GetBDAPData failed.\n", __func__);
@@ -564,7 +610,7 @@ bool CLinkManager::ProcessLink(const CLinkStorage& storage, const bool fStoreInQ
                             //LogPrintf("%s -- link request = %s\n", __func__, record.ToString());
                         }
                         LogPrint("bdap", "%s -- Encrypted link request for me added to map id = %s\n%s\n", __func__, linkID.ToString(), record.ToString());
-                        m_Links[linkID] = record;
+                        AddLink(record);
                     }
                     else {
                         LogPrintf("%s -- Link request GetBDAPData failed.\n", __func__);
@@ -641,7 +687,7 @@ bool CLinkManager::ProcessLink(const CLinkStorage& storage, const bool fStoreInQ
                             //LogPrintf("%s -- accept request = %s\n", __func__, record.ToString());
                         }
                         LogPrint("bdap", "%s -- Encrypted link accept from me added to map id = %s\n%s\n", __func__, linkID.ToString(), record.ToString());
-                        m_Links[linkID] = record;
+                        AddLink(record);
                     }
                     else {
                         LogPrintf("%s -- Link accept GetBDAPData failed.\n", __func__);
@@ -719,7 +765,7 @@ bool CLinkManager::ProcessLink(const CLinkStorage& storage, const bool fStoreInQ
                             //LogPrintf("%s -- accept request = %s\n", __func__, record.ToString());
                         }
                         LogPrint("bdap", "%s -- Encrypted link accept for me added to map id = %s\n%s\n", __func__, linkID.ToString(), record.ToString());
-                        m_Links[linkID] = record;
+                        AddLink(record);
                     }
                     else {
                         LogPrintf("%s -- Link accept GetBDAPData failed.\n", __func__);
@@ -748,20 +794,18 @@ bool CLinkManager::ProcessLink(const CLinkStorage& storage, const bool fStoreInQ
 std::vector<CLinkInfo> CLinkManager::GetCompletedLinkInfo(const std::vector<unsigned char>& vchFullObjectPath)
 {
     std::vector<CLinkInfo> vchLinkInfo;
-    for(const std::pair<uint256, CLink>& link : m_Links)
+    for (const uint256& linkID : m_LinksByState[BDAP::LinkState::complete_state])
     {
-        if (link.second.nLinkState == 2) // completed link
+        const CLink& link = m_Links.at(linkID);
+        if (link.RequestorFullObjectPath == vchFullObjectPath)
         {
-            if (link.second.RequestorFullObjectPath == vchFullObjectPath)
-            {
-                CLinkInfo linkInfo(link.second.RecipientFullObjectPath, link.second.RecipientPubKey, link.second.RequestorPubKey);
-                vchLinkInfo.push_back(linkInfo);
-            }
-            else if (link.second.RecipientFullObjectPath == vchFullObjectPath)
-            {
-                CLinkInfo linkInfo(link.second.RequestorFullObjectPath, link.second.RequestorPubKey, link.second.RecipientPubKey);
-                vchLinkInfo.push_back(linkInfo);
-            }
+            CLinkInfo linkInfo(link.RecipientFullObjectPath, link.RecipientPubKey, link.RequestorPubKey);
+            vchLinkInfo.push_back(linkInfo);
+        }
+        else if (link.RecipientFullObjectPath == vchFullObjectPath)
+        {
+            CLinkInfo linkInfo(link.RequestorFullObjectPath, link.RequestorPubKey, link.RecipientPubKey);
+            vchLinkInfo.push_back(linkInfo);
         }
     }
     return vchLinkInfo;
@@ -11,7 +11,9 @@
 #include <array>
 #include <map>
 #include <queue>
+#include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 class CKeyEd25519;
@@ -134,11 +136,32 @@ public:
     std::string ToString() const;
 };
 
+struct LinkIDHasher {
+    size_t operator()(const uint256& hash) const { return hash.GetCheapHash(); }
+};
+
+class LinkPubKeyHasher
+{
+private:
+    /** Salt */
+    const uint64_t k0, k1;
+
+public:
+    LinkPubKeyHasher();
+
+    size_t operator()(const std::vector<unsigned char>& vchPubKey) const;
+};
+
 class CLinkManager {
 private:
     std::queue<CLinkStorage> linkQueue;
     std::map<uint256, CLink> m_Links;
     std::map<uint256, std::vector<unsigned char>> m_LinkMessageInfo;
+    // Indexes of m_Links by SubjectID, by requestor and recipient pubkey and
+    // by link state. Only changed by AddLink and RemoveLink.
+    std::unordered_map<uint256, uint256, LinkIDHasher> m_LinksBySubjectID;
+    std::unordered_map<std::vector<unsigned char>, uint256, LinkPubKeyHasher> m_LinksByPubKey;
+    std::map<uint8_t, std::set<uint256>> m_LinksByState;
 
 public:
     CLinkManager() {
@@ -150,6 +173,9 @@ public:
         std::queue<CLinkStorage> emptyQueue;
         linkQueue = emptyQueue;
         m_Links.clear();
+        m_LinksBySubjectID.clear();
+        m_LinksByPubKey.clear();
+        m_LinksByState.clear();
     }
 
     std::size_t QueueSize() const { return linkQueue.size(); }
@@ -160,6 +186,7 @@ public:
 
     bool FindLink(const uint256& id, CLink& link);
     bool FindLinkBySubjectID(const uint256& subjectID, CLink& getLink);
+    bool FindLinkByPubKey(const std::vector<unsigned char>& vchPubKey, CLink& getLink);
     bool ListMyPendingRequests(std::vector<CLink>& vchLinks);
     bool ListMyPendingAccepts(std::vector<CLink>& vchLinks);
     bool ListMyCompleted(std::vector<CLink>& vchLinks);
@@ -168,8 +195,12 @@ public:
     void LoadLinkMessageInfo(const uint256& subjectID, const std::vector<unsigned char>& vchPubKey);
     bool GetLinkMessageInfo(const uint256& subjectID, std::vector<unsigned char>& vchPubKey);
     bool GetAllMessagesByType(const std::vector<unsigned char> vchMessageType);
+    /** Add a link, or replace the link with the same LinkID, and index it */
+    void AddLink(const CLink& link);
+    void RemoveLink(const uint256& id);
 
 private:
+    void EraseLinkIndexes(const CLink& link);
     bool IsLinkFromMe(const std::vector<unsigned char>& vchLinkPubKey);
     bool IsLinkForMe(const std::vector<unsigned char>& vchLinkPubKey, const std::vector<unsigned char>& vchSharedPubKey);
     bool GetLinkPrivateKey(const std::vector<unsigned char>& vchSenderPubKey, const std::vector<unsigned char>& vchSharedPubKey, std::array<char, 32>& sharedSeed, std::string& strErrorMessage);
@@ -10,6 +10,7 @@
 #include "bdap/linkmanager.h"
 #include "bdap/utils.h"
 #include "bdap/vgp/include/encryption.h" // for VGP DecryptBDAPData
+#include "bdap/vgpmessagestore.h"
 #include "chainparams.h"
 #include "chainparamsbase.h"
 #include "clientversion.h"
@@ -17,23 +18,52 @@
 #include "hash.h"
 #include "key.h"
 #include "net.h" // for g_connman
+#include "net_processing.h" // for Misbehaving
 #include "netmessagemaker.h"
+#include "random.h"
 #include "script/script.h"
 #include "streams.h"
 #include "timedata.h"
 #include "util.h"
+#include "utiltime.h"
+#include "validation.h" // for cs_main
 #include "wallet/wallet.h"
 
 #include <cstdlib>
+#include <deque>
+#include <limits>
 #include <string>
 
-static std::map<uint256, CVGPMessage> mapMyVGPMessages;
-static CCriticalSection cs_mapMyVGPMessages;
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+static CVGPMessageStore myVGPMessages;
+static CCriticalSection cs_myVGPMessages;
 static int nMyMessageCounter = 0;
 
-static std::map<uint256, int64_t> mapRecentMessageLog;
-static CCriticalSection cs_mapRecentMessageLog;
-static int nMessageCounter = 0;
+static CCriticalSection cs_recentMessageLog;
+
+/** Failed messages a peer may still send, refilled at -vgpmessagepeerrate per second up to -vgpmessagepeerburst */
+struct CVGPRateBudget
+{
+    double dMessages;
+    int64_t nLastRefill;
+};
+
+static std::map<NodeId, CVGPRateBudget> mapPeerRateBudgets;
+static CCriticalSection cs_mapPeerRateBudgets;
+
+// Admitted messages waiting for their proof-of-work check, and the peers they came from
+static std::deque<std::pair<CVGPMessage, NodeId> > queueVGPMessageCheck;
+static boost::mutex mutexVGPMessageCheck;
+static boost::condition_variable condVGPMessageCheck;
+
+// Relaying from the check threads and the RPC threads
+static CCriticalSection cs_vgpRelay;
+
+int nVGPMessageCheckThreads = 0;
+int nVGPMessagePeerRate = DEFAULT_VGP_MESSAGE_PEER_RATE;
+int nVGPMessagePeerBurst = DEFAULT_VGP_MESSAGE_PEER_BURST;
 
 class CMessage
 {
@@ -160,27 +190,8 @@ uint256 CUnsignedVGPMessage::GetHash() const
     CDataStream dsMessageData(SER_NETWORK, PROTOCOL_VERSION);
     dsMessageData << *this;
 
-    // Get the current block time
-    uint64_t currentTime = nTimeStamp;
-
     // Determine Argon2d phase
-    int hashPhase = 0;
-
-    #ifdef __APPLE__
-        // On macOS we use hardcoded timestamps
-        if (currentTime >= 1726660000 && currentTime < 4070908800) {
-            hashPhase = 1;
-        } else if (currentTime >= 4070908800) {
-            hashPhase = 2;
-        }
-    #else  // For other platforms (Linux/Windows, etc.)
-        // Default logic based on dynamic switch times
-        if (currentTime >= FirstSwitchTime() && currentTime < SecondSwitchTime()) {
-            hashPhase = 1;
-        } else if (currentTime >= SecondSwitchTime()) {
-            hashPhase = 2;
-        }
-    #endif
+    const unsigned int hashPhase = GetArgon2dPhase(nTimeStamp);
 
     // Return the hash using the determined Argon2d phase
     return hash_Argon2d(dsMessageData.begin(), dsMessageData.end(), hashPhase);
@@ -244,7 +255,7 @@ bool CUnsignedVGPMessage::UnserializeFromData(const std::vector<unsigned char>&
     return true;
 }
 
-std::vector<unsigned char> CUnsignedVGPMessage::Type()
+std::vector<unsigned char> CUnsignedVGPMessage::Type() const
 {
     std::vector<unsigned char> vchType;
     if (fEncrypted)
@@ -254,7 +265,7 @@ std::vector<unsigned char> CUnsignedVGPMessage::Type()
     return message.vchMessageType;
 }
 
-std::vector<unsigned char> CUnsignedVGPMessage::Value()
+std::vector<unsigned char> CUnsignedVGPMessage::Value() const
 {
     std::vector<unsigned char> vchValue;
     if (fEncrypted)
@@ -264,7 +275,7 @@ std::vector<unsigned char> CUnsignedVGPMessage::Value()
     return message.vchMessage;
 }
 
-std::vector<unsigned char> CUnsignedVGPMessage::SenderFQDN()
+std::vector<unsigned char> CUnsignedVGPMessage::SenderFQDN() const
 {
     std::vector<unsigned char> vchSenderFQDN;
     if (fEncrypted)
@@ -274,7 +285,7 @@ std::vector<unsigned char> CUnsignedVGPMessage::SenderFQDN()
     return message.vchSenderFQDN;
 }
 
-bool CUnsignedVGPMessage::KeepLast()
+bool CUnsignedVGPMessage::KeepLast() const
 {
     bool keepLast = false;
     if (fEncrypted)
@@ -284,9 +295,24 @@ bool CUnsignedVGPMessage::KeepLast()
     return message.fKeepLast;
 }
 
-CVGPMessage::CVGPMessage(CUnsignedVGPMessage& unsignedMessage)
+CVGPMessage::CVGPMessage(CUnsignedVGPMessage& unsignedMessageIn)
 {
-    unsignedMessage.Serialize(vchMsg);
+    unsignedMessageIn.Serialize(vchMsg);
+    Decode();
+}
+
+void CVGPMessage::Decode()
+{
+    hash.SetNull();
+    fHashed = false;
+    if (vchMsg.size() == 0) {
+        unsignedMessage.SetNull();
+        fDecoded = false;
+        hashMsg.SetNull();
+        return;
+    }
+    fDecoded = unsignedMessage.UnserializeFromData(vchMsg);
+    hashMsg = Hash(vchMsg.begin(), vchMsg.end());
 }
 
 int CVGPMessage::Version() const
@@ -294,13 +320,14 @@ int CVGPMessage::Version() const
     if (vchMsg.size() == 0)
         return -1;
 
-    return CUnsignedVGPMessage(vchMsg).nVersion;
+    return unsignedMessage.nVersion;
 }
 
 void CVGPMessage::SetNull()
 {
     vchMsg.clear();
     vchSig.clear();
+    Decode();
 }
 
 bool CVGPMessage::IsNull() const
@@ -310,7 +337,11 @@ bool CVGPMessage::IsNull() const
 
 uint256 CVGPMessage::GetHash() const
 {
-    return CUnsignedVGPMessage(vchMsg).GetHash();
+    if (!fHashed && !IsNull()) {
+        hash = unsignedMessage.GetHash();
+        fHashed = true;
+    }
+    return hash;
 }
 
 bool CVGPMessage::IsInEffect() const
@@ -318,22 +349,21 @@ bool CVGPMessage::IsInEffect() const
     if (vchMsg.size() == 0)
         return false;
     // only keep for 1 minute
-    CUnsignedVGPMessage unsignedMessage(vchMsg);
-    return (unsignedMessage.nTimeStamp + 60 >= GetAdjustedTime());
+    return (unsignedMessage.nTimeStamp + VGP_MESSAGE_IN_EFFECT_SECONDS >= GetAdjustedTime());
 }
 
 bool CVGPMessage::RelayMessage(CConnman& connman) const
 {
-    CUnsignedVGPMessage unsignedMessage(vchMsg);
     if (!IsInEffect())
         return false;
 
-    connman.ForEachNode([&connman, this, unsignedMessage](CNode* pnode) {
+    LOCK(cs_vgpRelay);
+    connman.ForEachNode([&connman, this](CNode* pnode) {
         if (pnode->nVersion != 0 && pnode->nVersion >= MIN_VGP_MESSAGE_PEER_PROTO_VERSION)
         {
             CNetMsgMaker msgMaker(pnode->GetSendVersion());
             // returns true if wasn't already contained in the set
-            if (pnode->setKnown.insert(GetHash()).second) {
+            if (pnode->AddKnown(GetHash())) {
                 if (GetAdjustedTime() < unsignedMessage.nRelayUntil) {
                     connman.PushMessage(pnode, msgMaker.Make(NetMsgType::VGPMESSAGE, (*this)));
                 }
@@ -345,7 +375,7 @@ bool CVGPMessage::RelayMessage(CConnman& connman) const
 
 bool CVGPMessage::Sign(const CKey& key)
 {
-    if (!key.Sign(Hash(vchMsg.begin(), vchMsg.end()), vchSig)) {
+    if (!key.Sign(hashMsg, vchSig)) {
         LogPrintf("CVGPMessage::%s -- Failed to sign VGP message.\n", __func__);
         return false;
     }
@@ -356,38 +386,20 @@ bool CVGPMessage::Sign(const CKey& key)
 bool CVGPMessage::CheckSignature(const std::vector<unsigned char>& vchPubKey) const
 {
     CPubKey key(vchPubKey);
-    if (!key.Verify(Hash(vchMsg.begin(), vchMsg.end()), vchSig))
+    if (!key.Verify(hashMsg, vchSig))
         return error("CVGPMessage::%s(): verify signature failed", __func__);
 
     return true;
 }
 
-int CVGPMessage::ProcessMessage(std::string& strErrorMessage) const
+// Checks that need neither the Argon2d hash nor the signature, cheapest first
+int CVGPMessage::CheckMessage(std::string& strErrorMessage) const
 {
     int64_t nCurrentTimeStamp = GetAdjustedTime();
-    CUnsignedVGPMessage unsignedMessage(vchMsg);
-    // TODO (BDAP): Check pubkey is allowed to broadcast VGP messages, set ban score if not.
-    // TODO (BDAP): Check number of messages from this pubkey. make sure it isn't spamming, set ban if too many messages per minute.
-    //std::std::vector<unsigned char> vchWalletPubKey = unsignedMessage.vchWalletPubKey;
-    if (ReceivedMessage(GetHash()))
-    {
-        strErrorMessage = "Message already received.";
-        return -1; // do not relay message again
-    }
-    if (std::abs(nCurrentTimeStamp - unsignedMessage.nTimeStamp) > MAX_MESAGGE_DRIFT_SECONDS)
+    if (!fDecoded)
     {
-        strErrorMessage = "Message exceeds maximum time drift.";
-        return -2; // message too old or into the future (time drift exceeds maximum allowed)
-    }
-    if (unsignedMessage.nTimeStamp >= unsignedMessage.nRelayUntil)
-    {
-        strErrorMessage = "Timestamp is greater than relay until time. Malformed message.";
-        return -3; // timestamp is greater than relay until time
-    }
-    if (std::abs(unsignedMessage.nTimeStamp - unsignedMessage.nRelayUntil) > MAX_MESAGGE_RELAY_SECONDS)
-    {
-        strErrorMessage = "Too much span between timestamp and relay until time.";
-        return -4; // relay time is too much.  max relay is 120 seconds
+        strErrorMessage = "Message can not be decoded. Adding 10 to ban score.";
+        return 10;
     }
     if (unsignedMessage.vchMessageData.size() > MAX_MESSAGE_DATA_LENGTH)
     {
@@ -409,12 +421,34 @@ int CVGPMessage::ProcessMessage(std::string& strErrorMessage) const
         strErrorMessage = "Wallet pubkey is too large. Adding 100 to ban score.";
         return 100; // this will add 100 to the peer's ban score
     }
-    if (!CheckSignature(unsignedMessage.vchWalletPubKey))
+    if (std::abs(nCurrentTimeStamp - unsignedMessage.nTimeStamp) > MAX_MESAGGE_DRIFT_SECONDS)
     {
-        strErrorMessage = "VGP message has an invalid signature. Adding 100 to ban score.";
-        return 100; // this will add 100 to the peer's ban score
+        strErrorMessage = "Message exceeds maximum time drift.";
+        return -2; // message too old or into the future (time drift exceeds maximum allowed)
+    }
+    if (!IsInEffect())
+    {
+        strErrorMessage = "Message is no longer in effect.";
+        return -2; // message too old
+    }
+    if (unsignedMessage.nTimeStamp >= unsignedMessage.nRelayUntil)
+    {
+        strErrorMessage = "Timestamp is greater than relay until time. Malformed message.";
+        return -3; // timestamp is greater than relay until time
+    }
+    if (std::abs(unsignedMessage.nTimeStamp - unsignedMessage.nRelayUntil) > MAX_MESAGGE_RELAY_SECONDS)
+    {
+        strErrorMessage = "Too much span between timestamp and relay until time.";
+        return -4; // relay time is too much.  max relay is 120 seconds
     }
-    if (UintToArith256(unsignedMessage.GetHash()) > UintToArith256(VGP_MESSAGE_MIN_HASH_TARGET))
+    return 0;
+}
+
+// Checks the proof of work of a message that passed CheckMessage and its signature check, and keeps it if it is mine
+int CVGPMessage::ProcessMessage(std::string& strErrorMessage) const
+{
+    // TODO (BDAP): Check pubkey is allowed to broadcast VGP messages, set ban score if not.
+    if (UintToArith256(GetHash()) > UintToArith256(VGP_MESSAGE_MIN_HASH_TARGET))
     {
         LogPrintf("%s -- message proof hash failed to meet target %s\n", __func__, unsignedMessage.ToString());
         strErrorMessage = "Message proof of work is invalid and under the target.";
@@ -442,8 +476,7 @@ bool CVGPMessage::RelayTo(CNode* pnode, CConnman& connman) const
     if (pnode->nVersion != 0 && pnode->nVersion >= MIN_VGP_MESSAGE_PEER_PROTO_VERSION)
     {
         CNetMsgMaker msgMaker(pnode->GetSendVersion());
-        CUnsignedVGPMessage unsignedMessage(vchMsg);
-        if (pnode->setKnown.insert(GetHash()).second) {
+        if (pnode->AddKnown(GetHash())) {
             if (GetAdjustedTime() < unsignedMessage.nRelayUntil) {
                 connman.PushMessage(pnode, msgMaker.Make(NetMsgType::VGPMESSAGE, (*this)));
             }
@@ -464,7 +497,7 @@ bool CVGPMessage::RelayTo(CNode* pnode, CConnman& connman) const
 void CVGPMessage::MineMessage()
 {
     int64_t nStart = GetTimeMillis();
-    CUnsignedVGPMessage message(vchMsg);
+    CUnsignedVGPMessage message = unsignedMessage;
     message.nNonce = 0;
     arith_uint256 besthash = UintToArith256(uint256S("ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff"));
     arith_uint256 hashTarget = UintToArith256(VGP_MESSAGE_MIN_HASH_TARGET);
@@ -482,7 +515,10 @@ void CVGPMessage::MineMessage()
         newhash = UintToArith256(message.GetHash());
     }
     message.Serialize(vchMsg);
-    LogPrintf("%s -- Milliseconds %d, nNonce %d, Hash %s\n", __func__, GetTimeMillis() - nStart, message.nNonce, GetHash().ToString());
+    Decode();
+    hash = ArithToUint256(newhash);
+    fHashed = true;
+    LogPrintf("%s -- Milliseconds %d, nNonce %d, Hash %s\n", __func__, GetTimeMillis() - nStart, message.nNonce, hash.ToString());
 }
 
 #ifdef ENABLE_WALLET
@@ -519,83 +555,255 @@ uint256 GetSubjectIDFromKey(const CKeyEd25519& key)
     return Hash(vchPubKey.begin(), vchPubKey.end());
 }
 
-void CleanupRecentMessageLog()
+CVGPMessageLog::CVGPMessageLog(size_t nMaxHashesIn)
+    : nEpoch(0), nHashes(0), nMaxHashes(nMaxHashesIn),
+      k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max()))
 {
-    int64_t nCurrentTimeStamp =  GetAdjustedTime();
-    std::map<uint256, int64_t>::iterator itr = mapRecentMessageLog.begin();
-    while (itr != mapRecentMessageLog.end())
+    for (CBucket& bucket : buckets)
+        bucket.nEpoch = -1;
+}
+
+uint64_t CVGPMessageLog::GetKey(const uint256& hash) const
+{
+    return SipHashUint256(k0, k1, hash);
+}
+
+void CVGPMessageLog::Expire(int64_t nTime)
+{
+    // Adjusted time can go back a little, the log does not
+    nEpoch = std::max(nEpoch, nTime / (KEEP_MESSAGE_LOG_ALIVE_SECONDS / BUCKETS));
+    for (CBucket& bucket : buckets)
     {
-        int64_t nTimeStamp = (*itr).second;
-        if (nCurrentTimeStamp > nTimeStamp + KEEP_MESSAGE_LOG_ALIVE_SECONDS)
+        if (bucket.nEpoch < nEpoch - BUCKETS && bucket.setHashes.size() > 0)
         {
-           itr = mapRecentMessageLog.erase(itr);
+            nHashes -= bucket.setHashes.size();
+            bucket.setHashes.clear();
         }
-        else
+    }
+}
+
+bool CVGPMessageLog::Insert(const uint256& hash, int64_t nTime)
+{
+    if (Contains(hash, nTime))
+        return false;
+
+    if (nMaxHashes == 0)
+        return true;
+
+    // Over the limit, forget the oldest messages first
+    while (nHashes >= nMaxHashes)
+    {
+        CBucket* pOldest = nullptr;
+        for (CBucket& bucket : buckets)
         {
-           ++itr;
+            if (bucket.setHashes.size() > 0 && (!pOldest || bucket.nEpoch < pOldest->nEpoch))
+                pOldest = &bucket;
         }
+        nHashes -= pOldest->setHashes.size();
+        pOldest->setHashes.clear();
+    }
+
+    CBucket& bucket = buckets[nEpoch % buckets.size()];
+    if (bucket.nEpoch != nEpoch)
+    {
+        nHashes -= bucket.setHashes.size();
+        bucket.setHashes.clear();
+        bucket.nEpoch = nEpoch;
     }
+    bucket.setHashes.insert(GetKey(hash));
+    nHashes++;
+    return true;
 }
 
-bool ReceivedMessage(const uint256& messageHash)
+bool CVGPMessageLog::Contains(const uint256& hash, int64_t nTime)
 {
-    LOCK(cs_mapRecentMessageLog);
-    std::map<uint256, int64_t>::iterator iMessage = mapRecentMessageLog.find(messageHash);
-    if (iMessage != mapRecentMessageLog.end()) 
+    Expire(nTime);
+    uint64_t nKey = GetKey(hash);
+    for (const CBucket& bucket : buckets)
     {
-        return true;
+        if (bucket.setHashes.count(nKey) > 0)
+            return true;
     }
-    else
+    return false;
+}
+
+static CVGPMessageLog& RecentMessageLog()
+{
+    static CVGPMessageLog log;
+    return log;
+}
+
+bool ReceivedMessage(const uint256& messageHash)
+{
+    LOCK(cs_recentMessageLog);
+    return !RecentMessageLog().Insert(messageHash, GetAdjustedTime());
+}
+
+bool HaveReceivedMessage(const uint256& messageHash)
+{
+    LOCK(cs_recentMessageLog);
+    return RecentMessageLog().Contains(messageHash, GetAdjustedTime());
+}
+
+void SetVGPMessageLogSize(size_t nMaxHashes)
+{
+    LOCK(cs_recentMessageLog);
+    RecentMessageLog().SetMaxSize(nMaxHashes);
+}
+
+// cs_mapPeerRateBudgets must be held
+static CVGPRateBudget& RefillRateBudget(NodeId nodeid)
+{
+    int64_t nNow = GetTimeMicros();
+    std::map<NodeId, CVGPRateBudget>::iterator it = mapPeerRateBudgets.find(nodeid);
+    if (it == mapPeerRateBudgets.end()) {
+        CVGPRateBudget budget;
+        budget.dMessages = nVGPMessagePeerBurst;
+        budget.nLastRefill = nNow;
+        it = mapPeerRateBudgets.insert(std::make_pair(nodeid, budget)).first;
+    }
+    CVGPRateBudget& budget = it->second;
+    budget.dMessages = std::min((double)nVGPMessagePeerBurst, budget.dMessages + (nNow - budget.nLastRefill) * nVGPMessagePeerRate / 1000000.0);
+    budget.nLastRefill = nNow;
+    return budget;
+}
+
+static bool HasRateBudget(NodeId nodeid)
+{
+    LOCK(cs_mapPeerRateBudgets);
+    return RefillRateBudget(nodeid).dMessages >= 1;
+}
+
+// Only messages that fail a check use up the budget of a peer
+static void ChargeRateBudget(NodeId nodeid)
+{
+    LOCK(cs_mapPeerRateBudgets);
+    CVGPRateBudget& budget = RefillRateBudget(nodeid);
+    budget.dMessages = std::max(0.0, budget.dMessages - 1);
+}
+
+void FinalizeVGPPeer(NodeId nodeid)
+{
+    LOCK(cs_mapPeerRateBudgets);
+    mapPeerRateBudgets.erase(nodeid);
+}
+
+// Last stage of AdmitVGPMessage: Argon2d proof of work, then relay to every peer but the sender
+static void CheckAdmittedMessage(const CVGPMessage& message, NodeId nodeFrom)
+{
+    std::string strErrorMessage = "";
+    int statusBan = message.ProcessMessage(strErrorMessage);
+    if (statusBan > 0)
     {
-        int64_t nTimeStamp =  GetAdjustedTime();
-        mapRecentMessageLog[messageHash] = nTimeStamp;
-        nMessageCounter++;
-        if ((nMessageCounter % 10) == 0)
-            CleanupRecentMessageLog();
+        LogPrint("bdap", "%s -- Error processing message. Hash %s, MessageID %s, SubjectID %s, Error %s\n", __func__,
+                            message.GetHash().ToString(), message.UnsignedMessage().MessageID.ToString(), message.UnsignedMessage().SubjectID.ToString(), strErrorMessage);
+        ChargeRateBudget(nodeFrom);
+        LOCK(cs_main);
+        Misbehaving(nodeFrom, statusBan);
+        return;
     }
-    return false;
+    if (statusBan < 0 || !g_connman)
+        return;
+
+    LOCK(cs_vgpRelay);
+    g_connman->ForEachNode([&message, nodeFrom](CNode* pnode) {
+        if (pnode->GetId() == nodeFrom)
+            pnode->AddKnown(message.GetHash());
+        else
+            message.RelayTo(pnode, *g_connman);
+    });
 }
 
-void CleanupMyMessageMap()
+/**
+ * Admits a VGP message received from a peer. Structure, sizes and the time
+ * window are checked first, then duplicates by the SHA256 hash of the message,
+ * the rate budget of the peer and the signature. Only messages that pass all
+ * of these are hashed with Argon2d for the proof-of-work check, by one of the
+ * -vgpmessagethreads threads, which also relay it. Messages that fail a check
+ * use up the rate budget of the peer. Returns a ban score, 0 if the message
+ * was admitted or a negative number if it is dropped.
+ */
+int AdmitVGPMessage(const CVGPMessage& message, NodeId nodeFrom, std::string& strErrorMessage)
 {
-    // map with message type, message sender and timestamp.  Used to keep last message from a sender/type pair.
-    std::map<std::pair<std::vector<unsigned char>, std::vector<unsigned char>>, int64_t> mapMessageTypeFromTimestamp;
-    int64_t nCurrentTimeStamp =  GetAdjustedTime();
-    std::map<uint256, CVGPMessage>::iterator itr = mapMyVGPMessages.begin();
-    while (itr != mapMyVGPMessages.end())
+    int statusBan = message.CheckMessage(strErrorMessage);
+    if (statusBan != 0)
+    {
+        ChargeRateBudget(nodeFrom);
+        return statusBan;
+    }
+
+    if (HaveReceivedMessage(message.GetMsgHash()))
+    {
+        strErrorMessage = "Message already received.";
+        return -1; // do not relay message again
+    }
+    if (!HasRateBudget(nodeFrom))
+    {
+        strErrorMessage = "Peer exceeded its failed VGP message rate.";
+        return -5;
+    }
+    if (!message.CheckSignature(message.UnsignedMessage().vchWalletPubKey))
     {
-        CVGPMessage message = (*itr).second;
-        CUnsignedVGPMessage unsignedMessage(message.vchMsg);
-        if (!unsignedMessage.fEncrypted && nCurrentTimeStamp > unsignedMessage.nTimeStamp + KEEP_MY_MESSAGE_ALIVE_SECONDS)
+        ChargeRateBudget(nodeFrom);
+        strErrorMessage = "VGP message has an invalid signature. Adding 100 to ban score.";
+        return 100; // this will add 100 to the peer's ban score
+    }
+
+    if (!nVGPMessageCheckThreads)
+    {
+        ReceivedMessage(message.GetMsgHash());
+        CheckAdmittedMessage(message, nodeFrom);
+        return 0;
+    }
+
+    {
+        boost::unique_lock<boost::mutex> lock(mutexVGPMessageCheck);
+        if (queueVGPMessageCheck.size() >= MAX_VGP_MESSAGE_CHECK_QUEUE)
         {
-            CMessage message(unsignedMessage.vchMessageData);
-            std::pair<std::vector<unsigned char>, std::vector<unsigned char>> pairTypeFrom = std::make_pair(message.vchMessageType, message.vchSenderFQDN);
-            if (!message.fKeepLast) {
-                itr = mapMyVGPMessages.erase(itr);
-            }
-            else {
-                std::map<std::pair<std::vector<unsigned char>, std::vector<unsigned char>>, int64_t>::iterator itTypeFrom = mapMessageTypeFromTimestamp.find(pairTypeFrom);
-                if (itTypeFrom != mapMessageTypeFromTimestamp.end()) {
-                    if (itTypeFrom->second > unsignedMessage.nTimeStamp) {
-                        itr = mapMyVGPMessages.erase(itr);
-                    }
-                    else {
-                        mapMessageTypeFromTimestamp[pairTypeFrom] = unsignedMessage.nTimeStamp;
-                        ++itr;
-                    }
-                }
-                else {
-                    mapMessageTypeFromTimestamp[pairTypeFrom] = unsignedMessage.nTimeStamp;
-                    ++itr;
-                }
-            }
+            strErrorMessage = "VGP message check queue is full.";
+            return -6;
         }
-        else
+        ReceivedMessage(message.GetMsgHash());
+        queueVGPMessageCheck.push_back(std::make_pair(message, nodeFrom));
+    }
+    condVGPMessageCheck.notify_one();
+    return 0;
+}
+
+void ThreadVGPMessageCheck()
+{
+    RenameThread("cash-vgpcheck");
+    while (true)
+    {
+        std::pair<CVGPMessage, NodeId> item;
         {
-           ++itr;
+            boost::unique_lock<boost::mutex> lock(mutexVGPMessageCheck);
+            while (queueVGPMessageCheck.empty())
+                condVGPMessageCheck.wait(lock);
+            item = queueVGPMessageCheck.front();
+            queueVGPMessageCheck.pop_front();
         }
+        CheckAdmittedMessage(item.first, item.second);
     }
-    LogPrintf("%s -- Size %d\n", __func__, mapMyVGPMessages.size());
+}
+
+void CleanupMyMessageMap()
+{
+    LOCK(cs_myVGPMessages);
+    myVGPMessages.Expire(GetAdjustedTime());
+    LogPrintf("%s -- Size %d\n", __func__, myVGPMessages.Size());
+}
+
+bool StartVGPMessageSpill(const boost::filesystem::path& path)
+{
+    LOCK(cs_myVGPMessages);
+    return myVGPMessages.StartSpill(path);
+}
+
+void StopVGPMessageSpill()
+{
+    LOCK(cs_myVGPMessages);
+    myVGPMessages.StopSpill();
 }
 
 #ifdef ENABLE_WALLET
@@ -638,7 +846,7 @@ bool DecryptMessage(CUnsignedVGPMessage& unsignedMessage)
 void AddMyMessage(const CVGPMessage& message)
 {
     bool fFound = false;
-    CUnsignedVGPMessage unsignedMessage(message.vchMsg);
+    CUnsignedVGPMessage unsignedMessage = message.UnsignedMessage();
     LogPrint("bdap", "%s -- Message hash = %s, Link MessageID = %s\n", __func__, message.GetHash().ToString(), unsignedMessage.MessageID.ToString());
     CVGPMessage storeMessage;
     if (pwalletMain && pLinkManager && !pwalletMain->IsLocked() && unsignedMessage.fEncrypted)
@@ -655,79 +863,96 @@ void AddMyMessage(const CVGPMessage& message)
     {
         storeMessage = message;
     }
-    LOCK(cs_mapMyVGPMessages);
-    mapMyVGPMessages[storeMessage.GetHash()] = storeMessage;
-    nMyMessageCounter++;
-    if ((nMyMessageCounter % 10) == 0)
+    bool fCleanup = false;
+    {
+        LOCK(cs_myVGPMessages);
+        myVGPMessages.Add(storeMessage);
+        fCleanup = (++nMyMessageCounter % 10) == 0;
+    }
+    if (fCleanup)
         CleanupMyMessageMap();
 }
 
+// Stores the messages decrypted while reading myVGPMessages in place of the
+// encrypted ones, like AddMyMessage does, so each is only decrypted once
+static void StoreDecryptedMessages(const std::vector<std::pair<uint256, CVGPMessage> >& vDecrypted)
+{
+    AssertLockHeld(cs_myVGPMessages);
+    for (const std::pair<uint256, CVGPMessage>& decrypted : vDecrypted)
+    {
+        myVGPMessages.Remove(decrypted.first);
+        myVGPMessages.Add(decrypted.second);
+    }
+}
+
 void GetMyLinkMessages(const uint256& subjectID, std::vector<CUnsignedVGPMessage>& vMessages)
 {
-    LOCK(cs_mapMyVGPMessages);
-    std::map<uint256, CVGPMessage>::iterator itr = mapMyVGPMessages.begin();
-    while (itr != mapMyVGPMessages.end())
+    LOCK(cs_myVGPMessages);
+    std::vector<CVGPMessage> vLinkMessages;
+    myVGPMessages.GetBySubject(subjectID, vLinkMessages);
+    std::vector<std::pair<uint256, CVGPMessage> > vDecrypted;
+    for (const CVGPMessage& linkMessage : vLinkMessages)
     {
-        CVGPMessage message = (*itr).second;
-        CUnsignedVGPMessage unsignedMessage(message.vchMsg);
-        if (unsignedMessage.SubjectID == subjectID)
+        const CUnsignedVGPMessage& unsignedMessage = linkMessage.UnsignedMessage();
+        if (unsignedMessage.fEncrypted)
         {
-            if (unsignedMessage.fEncrypted)
-            {
-                if (pwalletMain && !pwalletMain->IsLocked() && DecryptMessage(unsignedMessage))
-                {
-                    vMessages.push_back(unsignedMessage);
-                }
-            }
-            else
+            CUnsignedVGPMessage decryptedMessage = unsignedMessage;
+            if (pwalletMain && !pwalletMain->IsLocked() && DecryptMessage(decryptedMessage))
             {
-                vMessages.push_back(unsignedMessage);
+                vMessages.push_back(decryptedMessage);
+                vDecrypted.push_back(std::make_pair(linkMessage.GetMsgHash(), CVGPMessage(decryptedMessage)));
             }
         }
-        itr++;
+        else
+        {
+            vMessages.push_back(unsignedMessage);
+        }
     }
+    StoreDecryptedMessages(vDecrypted);
 }
 
 void GetMyLinkMessagesByType(const std::vector<unsigned char>& vchType, const std::vector<unsigned char>& vchRecipientFQDN, std::vector<CVGPMessage>& vMessages, bool& fKeepLast)
 {
-    LOCK(cs_mapMyVGPMessages);
-    std::map<uint256, CVGPMessage>::iterator itr = mapMyVGPMessages.begin();
-    while (itr != mapMyVGPMessages.end())
+    LOCK(cs_myVGPMessages);
+    if (pwalletMain && !pwalletMain->IsLocked())
     {
-        CVGPMessage messageWrapper = (*itr).second;
-        CUnsignedVGPMessage unsignedMessage(messageWrapper.vchMsg);
-        if (unsignedMessage.fEncrypted && pwalletMain && !pwalletMain->IsLocked())
+        std::vector<CVGPMessage> vEncrypted;
+        myVGPMessages.GetEncrypted(vEncrypted);
+        std::vector<std::pair<uint256, CVGPMessage> > vDecrypted;
+        for (const CVGPMessage& encryptedMessage : vEncrypted)
         {
-            DecryptMessage(unsignedMessage);
+            CUnsignedVGPMessage decryptedMessage = encryptedMessage.UnsignedMessage();
+            if (DecryptMessage(decryptedMessage))
+                vDecrypted.push_back(std::make_pair(encryptedMessage.GetMsgHash(), CVGPMessage(decryptedMessage)));
         }
-        if (!unsignedMessage.fEncrypted && (vchType.size() == 0 || vchType == unsignedMessage.Type()) && unsignedMessage.SenderFQDN() != vchRecipientFQDN)
+        StoreDecryptedMessages(vDecrypted);
+    }
+
+    std::vector<CVGPMessage> vTypeMessages;
+    myVGPMessages.GetByType(vchType, vTypeMessages);
+    for (const CVGPMessage& typeMessage : vTypeMessages)
+    {
+        const CUnsignedVGPMessage& unsignedMessage = typeMessage.UnsignedMessage();
+        if (unsignedMessage.SenderFQDN() != vchRecipientFQDN)
         {
             if (unsignedMessage.KeepLast())
                 fKeepLast = true;
 
-            vMessages.push_back(unsignedMessage);
+            vMessages.push_back(typeMessage);
         }
-        itr++;
     }
 }
 
 void GetMyLinkMessagesBySubjectAndSender(const uint256& subjectID, const std::vector<unsigned char>& vchSenderFQDN, 
                                             const std::vector<unsigned char>& vchType, std::vector<CVGPMessage>& vchMessages, bool& fKeepLast)
 {
-    LOCK(cs_mapMyVGPMessages);
-    std::map<uint256, CVGPMessage>::iterator itr = mapMyVGPMessages.begin();
-    while (itr != mapMyVGPMessages.end())
+    LOCK(cs_myVGPMessages);
+    size_t nFirst = vchMessages.size();
+    myVGPMessages.GetBySubjectAndSender(subjectID, vchSenderFQDN, vchType, vchMessages);
+    for (size_t i = nFirst; i < vchMessages.size(); i++)
     {
-        CVGPMessage messageWrapper = (*itr).second;
-        CUnsignedVGPMessage unsignedMessage(messageWrapper.vchMsg);
-        if (unsignedMessage.SubjectID == subjectID && unsignedMessage.SenderFQDN() == vchSenderFQDN && (vchType.size() == 0 || vchType == unsignedMessage.Type()))
-        {
-            if (unsignedMessage.KeepLast())
-                fKeepLast = true;
-
-            vchMessages.push_back(messageWrapper);
-        }
-        itr++;
+        if (vchMessages[i].UnsignedMessage().KeepLast())
+            fKeepLast = true;
     }
 }
 #endif // ENABLE_WALLET
@@ -737,7 +962,7 @@ void KeepLastTypeBySender(std::vector<CVGPMessage>& vMessages)
     std::map<std::pair<std::vector<unsigned char>, std::vector<unsigned char>>, std::pair<CVGPMessage, int64_t> > mapFromMessageTime;
     for (const CVGPMessage& messageWrapper : vMessages)
     {
-        CUnsignedVGPMessage unsignedMessage(messageWrapper.vchMsg);
+        const CUnsignedVGPMessage& unsignedMessage = messageWrapper.UnsignedMessage();
         if (!unsignedMessage.fEncrypted)
         {
             CMessage message(unsignedMessage.vchMessageData);
@@ -11,18 +11,28 @@
 #include "sync.h"
 #include "uint256.h"
 
+#include <array>
 #include <map>
 #include <set>
 #include <stdint.h>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
+#include <boost/filesystem/path.hpp>
+
 class CConnman;
 class CKey;
 class CKeyEd25519;
 class CNode;
 class CVGPMessage;
 
+typedef int NodeId;
+
+extern int nVGPMessageCheckThreads;
+extern int nVGPMessagePeerRate;
+extern int nVGPMessagePeerBurst;
+
 static constexpr size_t MAX_MESSAGE_SIZE = 8192;
 static constexpr int MIN_VGP_MESSAGE_PEER_PROTO_VERSION = 71000;
 static constexpr size_t MAX_MESSAGE_DATA_LENGTH = 8192;
@@ -33,6 +43,18 @@ static constexpr int KEEP_MESSAGE_LOG_ALIVE_SECONDS = 300; // 5 minutes.
 static constexpr int KEEP_MY_MESSAGE_ALIVE_SECONDS = 240; // 4 minutes.
 static constexpr int MAX_MESAGGE_DRIFT_SECONDS = 90; // 1.5 minutes.
 static constexpr int MAX_MESAGGE_RELAY_SECONDS = 120; // 2 minutes.
+static constexpr int VGP_MESSAGE_IN_EFFECT_SECONDS = 60; // 1 minute.
+/** -vgpmessagelogsize default (received VGP message hashes remembered for duplicate detection) */
+static constexpr size_t DEFAULT_VGP_MESSAGE_LOG_SIZE = 600000;
+/** -vgpmessagepeerrate default (failed VGP messages per second a peer may send on average, 100k messages per minute) */
+static constexpr int DEFAULT_VGP_MESSAGE_PEER_RATE = 1700;
+/** -vgpmessagepeerburst default (failed VGP messages a peer may send at once) */
+static constexpr int DEFAULT_VGP_MESSAGE_PEER_BURST = 17000;
+static constexpr size_t MAX_VGP_MESSAGE_CHECK_QUEUE = 256; // messages waiting for proof-of-work verification
+/** Maximum number of VGP message proof-of-work verification threads allowed */
+static const int MAX_VGP_MESSAGE_CHECK_THREADS = 16;
+/** -vgpmessagethreads default (number of VGP message proof-of-work verification threads) */
+static const int DEFAULT_VGP_MESSAGE_CHECK_THREADS = 2;
 static const uint256 VGP_MESSAGE_MIN_HASH_TARGET = uint256S("00ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
 
 class CUnsignedVGPMessage
@@ -117,22 +139,38 @@ public:
     bool DecryptMessage(const std::array<char, 32>& arrPrivateSeed, std::vector<unsigned char>& vchType,
                         std::vector<unsigned char>& vchMessage, std::vector<unsigned char>& vchSenderFQDN, bool& fKeepLast, std::string& strErrorMessage);
 
-    std::vector<unsigned char> Type();
-    std::vector<unsigned char> Value();
-    std::vector<unsigned char> SenderFQDN();
-    bool KeepLast();
+    std::vector<unsigned char> Type() const;
+    std::vector<unsigned char> Value() const;
+    std::vector<unsigned char> SenderFQDN() const;
+    bool KeepLast() const;
     std::string ToString() const;
     uint256 GetHash() const;
 
 };
 
-/** A VGP message is a combination of a serialized CUnsignedVGPMessage and a signature. */
+/**
+ * A VGP message is a combination of a serialized CUnsignedVGPMessage and a signature.
+ * The serialized message is decoded once, along with its SHA256 hash, whenever
+ * vchMsg is set by the constructor, deserialization or MineMessage. Its Argon2d
+ * hash is computed the first time it is needed. Do not change vchMsg directly.
+ */
 class CVGPMessage
 {
 public:
     std::vector<unsigned char> vchMsg;
     std::vector<unsigned char> vchSig;
 
+private:
+    // vchMsg decoded, its double SHA256 hash and its Argon2d hash once known
+    CUnsignedVGPMessage unsignedMessage;
+    bool fDecoded;
+    uint256 hashMsg;
+    mutable uint256 hash;
+    mutable bool fHashed;
+
+    void Decode();
+
+public:
     CVGPMessage()
     {
         SetNull();
@@ -147,22 +185,24 @@ public:
     {
         READWRITE(vchMsg);
         READWRITE(vchSig);
+        if (ser_action.ForRead())
+            Decode();
     }
 
     friend bool operator<(const CVGPMessage& a, const CVGPMessage& b)
     {
-        CUnsignedVGPMessage ua(a.vchMsg);
-        CUnsignedVGPMessage ub(b.vchMsg);
-        return (ua.nTimeStamp < ub.nTimeStamp);
+        return (a.unsignedMessage.nTimeStamp < b.unsignedMessage.nTimeStamp);
     }
 
     friend bool operator>(const CVGPMessage& a, const CVGPMessage& b)
     {
-        CUnsignedVGPMessage ua(a.vchMsg);
-        CUnsignedVGPMessage ub(b.vchMsg);
-        return (ua.nTimeStamp > ub.nTimeStamp);
+        return (a.unsignedMessage.nTimeStamp > b.unsignedMessage.nTimeStamp);
     }
 
+    const CUnsignedVGPMessage& UnsignedMessage() const { return unsignedMessage; }
+    //! Double SHA256 of vchMsg, what the signature signs and what duplicates are found by
+    const uint256& GetMsgHash() const { return hashMsg; }
+
     void SetNull();
     bool IsNull() const;
     uint256 GetHash() const;
@@ -170,6 +210,7 @@ public:
     bool RelayMessage(CConnman& connman) const;
     bool Sign(const CKey& key);
     bool CheckSignature(const std::vector<unsigned char>& vchPubKey) const;
+    int CheckMessage(std::string& strErrorMessage) const;
     int ProcessMessage(std::string& strErrorMessage) const;
     bool RelayTo(CNode* pnode, CConnman& connman) const;
     int Version() const;
@@ -177,12 +218,56 @@ public:
 
 };
 
+/**
+ * Hashes of the messages received in the last KEEP_MESSAGE_LOG_ALIVE_SECONDS,
+ * in a ring of buckets by the time they were received. Expiry drops a whole
+ * bucket at a time. Hashes are kept as salted 64 bit SipHashes, and once more
+ * than nMaxHashes are kept the oldest buckets are dropped early.
+ */
+class CVGPMessageLog
+{
+private:
+    static const int BUCKETS = 10;
+
+    struct CBucket
+    {
+        int64_t nEpoch;
+        std::unordered_set<uint64_t> setHashes;
+    };
+
+    // One more bucket than needed to cover KEEP_MESSAGE_LOG_ALIVE_SECONDS for the one being filled
+    std::array<CBucket, BUCKETS + 1> buckets;
+    int64_t nEpoch;
+    size_t nHashes;
+    size_t nMaxHashes;
+    const uint64_t k0, k1;
+
+    uint64_t GetKey(const uint256& hash) const;
+    void Expire(int64_t nTime);
+
+public:
+    explicit CVGPMessageLog(size_t nMaxHashesIn = DEFAULT_VGP_MESSAGE_LOG_SIZE);
+
+    /** Add the hash of a message received at nTime. Returns false if it was already there. */
+    bool Insert(const uint256& hash, int64_t nTime);
+    bool Contains(const uint256& hash, int64_t nTime);
+    size_t Size() const { return nHashes; }
+    void SetMaxSize(size_t nMaxHashesIn) { nMaxHashes = nMaxHashesIn; }
+};
+
 bool GetSecretSharedKey(const std::string& strSenderFQDN, const std::string& strRecipientFQDN, CKeyEd25519& key, std::string& strErrorMessage);
 uint256 GetSubjectIDFromKey(const CKeyEd25519& key);
 
 bool ReceivedMessage(const uint256& messageHash);
-void CleanupRecentMessageLog();
+bool HaveReceivedMessage(const uint256& messageHash);
+int AdmitVGPMessage(const CVGPMessage& message, NodeId nodeFrom, std::string& strErrorMessage);
+void FinalizeVGPPeer(NodeId nodeid);
+void ThreadVGPMessageCheck();
+void SetVGPMessageLogSize(size_t nMaxHashes);
 void CleanupMyMessageMap();
+/** Spill the old kept last messages of mine to a database at path, see CVGPMessageStore */
+bool StartVGPMessageSpill(const boost::filesystem::path& path);
+void StopVGPMessageSpill();
 
 #ifdef ENABLE_WALLET
 bool DecryptMessage(CUnsignedVGPMessage& unsignedMessage);
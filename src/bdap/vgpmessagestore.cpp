@@ -0,0 +1,198 @@
+// Copyright (c) 2019-2021 Duality Blockchain Solutions Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bdap/vgpmessagestore.h"
+
+#include "dbwrapper.h"
+#include "util.h"
+
+#include <iterator>
+
+// Spilled messages are written once and read by RPC calls, so a small cache will do
+static const size_t VGP_MESSAGE_SPILL_CACHE = 1 << 20;
+
+CVGPMessageStore::CVGPMessageStore()
+{
+}
+
+CVGPMessageStore::~CVGPMessageStore()
+{
+}
+
+bool CVGPMessageStore::GetMessage(const uint256& hash, const CEntry& entry, CVGPMessage& message) const
+{
+    if (!entry.fSpilled) {
+        message = entry.message;
+        return true;
+    }
+    return pspill && pspill->Read(hash, message);
+}
+
+bool CVGPMessageStore::Add(const CVGPMessage& message)
+{
+    const uint256 hash = message.GetMsgHash();
+    if (mapMessages.count(hash) > 0)
+        return true;
+
+    const CUnsignedVGPMessage& unsignedMessage = message.UnsignedMessage();
+    CEntry entry;
+    entry.subjectID = unsignedMessage.SubjectID;
+    entry.nTimeStamp = unsignedMessage.nTimeStamp;
+    entry.fEncrypted = unsignedMessage.fEncrypted;
+    entry.fKeepLast = false;
+    entry.fSpilled = false;
+    if (!entry.fEncrypted) {
+        entry.typeSender = std::make_pair(unsignedMessage.Type(), unsignedMessage.SenderFQDN());
+        entry.fKeepLast = unsignedMessage.KeepLast();
+    }
+
+    if (entry.fKeepLast) {
+        std::map<TypeSender, uint256>::iterator itLast = mapKeepLast.find(entry.typeSender);
+        if (itLast != mapKeepLast.end()) {
+            const uint256 hashLast = itLast->second;
+            if (mapMessages[hashLast].nTimeStamp > entry.nTimeStamp)
+                return false;
+            Remove(hashLast);
+        }
+        mapKeepLast[entry.typeSender] = hash;
+    }
+
+    mapBySubject[entry.subjectID].insert(hash);
+    if (entry.fEncrypted) {
+        setEncrypted.insert(hash);
+    } else {
+        mapByTypeSender[entry.typeSender].insert(hash);
+        setByTime.insert(std::make_pair(entry.nTimeStamp, hash));
+    }
+    entry.message = message;
+    mapMessages[hash] = entry;
+    return true;
+}
+
+void CVGPMessageStore::Remove(const uint256& hash)
+{
+    std::map<uint256, CEntry>::iterator it = mapMessages.find(hash);
+    if (it == mapMessages.end())
+        return;
+
+    const CEntry& entry = it->second;
+    std::map<uint256, std::set<uint256> >::iterator itSubject = mapBySubject.find(entry.subjectID);
+    if (itSubject != mapBySubject.end()) {
+        itSubject->second.erase(hash);
+        if (itSubject->second.empty())
+            mapBySubject.erase(itSubject);
+    }
+    if (entry.fEncrypted) {
+        setEncrypted.erase(hash);
+    } else {
+        std::map<TypeSender, std::set<uint256> >::iterator itTypeSender = mapByTypeSender.find(entry.typeSender);
+        if (itTypeSender != mapByTypeSender.end()) {
+            itTypeSender->second.erase(hash);
+            if (itTypeSender->second.empty())
+                mapByTypeSender.erase(itTypeSender);
+        }
+        setByTime.erase(std::make_pair(entry.nTimeStamp, hash));
+        std::map<TypeSender, uint256>::iterator itLast = mapKeepLast.find(entry.typeSender);
+        if (itLast != mapKeepLast.end() && itLast->second == hash)
+            mapKeepLast.erase(itLast);
+    }
+    if (entry.fSpilled && pspill)
+        pspill->Erase(hash);
+    mapMessages.erase(it);
+}
+
+void CVGPMessageStore::Expire(int64_t nNow)
+{
+    std::set<std::pair<int64_t, uint256> >::iterator it = setByTime.begin();
+    while (it != setByTime.end() && nNow > it->first + KEEP_MY_MESSAGE_ALIVE_SECONDS) {
+        const uint256 hash = it->second;
+        CEntry& entry = mapMessages[hash];
+        if (!entry.fKeepLast) {
+            ++it;
+            Remove(hash);
+        } else if (pspill && pspill->Write(hash, entry.message)) {
+            entry.message.SetNull();
+            entry.fSpilled = true;
+            it = setByTime.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void CVGPMessageStore::GetBySubject(const uint256& subjectID, std::vector<CVGPMessage>& vMessages) const
+{
+    std::map<uint256, std::set<uint256> >::const_iterator itSubject = mapBySubject.find(subjectID);
+    if (itSubject == mapBySubject.end())
+        return;
+
+    for (const uint256& hash : itSubject->second) {
+        CVGPMessage message;
+        if (GetMessage(hash, mapMessages.at(hash), message))
+            vMessages.push_back(message);
+    }
+}
+
+void CVGPMessageStore::GetByType(const std::vector<unsigned char>& vchType, std::vector<CVGPMessage>& vMessages) const
+{
+    std::map<TypeSender, std::set<uint256> >::const_iterator it = mapByTypeSender.begin();
+    if (vchType.size() > 0)
+        it = mapByTypeSender.lower_bound(std::make_pair(vchType, std::vector<unsigned char>()));
+    for (; it != mapByTypeSender.end() && (vchType.size() == 0 || it->first.first == vchType); ++it) {
+        for (const uint256& hash : it->second) {
+            CVGPMessage message;
+            if (GetMessage(hash, mapMessages.at(hash), message))
+                vMessages.push_back(message);
+        }
+    }
+}
+
+void CVGPMessageStore::GetBySubjectAndSender(const uint256& subjectID, const std::vector<unsigned char>& vchSenderFQDN, const std::vector<unsigned char>& vchType,
+                                                std::vector<CVGPMessage>& vMessages) const
+{
+    const std::set<uint256>* psetHashes = nullptr;
+    if (vchType.size() > 0) {
+        std::map<TypeSender, std::set<uint256> >::const_iterator it = mapByTypeSender.find(std::make_pair(vchType, vchSenderFQDN));
+        if (it != mapByTypeSender.end())
+            psetHashes = &it->second;
+    } else {
+        std::map<uint256, std::set<uint256> >::const_iterator it = mapBySubject.find(subjectID);
+        if (it != mapBySubject.end())
+            psetHashes = &it->second;
+    }
+    if (!psetHashes)
+        return;
+
+    for (const uint256& hash : *psetHashes) {
+        const CEntry& entry = mapMessages.at(hash);
+        if (entry.fEncrypted || entry.subjectID != subjectID || entry.typeSender.second != vchSenderFQDN)
+            continue;
+
+        CVGPMessage message;
+        if (GetMessage(hash, entry, message))
+            vMessages.push_back(message);
+    }
+}
+
+void CVGPMessageStore::GetEncrypted(std::vector<CVGPMessage>& vMessages) const
+{
+    for (const uint256& hash : setEncrypted)
+        vMessages.push_back(mapMessages.at(hash).message);
+}
+
+bool CVGPMessageStore::StartSpill(const boost::filesystem::path& path)
+{
+    try {
+        pspill.reset(new CDBWrapper(path, VGP_MESSAGE_SPILL_CACHE, false, true));
+    } catch (const std::exception& e) {
+        LogPrintf("%s -- Failed to open VGP message spill database %s: %s\n", __func__, path.string(), e.what());
+        return false;
+    }
+    return true;
+}
+
+void CVGPMessageStore::StopSpill()
+{
+    pspill.reset();
+}
@@ -0,0 +1,92 @@
+// Copyright (c) 2019-2021 Duality Blockchain Solutions Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef CASH_BDAP_VGPMESSAGESTORE_H
+#define CASH_BDAP_VGPMESSAGESTORE_H
+
+#include "bdap/vgpmessage.h"
+#include "uint256.h"
+
+#include <map>
+#include <memory>
+#include <set>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+class CDBWrapper;
+
+/** -vgpmessagespill default */
+static const bool DEFAULT_VGP_MESSAGE_SPILL = false;
+
+/**
+ * My VGP messages, indexed by link subject, by type and sender and by time.
+ * Of the messages that ask to keep only the last one of their type from a
+ * sender, only the newest is kept. Other decrypted messages expire after
+ * KEEP_MY_MESSAGE_ALIVE_SECONDS. Messages are only decrypted later if the
+ * wallet was locked when they arrived, and are kept encrypted until then.
+ *
+ * With a spill database, the kept last messages are moved from memory to it
+ * once they are older than KEEP_MY_MESSAGE_ALIVE_SECONDS. Their indexes stay
+ * in memory. Messages are keyed by their GetMsgHash().
+ *
+ * Not thread safe.
+ */
+class CVGPMessageStore
+{
+private:
+    typedef std::pair<std::vector<unsigned char>, std::vector<unsigned char> > TypeSender;
+
+    struct CEntry
+    {
+        uint256 subjectID;
+        int64_t nTimeStamp;
+        bool fEncrypted;
+        bool fKeepLast;
+        bool fSpilled;
+        TypeSender typeSender;
+        // Null once spilled
+        CVGPMessage message;
+    };
+
+    std::map<uint256, CEntry> mapMessages;
+    std::map<uint256, std::set<uint256> > mapBySubject;
+    // Decrypted messages only
+    std::map<TypeSender, std::set<uint256> > mapByTypeSender;
+    std::map<TypeSender, uint256> mapKeepLast;
+    // Decrypted messages in memory, oldest first
+    std::set<std::pair<int64_t, uint256> > setByTime;
+    std::set<uint256> setEncrypted;
+    std::unique_ptr<CDBWrapper> pspill;
+
+    bool GetMessage(const uint256& hash, const CEntry& entry, CVGPMessage& message) const;
+
+public:
+    CVGPMessageStore();
+    ~CVGPMessageStore();
+
+    /** Store a message. Returns false if it is replaced by a newer message it should only be kept last to. */
+    bool Add(const CVGPMessage& message);
+    void Remove(const uint256& hash);
+    /** Drop the messages expired by nNow, and spill the old kept last messages */
+    void Expire(int64_t nNow);
+
+    void GetBySubject(const uint256& subjectID, std::vector<CVGPMessage>& vMessages) const;
+    /** Decrypted messages of a type, or of every type if vchType is empty */
+    void GetByType(const std::vector<unsigned char>& vchType, std::vector<CVGPMessage>& vMessages) const;
+    /** Decrypted messages of a link from a sender, of a type or of every type if vchType is empty */
+    void GetBySubjectAndSender(const uint256& subjectID, const std::vector<unsigned char>& vchSenderFQDN, const std::vector<unsigned char>& vchType,
+                                std::vector<CVGPMessage>& vMessages) const;
+    void GetEncrypted(std::vector<CVGPMessage>& vMessages) const;
+    size_t Size() const { return mapMessages.size(); }
+
+    /** Spill to a new database at path */
+    bool StartSpill(const boost::filesystem::path& path);
+    /** Close the spill database at shutdown. The spilled messages can no longer be read */
+    void StopSpill();
+};
+
+#endif // CASH_BDAP_VGPMESSAGESTORE_H
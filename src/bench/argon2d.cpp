@@ -0,0 +1,249 @@
+// Copyright (c) 2016-2021 Duality Blockchain Solutions Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "crypto/argon2d/argon2.h"
+#include "crypto/argon2d_arena.h"
+#include "crypto/common.h"
+#include "hash.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Phase 1 parameters (see Argon2d_Phase1_Hash) with a selectable allocator,
+// so the malloc'ed matrix can be compared against the reusable arena.
+static void Argon2dPhase1(benchmark::State& state, bool fArena)
+{
+    std::vector<unsigned char> header(INPUT_BYTES, 0);
+    uint256 hash;
+    uint32_t nNonce = 0;
+    while (state.KeepRunning()) {
+        WriteLE32(&header[INPUT_BYTES - 4], nNonce++);
+        argon2_context context;
+        context.out = (uint8_t*)hash.begin();
+        context.outlen = (uint32_t)OUTPUT_BYTES;
+        context.pwd = header.data();
+        context.pwdlen = (uint32_t)header.size();
+        context.salt = header.data();
+        context.saltlen = (uint32_t)header.size();
+        context.secret = NULL;
+        context.secretlen = 0;
+        context.ad = NULL;
+        context.adlen = 0;
+        context.allocate_cbk = fArena ? Argon2dArenaAllocate : NULL;
+        context.free_cbk = fArena ? Argon2dArenaFree : NULL;
+        context.flags = DEFAULT_ARGON2_FLAG;
+        context.m_cost = 1000;
+        context.lanes = 8;
+        context.threads = 1;
+        context.t_cost = 2;
+        argon2_ctx(&context, Argon2_d);
+    }
+    Argon2dArenaRelease();
+}
+
+static void Argon2dPhase1Malloc(benchmark::State& state)
+{
+    Argon2dPhase1(state, false);
+}
+
+static void Argon2dPhase1Arena(benchmark::State& state)
+{
+    Argon2dPhase1(state, true);
+}
+
+static void Argon2dPhase1ArenaHugePages(benchmark::State& state)
+{
+    bool fHugePages = Argon2dArenaGetHugePages();
+    Argon2dArenaSetHugePages(true);
+    Argon2dPhase1(state, true);
+    Argon2dArenaSetHugePages(fHugePages);
+}
+
+// Phase 1 hashes of consecutive nonces with interleaved memory fills
+static void Argon2dPhase1Interleaved(benchmark::State& state, uint32_t nCount)
+{
+    std::vector<std::vector<unsigned char> > headers(nCount, std::vector<unsigned char>(INPUT_BYTES, 0));
+    std::vector<uint256> hashes(nCount);
+    const void* in[ARGON2_MAX_INTERLEAVE];
+    void* out[ARGON2_MAX_INTERLEAVE];
+    for (uint32_t i = 0; i < nCount; i++) {
+        in[i] = headers[i].data();
+        out[i] = hashes[i].begin();
+    }
+    uint32_t nNonce = 0;
+    while (state.KeepRunning()) {
+        for (uint32_t i = 0; i < nCount; i++)
+            WriteLE32(&headers[i][INPUT_BYTES - 4], nNonce++);
+        Argon2d_Phase_Hash_Multi<1>(in, INPUT_BYTES, out, nCount);
+    }
+    Argon2dArenaRelease();
+}
+
+static void Argon2dPhase1Interleave2(benchmark::State& state)
+{
+    Argon2dPhase1Interleaved(state, 2);
+}
+
+static void Argon2dPhase1Interleave4(benchmark::State& state)
+{
+    Argon2dPhase1Interleaved(state, 4);
+}
+
+// hash_Argon2d for each PoW phase, a different nonce every iteration
+template <unsigned int Phase>
+static void HashArgon2d(benchmark::State& state)
+{
+    std::vector<unsigned char> header(INPUT_BYTES, 0);
+    uint32_t nNonce = 0;
+    while (state.KeepRunning()) {
+        WriteLE32(&header[INPUT_BYTES - 4], nNonce++);
+        hash_Argon2d<Phase>(header.begin(), header.end());
+    }
+    Argon2dArenaRelease();
+}
+
+static void HashArgon2dPhase0(benchmark::State& state)
+{
+    HashArgon2d<0>(state);
+}
+
+static void HashArgon2dPhase1(benchmark::State& state)
+{
+    HashArgon2d<1>(state);
+}
+
+static void HashArgon2dPhase2(benchmark::State& state)
+{
+    HashArgon2d<2>(state);
+}
+
+/**
+ * Phase 1 hashing on nThreads threads at once. Every iteration each thread
+ * hashes one nonce of its own header, so an iteration is nThreads hashes.
+ */
+class Argon2dHashWorkers
+{
+private:
+    std::mutex mutex;
+    std::condition_variable condWork;
+    std::condition_variable condDone;
+    uint64_t nGeneration;
+    int nPending;
+    bool fStop;
+    std::vector<std::thread> threads;
+
+    void Work(int nId)
+    {
+        std::vector<unsigned char> header(INPUT_BYTES, 0);
+        header[0] = nId;
+        uint32_t nNonce = 0;
+        uint64_t nSeen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            condWork.wait(lock, [&] { return fStop || nGeneration != nSeen; });
+            if (fStop)
+                break;
+            nSeen = nGeneration;
+            lock.unlock();
+            WriteLE32(&header[INPUT_BYTES - 4], nNonce++);
+            hash_Argon2d<1>(header.begin(), header.end());
+            lock.lock();
+            if (--nPending == 0)
+                condDone.notify_one();
+        }
+        lock.unlock();
+        Argon2dArenaRelease();
+    }
+
+public:
+    explicit Argon2dHashWorkers(int nThreads) : nGeneration(0), nPending(0), fStop(false)
+    {
+        for (int i = 0; i < nThreads; i++)
+            threads.emplace_back(&Argon2dHashWorkers::Work, this, i);
+    }
+
+    ~Argon2dHashWorkers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            fStop = true;
+        }
+        condWork.notify_all();
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+
+    void HashOnce()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        nPending = threads.size();
+        ++nGeneration;
+        condWork.notify_all();
+        condDone.wait(lock, [&] { return nPending == 0; });
+    }
+};
+
+static void HashArgon2dPhase1Threads(benchmark::State& state, int nThreads)
+{
+    // Each 1 KiB block of every pass reads its reference block and writes itself
+    const double dBytesPerHash = 2.0 * 1024 * Argon2dPhaseParams<1>::M_COST * Argon2dPhaseParams<1>::T_COST;
+
+    Argon2dHashWorkers workers(nThreads);
+    int64_t nIterations = 0;
+    int64_t nStart = GetTimeMicros();
+    while (state.KeepRunning()) {
+        workers.HashOnce();
+        nIterations++;
+    }
+    double dSeconds = (GetTimeMicros() - nStart) * 0.000001;
+    double dHashesPerSecond = nIterations * nThreads / dSeconds;
+    std::cout << "HashArgon2dPhase1Threads" << nThreads << ": " << dHashesPerSecond << " hashes/s, "
+              << dHashesPerSecond * dBytesPerHash / (1024 * 1024) << " MiB/s memory traffic\n";
+}
+
+static void HashArgon2dPhase1Threads1(benchmark::State& state)
+{
+    HashArgon2dPhase1Threads(state, 1);
+}
+
+static void HashArgon2dPhase1Threads2(benchmark::State& state)
+{
+    HashArgon2dPhase1Threads(state, 2);
+}
+
+static void HashArgon2dPhase1Threads4(benchmark::State& state)
+{
+    HashArgon2dPhase1Threads(state, 4);
+}
+
+static void HashArgon2dPhase1Threads8(benchmark::State& state)
+{
+    HashArgon2dPhase1Threads(state, 8);
+}
+
+// One thread per core
+static void HashArgon2dPhase1ThreadsAll(benchmark::State& state)
+{
+    HashArgon2dPhase1Threads(state, GetNumCores());
+}
+
+BENCHMARK(Argon2dPhase1Malloc);
+BENCHMARK(Argon2dPhase1Arena);
+BENCHMARK(Argon2dPhase1ArenaHugePages);
+BENCHMARK(Argon2dPhase1Interleave2);
+BENCHMARK(Argon2dPhase1Interleave4);
+BENCHMARK(HashArgon2dPhase0);
+BENCHMARK(HashArgon2dPhase1);
+BENCHMARK(HashArgon2dPhase2);
+BENCHMARK(HashArgon2dPhase1Threads1);
+BENCHMARK(HashArgon2dPhase1Threads2);
+BENCHMARK(HashArgon2dPhase1Threads4);
+BENCHMARK(HashArgon2dPhase1Threads8);
+BENCHMARK(HashArgon2dPhase1ThreadsAll);
@@ -4,6 +4,7 @@
 
 #include "bench.h"
 
+#include "crypto/argon2d_dispatch.h"
 #include "key.h"
 #include "random.h"
 #include "validation.h"
@@ -13,6 +14,7 @@ int
 main(int argc, char** argv)
 {
     RandomInit();
+    Argon2dAutoDetect();
     ECC_Start();
     SetupEnvironment();
     fPrintToDebugLog = false; // don't want to write to debug.log file
@@ -0,0 +1,72 @@
+// Copyright (c) 2016-2021 Duality Blockchain Solutions Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "primitives/block.h"
+#include "streams.h"
+#include "util.h"
+#include "validation.h"
+
+#include <boost/thread.hpp>
+
+static const unsigned int HEADER_CHAIN_LENGTH = 64;
+
+// Record a linked chain of headers as it would arrive in a headers message
+static CDataStream RecordHeaderChain()
+{
+    std::vector<CBlockHeader> headers(HEADER_CHAIN_LENGTH);
+    uint256 hashPrev;
+    for (unsigned int i = 0; i < headers.size(); i++) {
+        headers[i].nVersion = 4;
+        headers[i].hashPrevBlock = hashPrev;
+        headers[i].nTime = 1726660000 + i * 150;
+        headers[i].nBits = 0x207fffff;
+        headers[i].nNonce = i;
+        hashPrev = headers[i].GetHash();
+    }
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << headers;
+    return ss;
+}
+
+// Deserialize the recorded chain into fresh headers, hash it and check the linkage
+static void ReplayHeaderChain(benchmark::State& state, int nThreads)
+{
+    const CDataStream ssRecorded = RecordHeaderChain();
+
+    int nThreadsPrev = nHeaderVerifyThreads;
+    nHeaderVerifyThreads = nThreads;
+    boost::thread_group threadGroup;
+    for (int i = 0; i < nThreads - 1; i++)
+        threadGroup.create_thread(&ThreadHeaderVerify);
+
+    while (state.KeepRunning()) {
+        CDataStream ss(ssRecorded);
+        std::vector<CBlockHeader> headers;
+        ss >> headers;
+        PrecomputeHeaderHashes(headers);
+        uint256 hashLastBlock;
+        for (const CBlockHeader& header : headers) {
+            assert(hashLastBlock.IsNull() || header.hashPrevBlock == hashLastBlock);
+            hashLastBlock = header.GetHash();
+        }
+    }
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+    nHeaderVerifyThreads = nThreadsPrev;
+}
+
+static void HeaderChainReplaySerial(benchmark::State& state)
+{
+    ReplayHeaderChain(state, 0);
+}
+
+static void HeaderChainReplayParallel(benchmark::State& state)
+{
+    ReplayHeaderChain(state, std::max(2, std::min(GetNumCores(), MAX_HEADERVERIFY_THREADS)));
+}
+
+BENCHMARK(HeaderChainReplaySerial);
+BENCHMARK(HeaderChainReplayParallel);
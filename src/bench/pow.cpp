@@ -0,0 +1,71 @@
+// Copyright (c) 2016-2021 Duality Blockchain Solutions Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "bdap/vgpmessage.h"
+#include "chainparams.h"
+#include "pow.h"
+#include "primitives/block.h"
+
+#include <vector>
+
+// A header past the first Argon2d switch time, so it hashes with phase 1
+static CBlockHeader MakeHeader()
+{
+    CBlockHeader header;
+    header.nVersion = 4;
+    header.nTime = 1726660000;
+    header.nBits = 0x207fffff;
+    header.nNonce = 0;
+    return header;
+}
+
+// CBlockHeader::GetHash of a new nonce every iteration
+static void BlockHeaderGetHash(benchmark::State& state)
+{
+    CBlockHeader header = MakeHeader();
+    while (state.KeepRunning()) {
+        header.nNonce++;
+        header.GetHash();
+    }
+}
+
+// CBlockHeader::GetHash of an unchanged header, served by its hash cache
+static void BlockHeaderGetHashCached(benchmark::State& state)
+{
+    CBlockHeader header = MakeHeader();
+    header.GetHash();
+    while (state.KeepRunning()) {
+        header.GetHash();
+    }
+}
+
+// Proof-of-work check of a received header, hashing included
+static void CheckProofOfWorkHeader(benchmark::State& state)
+{
+    const Consensus::Params& consensusParams = Params(CBaseChainParams::REGTEST).GetConsensus();
+    CBlockHeader header = MakeHeader();
+    while (state.KeepRunning()) {
+        header.nNonce++;
+        CheckProofOfWork(header.GetHash(), header.nBits, consensusParams);
+    }
+}
+
+// Mining a VGP message up to VGP_MESSAGE_MIN_HASH_TARGET. The message is the
+// same every iteration, so every iteration does the same number of hashes.
+static void VGPMessageMine(benchmark::State& state)
+{
+    CUnsignedVGPMessage unsignedMessage(uint256S("01"), uint256S("02"), std::vector<unsigned char>(32, 0x03), 1726660000, 1726660000 + 60);
+    unsignedMessage.fEncrypted = false;
+    unsignedMessage.vchMessageData = std::vector<unsigned char>(256, 0x04);
+    while (state.KeepRunning()) {
+        CVGPMessage message(unsignedMessage);
+        message.MineMessage();
+    }
+}
+
+BENCHMARK(BlockHeaderGetHash);
+BENCHMARK(BlockHeaderGetHashCached);
+BENCHMARK(CheckProofOfWorkHeader);
+BENCHMARK(VGPMessageMine);
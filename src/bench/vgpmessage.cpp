@@ -0,0 +1,38 @@
+// Copyright (c) 2016-2021 Duality Blockchain Solutions Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "bdap/vgpmessage.h"
+#include "crypto/common.h"
+
+// Relay rate the received message log is measured at
+static const int64_t MESSAGES_PER_MINUTE = 100000;
+
+// Duplicate check and insert of a new message, as every relayed message does,
+// with the log filled to KEEP_MESSAGE_LOG_ALIVE_SECONDS of messages at 100k/min.
+// Time is simulated, so the log also expires buckets at that rate. Keeping up
+// with 100k messages/min takes an iteration time below 600us.
+static void VGPMessageLogRelay(benchmark::State& state)
+{
+    CVGPMessageLog log;
+    const int64_t nStartTime = 1726660000;
+    uint256 hash;
+    uint64_t nCount = 0;
+    while (nCount < (uint64_t)(MESSAGES_PER_MINUTE * KEEP_MESSAGE_LOG_ALIVE_SECONDS / 60)) {
+        WriteLE64(hash.begin(), nCount);
+        log.Insert(hash, nStartTime + nCount * 60 / MESSAGES_PER_MINUTE);
+        nCount++;
+    }
+
+    while (state.KeepRunning()) {
+        WriteLE64(hash.begin(), nCount);
+        int64_t nTime = nStartTime + nCount * 60 / MESSAGES_PER_MINUTE;
+        log.Insert(hash, nTime);
+        // The same message arriving again from another peer
+        log.Insert(hash, nTime);
+        nCount++;
+    }
+}
+
+BENCHMARK(VGPMessageLogRelay);
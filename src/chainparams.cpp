@@ -719,24 +719,7 @@ void SelectParams(const std::string& chain)
 {
     SelectBaseParams(chain);
     pCurrentParams = &Params(chain);
-}
-
-uint64_t FirstSwitchTime() {
-    try {
-        const CChainParams& params = Params(ChainNameFromCommandLine());
-        return params.FirstArgon2SwitchTime();
-    } catch (const std::exception& e) {
-        throw std::runtime_error("Error retrieving SecondSwitchTime: " + std::string(e.what()));
-    }
-}
-
-uint64_t SecondSwitchTime() {
-    try {
-        const CChainParams& params = Params(ChainNameFromCommandLine());
-        return params.SecondArgon2SwitchTime();
-    } catch (const std::exception& e) {
-        throw std::runtime_error("Error retrieving SecondSwitchTime: " + std::string(e.what()));
-    }
+    SetArgon2dSwitchTimes(pCurrentParams->FirstArgon2SwitchTime(), pCurrentParams->SecondArgon2SwitchTime());
 }
 
 void UpdateRegtestBIP9Parameters(Consensus::DeploymentPos d, int64_t nStartTime, int64_t nTimeout)
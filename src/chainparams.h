@@ -152,16 +152,6 @@ const CChainParams& Params();
  */
 void SelectParams(const std::string& chain);
 
-/**
- * Retrieves the FirstArgon2SwitchTime for the selected chain.
- */
-uint64_t FirstSwitchTime();
-
-/**
- * Retrieves the SecondArgon2SwitchTime for the selected chain.
- */
-uint64_t SecondSwitchTime();
-
 /**
  * Allows modifying the BIP9 regtest parameters.
  */
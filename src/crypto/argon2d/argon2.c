@@ -96,6 +96,89 @@ int argon2_ctx(argon2_context *context, argon2_type type) {
     return ARGON2_OK;
 }
 
+int argon2d_ctx_multi(argon2_context *contexts, uint32_t count) {
+    argon2_instance_t instances[ARGON2_MAX_INTERLEAVE];
+    uint32_t memory_blocks, segment_length, k, r, s, l;
+    block *memory = NULL;
+    int result;
+
+    if (contexts == NULL || count == 0 || count > ARGON2_MAX_INTERLEAVE) {
+        return ARGON2_INCORRECT_PARAMETER;
+    }
+
+    /* 1. Validate all inputs */
+    for (k = 0; k < count; ++k) {
+        result = validate_inputs(&contexts[k]);
+        if (ARGON2_OK != result) {
+            return result;
+        }
+        if (contexts[k].m_cost != contexts[0].m_cost ||
+            contexts[k].t_cost != contexts[0].t_cost ||
+            contexts[k].lanes != contexts[0].lanes) {
+            return ARGON2_INCORRECT_PARAMETER;
+        }
+    }
+
+    /* 2. Align memory size */
+    /* Minimum memory_blocks = 8L blocks, where L is the number of lanes */
+    memory_blocks = contexts[0].m_cost;
+
+    if (memory_blocks < 2 * ARGON2_SYNC_POINTS * contexts[0].lanes) {
+        memory_blocks = 2 * ARGON2_SYNC_POINTS * contexts[0].lanes;
+    }
+
+    segment_length = memory_blocks / (contexts[0].lanes * ARGON2_SYNC_POINTS);
+    /* Ensure that all segments have equal length */
+    memory_blocks = segment_length * (contexts[0].lanes * ARGON2_SYNC_POINTS);
+
+    /* 3. One allocation for all instances */
+    result = allocate_memory(&contexts[0], (uint8_t **)&memory,
+                             (size_t)memory_blocks * count, sizeof(block));
+    if (ARGON2_OK != result) {
+        return result;
+    }
+
+    /* 4. Initialization: Hashing inputs, filling first blocks */
+    for (k = 0; k < count; ++k) {
+        instances[k].memory = memory + (size_t)memory_blocks * k;
+        instances[k].version = ARGON2_VERSION_NUMBER;
+        instances[k].passes = contexts[0].t_cost;
+        instances[k].memory_blocks = memory_blocks;
+        instances[k].segment_length = segment_length;
+        instances[k].lane_length = segment_length * ARGON2_SYNC_POINTS;
+        instances[k].lanes = contexts[0].lanes;
+        instances[k].threads = 1;
+        instances[k].type = Argon2_d;
+        instances[k].print_internals = 0;
+
+        result = initialize(&instances[k], &contexts[k]);
+        if (ARGON2_OK != result) {
+            free_memory(&contexts[0], (uint8_t *)memory,
+                        (size_t)memory_blocks * count, sizeof(block));
+            return result;
+        }
+    }
+
+    /* 5. Filling memory */
+    for (r = 0; r < instances[0].passes; ++r) {
+        for (s = 0; s < ARGON2_SYNC_POINTS; ++s) {
+            for (l = 0; l < instances[0].lanes; ++l) {
+                argon2_position_t position = {r, l, (uint8_t)s, 0};
+                fill_segment_multi(instances, count, position);
+            }
+        }
+    }
+
+    /* 6. Finalization */
+    for (k = 0; k < count; ++k) {
+        finalize_tag(&contexts[k], &instances[k]);
+    }
+    free_memory(&contexts[0], (uint8_t *)memory,
+                (size_t)memory_blocks * count, sizeof(block));
+
+    return ARGON2_OK;
+}
+
 int argon2_hash(const uint32_t t_cost, const uint32_t m_cost,
                 const uint32_t parallelism, const void *pwd,
                 const size_t pwdlen, const void *salt, const size_t saltlen,
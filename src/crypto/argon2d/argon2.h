@@ -241,6 +241,21 @@ ARGON2_PUBLIC const char* argon2_type2string(argon2_type type, int uppercase);
  */
 ARGON2_PUBLIC int argon2_ctx(argon2_context* context, argon2_type type);
 
+/* Maximum number of hashes argon2d_ctx_multi interleaves */
+#define ARGON2_MAX_INTERLEAVE 8
+
+/*
+ * Argon2d over several contexts at once. The memory fills of all hashes are
+ * interleaved block by block, so the loads of one hash's reference block
+ * overlap with the mixing of the others. Every context must use the same
+ * m_cost, t_cost and lanes; threads is ignored. One allocation from the first
+ * context's allocator holds the memory of all hashes.
+ * @param  contexts  Array of @count contexts, each with its own input and output
+ * @param  count  Number of contexts, at most ARGON2_MAX_INTERLEAVE
+ * @return Error code if smth is wrong, ARGON2_OK otherwise
+ */
+ARGON2_PUBLIC int argon2d_ctx_multi(argon2_context* contexts, uint32_t count);
+
 ARGON2_PUBLIC int argon2d_hash_encoded(const uint32_t t_cost,
     const uint32_t m_cost,
     const uint32_t parallelism,
@@ -309,6 +324,28 @@ ARGON2_PUBLIC const char* argon2_error_message(int error_code);
  */
 ARGON2_PUBLIC size_t argon2_encodedlen(uint32_t t_cost, uint32_t m_cost, uint32_t parallelism, uint32_t saltlen, uint32_t hashlen, argon2_type type);
 
+/* Memory filling (fill_segment) implementations */
+typedef enum Argon2_impl {
+    Argon2_impl_native = 0, /* compiled with the build's default instruction set */
+    Argon2_impl_ssse3 = 1,
+    Argon2_impl_avx2 = 2,
+    Argon2_impl_avx512f = 3
+} argon2_impl;
+
+/**
+ * Select the memory filling implementation used by all later hashes. The
+ * caller is responsible for checking that the CPU supports it.
+ * @param impl  Implementation to use
+ * @return  Zero if successful, non zero if it was not compiled in
+ */
+ARGON2_PUBLIC int argon2_select_impl(argon2_impl impl);
+
+/**
+ * Name of the instruction set the given implementation was compiled for,
+ * NULL if it was not compiled in
+ */
+ARGON2_PUBLIC const char* argon2_impl_name(argon2_impl impl);
+
 #if defined(__cplusplus)
 }
 #endif
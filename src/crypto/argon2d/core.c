@@ -149,6 +149,15 @@ void clear_internal_memory(void *v, size_t n) {
 }
 
 void finalize(const argon2_context *context, argon2_instance_t *instance) {
+    if (context != NULL && instance != NULL) {
+        finalize_tag(context, instance);
+
+        free_memory(context, (uint8_t *)instance->memory,
+                    instance->memory_blocks, sizeof(block));
+    }
+}
+
+void finalize_tag(const argon2_context *context, argon2_instance_t *instance) {
     if (context != NULL && instance != NULL) {
         block blockhash;
         uint32_t l;
@@ -172,9 +181,6 @@ void finalize(const argon2_context *context, argon2_instance_t *instance) {
             clear_internal_memory(blockhash.v, ARGON2_BLOCK_SIZE);
             clear_internal_memory(blockhash_bytes, ARGON2_BLOCK_SIZE);
         }
-
-        free_memory(context, (uint8_t *)instance->memory,
-                    instance->memory_blocks, sizeof(block));
     }
 }
 
@@ -248,6 +254,67 @@ uint32_t index_alpha(const argon2_instance_t *instance,
     return absolute_position;
 }
 
+fill_segment_fptr fill_segment = fill_segment_native;
+fill_segment_multi_fptr fill_segment_multi = fill_segment_multi_native;
+
+int argon2_select_impl(argon2_impl impl) {
+    switch (impl) {
+    case Argon2_impl_native:
+        fill_segment = fill_segment_native;
+        fill_segment_multi = fill_segment_multi_native;
+        return ARGON2_OK;
+#if defined(ENABLE_ARGON2D_SSSE3)
+    case Argon2_impl_ssse3:
+        fill_segment = fill_segment_ssse3;
+        fill_segment_multi = fill_segment_multi_ssse3;
+        return ARGON2_OK;
+#endif
+#if defined(ENABLE_ARGON2D_AVX2)
+    case Argon2_impl_avx2:
+        fill_segment = fill_segment_avx2;
+        fill_segment_multi = fill_segment_multi_avx2;
+        return ARGON2_OK;
+#endif
+#if defined(ENABLE_ARGON2D_AVX512F)
+    case Argon2_impl_avx512f:
+        fill_segment = fill_segment_avx512f;
+        fill_segment_multi = fill_segment_multi_avx512f;
+        return ARGON2_OK;
+#endif
+    default:
+        return ARGON2_INCORRECT_TYPE;
+    }
+}
+
+const char *argon2_impl_name(argon2_impl impl) {
+    switch (impl) {
+    case Argon2_impl_native:
+#if defined(__AVX512F__)
+        return "avx512f";
+#elif defined(__AVX2__)
+        return "avx2";
+#elif defined(__SSSE3__)
+        return "ssse3";
+#else
+        return "sse2";
+#endif
+#if defined(ENABLE_ARGON2D_SSSE3)
+    case Argon2_impl_ssse3:
+        return "ssse3";
+#endif
+#if defined(ENABLE_ARGON2D_AVX2)
+    case Argon2_impl_avx2:
+        return "avx2";
+#endif
+#if defined(ENABLE_ARGON2D_AVX512F)
+    case Argon2_impl_avx512f:
+        return "avx512f";
+#endif
+    default:
+        return NULL;
+    }
+}
+
 /* Single-threaded version for p=1 case */
 static int fill_memory_blocks_st(argon2_instance_t *instance) {
     uint32_t r, s, l;
@@ -603,10 +670,12 @@ int initialize(argon2_instance_t *instance, argon2_context *context) {
     instance->context_ptr = context;
 
     /* 1. Memory allocation */
-    result = allocate_memory(context, (uint8_t **)&(instance->memory),
-                             instance->memory_blocks, sizeof(block));
-    if (result != ARGON2_OK) {
-        return result;
+    if (instance->memory == NULL) {
+        result = allocate_memory(context, (uint8_t **)&(instance->memory),
+                                 instance->memory_blocks, sizeof(block));
+        if (result != ARGON2_OK) {
+            return result;
+        }
     }
 
     /* 2. Initial hashing */
@@ -186,7 +186,8 @@ void fill_first_blocks(uint8_t *blockhash, const argon2_instance_t *instance);
 /*
  * Function allocates memory, hashes the inputs with Blake,  and creates first
  * two blocks. Returns the pointer to the main memory with 2 blocks per lane
- * initialized
+ * initialized. Memory is only allocated if @instance->memory is NULL, otherwise
+ * the caller owns it
  * @param  context  Pointer to the Argon2 internal structure containing memory
  * pointer, and parameters for time and space requirements.
  * @param  instance Current Argon2 instance
@@ -208,6 +209,12 @@ int initialize(argon2_instance_t *instance, argon2_context *context);
  */
 void finalize(const argon2_context *context, argon2_instance_t *instance);
 
+/*
+ * The hashing part of finalize: writes the tag to @context->out but leaves
+ * the memory of @instance allocated
+ */
+void finalize_tag(const argon2_context *context, argon2_instance_t *instance);
+
 /*
  * Function that fills the segment using previous segments also from other
  * threads
@@ -216,8 +223,42 @@ void finalize(const argon2_context *context, argon2_instance_t *instance);
  * @param position Current position
  * @pre all block pointers must be valid
  */
-void fill_segment(const argon2_instance_t *instance,
-                  argon2_position_t position);
+typedef void (*fill_segment_fptr)(const argon2_instance_t *instance,
+                                  argon2_position_t position);
+
+/* opt.c, compiled once per instruction set and selected at runtime */
+void fill_segment_native(const argon2_instance_t *instance,
+                         argon2_position_t position);
+void fill_segment_ssse3(const argon2_instance_t *instance,
+                        argon2_position_t position);
+void fill_segment_avx2(const argon2_instance_t *instance,
+                       argon2_position_t position);
+void fill_segment_avx512f(const argon2_instance_t *instance,
+                          argon2_position_t position);
+
+/*
+ * Fills the same segment of @count instances with identical geometry,
+ * interleaving them block by block
+ * @param instances Array of @count instances
+ * @param count Number of instances, at most ARGON2_MAX_INTERLEAVE
+ * @param position Current position
+ */
+typedef void (*fill_segment_multi_fptr)(const argon2_instance_t *instances,
+                                        uint32_t count,
+                                        argon2_position_t position);
+
+void fill_segment_multi_native(const argon2_instance_t *instances,
+                               uint32_t count, argon2_position_t position);
+void fill_segment_multi_ssse3(const argon2_instance_t *instances,
+                              uint32_t count, argon2_position_t position);
+void fill_segment_multi_avx2(const argon2_instance_t *instances,
+                             uint32_t count, argon2_position_t position);
+void fill_segment_multi_avx512f(const argon2_instance_t *instances,
+                                uint32_t count, argon2_position_t position);
+
+/* Implementations in use, see argon2_select_impl */
+extern fill_segment_fptr fill_segment;
+extern fill_segment_multi_fptr fill_segment_multi;
 
 /*
  * Function that fills the entire memory t_cost times based on the first two
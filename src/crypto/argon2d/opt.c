@@ -25,6 +25,14 @@
 #include "../blake2/blake2.h"
 #include "../blake2/blamka-round-opt.h"
 
+/* Name of the exported fill_segment, overridden by the opt_<isa>.c wrappers */
+#ifndef ARGON2_FILL_SEGMENT
+#define ARGON2_FILL_SEGMENT fill_segment_native
+#endif
+#ifndef ARGON2_FILL_SEGMENT_MULTI
+#define ARGON2_FILL_SEGMENT_MULTI fill_segment_multi_native
+#endif
+
 /*
  * Function fills a new memory block and optionally XORs the old block over the new one.
  * Memory must be initialized.
@@ -171,8 +179,8 @@ static void next_addresses(block *address_block, block *input_block) {
     fill_block(zero2_block, address_block, address_block, 0);
 }
 
-void fill_segment(const argon2_instance_t *instance,
-                  argon2_position_t position) {
+void ARGON2_FILL_SEGMENT(const argon2_instance_t *instance,
+                         argon2_position_t position) {
     block *ref_block = NULL, *curr_block = NULL;
     block address_block, input_block;
     uint64_t pseudo_rand, ref_index, ref_lane;
@@ -262,3 +270,104 @@ void fill_segment(const argon2_instance_t *instance,
         fill_block(state, ref_block, curr_block, 0);   
     }
 }
+
+/* Start loading all cache lines of a block */
+static void prefetch_block(const block *b) {
+    unsigned int i;
+    for (i = 0; i < ARGON2_QWORDS_IN_BLOCK; i += 8) {
+        _mm_prefetch((const char *)&b->v[i], _MM_HINT_T0);
+    }
+}
+
+void ARGON2_FILL_SEGMENT_MULTI(const argon2_instance_t *instances,
+                               uint32_t count, argon2_position_t position) {
+    block *ref_blocks[ARGON2_MAX_INTERLEAVE];
+    uint64_t pseudo_rand, ref_index, ref_lane;
+    uint32_t prev_offset, curr_offset;
+    uint32_t starting_index, i, k;
+#if defined(__AVX512F__)
+    __m512i state[ARGON2_MAX_INTERLEAVE][ARGON2_512BIT_WORDS_IN_BLOCK];
+#elif defined(__AVX2__)
+    __m256i state[ARGON2_MAX_INTERLEAVE][ARGON2_HWORDS_IN_BLOCK];
+#else
+    __m128i state[ARGON2_MAX_INTERLEAVE][ARGON2_OWORDS_IN_BLOCK];
+#endif
+    /* All instances share the geometry of the first one */
+    const argon2_instance_t *instance = instances;
+
+    if (instances == NULL || count == 0 || count > ARGON2_MAX_INTERLEAVE) {
+        return;
+    }
+
+    if (instance->type != Argon2_d) {
+        /* Data-independent addressing is not interleaved */
+        for (k = 0; k < count; ++k) {
+            ARGON2_FILL_SEGMENT(&instances[k], position);
+        }
+        return;
+    }
+
+    starting_index = 0;
+
+    if ((0 == position.pass) && (0 == position.slice)) {
+        starting_index = 2; /* we have already generated the first two blocks */
+    }
+
+    /* Offset of the current block */
+    curr_offset = position.lane * instance->lane_length +
+                  position.slice * instance->segment_length + starting_index;
+
+    if (0 == curr_offset % instance->lane_length) {
+        /* Last block in this lane */
+        prev_offset = curr_offset + instance->lane_length - 1;
+    } else {
+        /* Previous block */
+        prev_offset = curr_offset - 1;
+    }
+
+    for (k = 0; k < count; ++k) {
+        memcpy(state[k], ((instances[k].memory + prev_offset)->v),
+               ARGON2_BLOCK_SIZE);
+    }
+
+    for (i = starting_index; i < instance->segment_length;
+         ++i, ++curr_offset, ++prev_offset) {
+        /*1.1 Rotating prev_offset if needed */
+        if (curr_offset % instance->lane_length == 1) {
+            prev_offset = curr_offset - 1;
+        }
+
+        /* 1.2 Locate the reference block of every instance and start
+         * loading them all before mixing any */
+        position.index = i;
+        for (k = 0; k < count; ++k) {
+            /* 1.2.1 Taking pseudo-random value from the previous block */
+            pseudo_rand = instances[k].memory[prev_offset].v[0];
+
+            /* 1.2.2 Computing the lane of the reference block */
+            ref_lane = ((pseudo_rand >> 32)) % instance->lanes;
+
+            if ((position.pass == 0) && (position.slice == 0)) {
+                /* Can not reference other lanes yet */
+                ref_lane = position.lane;
+            }
+
+            /* 1.2.3 Computing the number of possible reference block within
+             * the lane.
+             */
+            ref_index = index_alpha(instance, &position,
+                                    pseudo_rand & 0xFFFFFFFF,
+                                    ref_lane == position.lane);
+
+            ref_blocks[k] = instances[k].memory +
+                            instance->lane_length * ref_lane + ref_index;
+            prefetch_block(ref_blocks[k]);
+        }
+
+        /* 2 Creating the new blocks */
+        for (k = 0; k < count; ++k) {
+            fill_block(state[k], ref_blocks[k],
+                       instances[k].memory + curr_offset, 0);
+        }
+    }
+}
@@ -0,0 +1,9 @@
+/*
+ * Argon2 memory filling compiled for AVX512F. Only linked in when the
+ * compiler supports the instruction set; picked at runtime by
+ * Argon2dAutoDetect() after checking that the CPU does too.
+ */
+
+#define ARGON2_FILL_SEGMENT fill_segment_avx512f
+#define ARGON2_FILL_SEGMENT_MULTI fill_segment_multi_avx512f
+#include "opt.c"
@@ -0,0 +1,176 @@
+// Copyright (c) 2016-2021 Duality Blockchain Solutions Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/argon2d_arena.h"
+
+#ifdef WIN32
+#ifdef _WIN32_WINNT
+#undef _WIN32_WINNT
+#endif
+#define _WIN32_WINNT 0x0501
+#define WIN32_LEAN_AND_MEAN 1
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h> // for mmap
+#include <unistd.h>   // for sysconf
+#endif
+
+#include <atomic>
+#include <stdlib.h>
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+namespace
+{
+static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+std::atomic<bool> fArenaHugePages{false};
+
+size_t align_up(size_t x, size_t align)
+{
+    return (x + align - 1) & ~(align - 1);
+}
+
+size_t GetPageSize()
+{
+#ifdef WIN32
+    SYSTEM_INFO sSysInfo;
+    GetSystemInfo(&sSysInfo);
+    return sSysInfo.dwPageSize;
+#elif defined(PAGESIZE)
+    return PAGESIZE;
+#else
+    return sysconf(_SC_PAGESIZE);
+#endif
+}
+
+/** Map len bytes of zeroed anonymous memory, returns the mapped length in len */
+uint8_t* MapArena(size_t& len, bool fHugePages)
+{
+#ifdef WIN32
+    len = align_up(len, GetPageSize());
+    return static_cast<uint8_t*>(VirtualAlloc(nullptr, len, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+#else
+    void* addr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (fHugePages) {
+        // Explicit huge pages only work if the administrator reserved some (vm.nr_hugepages)
+        size_t hugeLen = align_up(len, HUGE_PAGE_SIZE);
+        addr = mmap(nullptr, hugeLen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (addr != MAP_FAILED) {
+            len = hugeLen;
+            return static_cast<uint8_t*>(addr);
+        }
+    }
+#endif
+    len = align_up(len, fHugePages ? HUGE_PAGE_SIZE : GetPageSize());
+    addr = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED)
+        return nullptr;
+#ifdef MADV_HUGEPAGE
+    if (fHugePages)
+        madvise(addr, len, MADV_HUGEPAGE); // Ask for transparent huge pages, best effort
+#endif
+    return static_cast<uint8_t*>(addr);
+#endif
+}
+
+void UnmapArena(uint8_t* addr, size_t len)
+{
+#ifdef WIN32
+    VirtualFree(addr, 0, MEM_RELEASE);
+#else
+    munmap(addr, len);
+#endif
+}
+
+/** One thread's scratch memory. Only ever touched by its owning thread. */
+class ScratchArena
+{
+private:
+    uint8_t* base;
+    size_t size;
+    bool fInUse;
+
+public:
+    ScratchArena() : base(nullptr), size(0), fInUse(false) {}
+    ~ScratchArena() { Release(); }
+
+    uint8_t* Acquire(size_t bytes)
+    {
+        if (fInUse)
+            return nullptr;
+        if (bytes > size) {
+            Release();
+            size_t len = bytes;
+            base = MapArena(len, fArenaHugePages.load(std::memory_order_relaxed));
+            if (base == nullptr)
+                return nullptr;
+            size = len;
+        }
+        fInUse = true;
+        return base;
+    }
+
+    bool Give(uint8_t* memory)
+    {
+        if (memory == nullptr || memory != base || !fInUse)
+            return false;
+        fInUse = false;
+        return true;
+    }
+
+    void Release()
+    {
+        if (base == nullptr || fInUse)
+            return;
+        UnmapArena(base, size);
+        base = nullptr;
+        size = 0;
+    }
+
+    size_t Size() const { return size; }
+};
+
+thread_local ScratchArena threadArena;
+} // namespace
+
+int Argon2dArenaAllocate(uint8_t** memory, size_t bytes_to_allocate)
+{
+    *memory = threadArena.Acquire(bytes_to_allocate);
+    if (*memory == nullptr)
+        *memory = static_cast<uint8_t*>(malloc(bytes_to_allocate));
+    return *memory == nullptr ? -1 : 0;
+}
+
+void Argon2dArenaFree(uint8_t* memory, size_t bytes_to_allocate)
+{
+    if (!threadArena.Give(memory))
+        free(memory);
+}
+
+void Argon2dArenaRelease()
+{
+    threadArena.Release();
+}
+
+size_t Argon2dArenaSize()
+{
+    return threadArena.Size();
+}
+
+void Argon2dArenaSetHugePages(bool fEnable)
+{
+    fArenaHugePages.store(fEnable, std::memory_order_relaxed);
+}
+
+bool Argon2dArenaGetHugePages()
+{
+    return fArenaHugePages.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,42 @@
+// Copyright (c) 2016-2021 Duality Blockchain Solutions Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef CASH_CRYPTO_ARGON2D_ARENA_H
+#define CASH_CRYPTO_ARGON2D_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Reusable per-thread scratch memory for Argon2d proof-of-work hashing.
+ *
+ * Argon2d allocates its whole memory matrix (1-8 MiB for the PoW phases) on
+ * every call. These functions are meant to be installed as the
+ * allocate_cbk/free_cbk hooks of an argon2_context: the first hash on a thread
+ * maps an arena large enough for the request and later hashes on that thread
+ * reuse it, so hashing loops stop going through malloc/free and page-faulting
+ * fresh memory for every nonce. Nested or oversized requests that the arena
+ * cannot serve fall back to malloc.
+ */
+
+/** Argon2 allocate_cbk: hand out the calling thread's scratch arena */
+int Argon2dArenaAllocate(uint8_t** memory, size_t bytes_to_allocate);
+
+/** Argon2 free_cbk: give back memory obtained from Argon2dArenaAllocate */
+void Argon2dArenaFree(uint8_t* memory, size_t bytes_to_allocate);
+
+/** Unmap the calling thread's arena. It is mapped again on the next hash. */
+void Argon2dArenaRelease();
+
+/** Size in bytes of the calling thread's arena, 0 if none is mapped */
+size_t Argon2dArenaSize();
+
+/**
+ * Back arenas mapped from now on with huge pages where the OS supports it
+ * (explicit 2 MiB pages, falling back to transparent huge pages on Linux).
+ */
+void Argon2dArenaSetHugePages(bool fEnable);
+bool Argon2dArenaGetHugePages();
+
+#endif // CASH_CRYPTO_ARGON2D_ARENA_H
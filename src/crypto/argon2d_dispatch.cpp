@@ -0,0 +1,83 @@
+// Copyright (c) 2016-2021 Duality Blockchain Solutions Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/argon2d_dispatch.h"
+
+#include "crypto/argon2d/argon2.h"
+
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__amd64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace
+{
+std::atomic<argon2_impl> implCurrent{Argon2_impl_native};
+
+#if defined(__x86_64__) || defined(__amd64__) || defined(__i386__)
+// We can't use cpuid.h's __get_cpuid as it does not support subleafs.
+void inline cpuid(uint32_t leaf, uint32_t subleaf, uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d)
+{
+#ifdef __GNUC__
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+#else
+    __asm__("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "0"(leaf), "2"(subleaf));
+#endif
+}
+
+/** Return the XCR0 bits the OS saves on context switch. */
+uint32_t GetXCR0()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return a;
+}
+#endif
+
+bool UseImpl(argon2_impl impl)
+{
+    if (argon2_select_impl(impl) != ARGON2_OK)
+        return false;
+    implCurrent = impl;
+    return true;
+}
+} // namespace
+
+std::string Argon2dAutoDetect()
+{
+#if defined(__x86_64__) || defined(__amd64__) || defined(__i386__)
+    bool have_ssse3 = false;
+    bool have_avx2 = false;
+    bool have_avx512f = false;
+
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(0, 0, eax, ebx, ecx, edx);
+    const uint32_t max_leaf = eax;
+    cpuid(1, 0, eax, ebx, ecx, edx);
+    have_ssse3 = (ecx >> 9) & 1;
+    const bool have_osxsave = (ecx >> 27) & 1;
+    const bool have_avx = (ecx >> 28) & 1;
+    if (have_osxsave && have_avx && max_leaf >= 7) {
+        const uint32_t xcr0 = GetXCR0();
+        cpuid(7, 0, eax, ebx, ecx, edx);
+        // AVX2 needs the XMM and YMM state enabled, AVX-512 additionally opmask and ZMM state
+        have_avx2 = ((xcr0 & 0x06) == 0x06) && ((ebx >> 5) & 1);
+        have_avx512f = ((xcr0 & 0xe6) == 0xe6) && ((ebx >> 16) & 1);
+    }
+
+    if (!(have_avx512f && UseImpl(Argon2_impl_avx512f)) &&
+        !(have_avx2 && UseImpl(Argon2_impl_avx2)) &&
+        !(have_ssse3 && UseImpl(Argon2_impl_ssse3))) {
+        UseImpl(Argon2_impl_native);
+    }
+#endif
+    return Argon2dImplementation();
+}
+
+std::string Argon2dImplementation()
+{
+    const char* name = argon2_impl_name(implCurrent);
+    return name ? name : "unknown";
+}
@@ -0,0 +1,18 @@
+// Copyright (c) 2016-2021 Duality Blockchain Solutions Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef CASH_CRYPTO_ARGON2D_DISPATCH_H
+#define CASH_CRYPTO_ARGON2D_DISPATCH_H
+
+#include <string>
+
+/** Autodetect the best available Argon2d memory filling implementation.
+ *  Returns the name of the implementation.
+ */
+std::string Argon2dAutoDetect();
+
+/** Name of the Argon2d implementation currently in use */
+std::string Argon2dImplementation();
+
+#endif // CASH_CRYPTO_ARGON2D_DISPATCH_H
@@ -4,7 +4,9 @@
 
 #include "dht/mutabledb.h"
 
+#include "clientversion.h"
 #include "dht/mutable.h"
+#include "memusage.h"
 #include "util.h"
 
 #include <univalue.h>
@@ -17,6 +19,65 @@ static std::map<std::vector<unsigned char>, CMutableData> mapDataStorage;
 
 CMutableDataDB *pMutableDataDB = NULL;
 
+// Shared by every DHT session, cs_mutable_cache also orders the sequence
+// number check of a put with its database write
+static CCriticalSection cs_mutable_cache;
+static CMutableDataCache mutableCache(DEFAULT_DHT_MUTABLE_CACHE << 20);
+
+size_t CMutableDataCache::ItemUsage(const item_t& item)
+{
+    // The info hash is held by both the list item and the index
+    return memusage::MallocUsage(sizeof(item_t) + 2 * sizeof(void*)) + memusage::MallocUsage(sizeof(item.first) + sizeof(list_t::iterator) + 4 * sizeof(void*))
+               + 2 * memusage::DynamicUsage(item.first) + ::GetSerializeSize(item.second, SER_DISK, CLIENT_VERSION);
+}
+
+void CMutableDataCache::Trim()
+{
+    while (nUsage > nMaxUsage && !listItems.empty()) {
+        nUsage -= ItemUsage(listItems.back());
+        mapIndex.erase(listItems.back().first);
+        listItems.pop_back();
+    }
+}
+
+bool CMutableDataCache::Get(const std::vector<unsigned char>& vchInfoHash, CMutableData& data)
+{
+    std::map<std::vector<unsigned char>, list_t::iterator>::iterator it = mapIndex.find(vchInfoHash);
+    if (it == mapIndex.end()) {
+        nMisses++;
+        return false;
+    }
+    nHits++;
+    listItems.splice(listItems.begin(), listItems, it->second);
+    data = it->second->second;
+    return true;
+}
+
+void CMutableDataCache::Insert(const std::vector<unsigned char>& vchInfoHash, const CMutableData& data)
+{
+    Erase(vchInfoHash);
+    listItems.emplace_front(vchInfoHash, data);
+    mapIndex.emplace(vchInfoHash, listItems.begin());
+    nUsage += ItemUsage(listItems.front());
+    Trim();
+}
+
+void CMutableDataCache::Erase(const std::vector<unsigned char>& vchInfoHash)
+{
+    std::map<std::vector<unsigned char>, list_t::iterator>::iterator it = mapIndex.find(vchInfoHash);
+    if (it == mapIndex.end())
+        return;
+    nUsage -= ItemUsage(*it->second);
+    listItems.erase(it->second);
+    mapIndex.erase(it);
+}
+
+void CMutableDataCache::SetMaxUsage(size_t nMaxUsageIn)
+{
+    nMaxUsage = nMaxUsageIn;
+    Trim();
+}
+
 bool AddLocalMutableData(const std::vector<unsigned char>& vchInfoHash,const  CMutableData& data)
 {
     if (!pMutableDataDB) {
@@ -114,6 +175,50 @@ bool CheckMutableItemDB()
     return true;
 }
 
+bool GetCachedMutableData(const std::vector<unsigned char>& vchInfoHash, CMutableData& data)
+{
+    LOCK(cs_mutable_cache);
+    if (mutableCache.Get(vchInfoHash, data))
+        return true;
+
+    if (!GetLocalMutableData(vchInfoHash, data))
+        return false;
+
+    mutableCache.Insert(vchInfoHash, data);
+    return true;
+}
+
+bool PutNewerMutableData(const std::vector<unsigned char>& vchInfoHash, const CMutableData& data, bool& fNewer)
+{
+    LOCK(cs_mutable_cache);
+    CMutableData previousData;
+    bool fFound = GetCachedMutableData(vchInfoHash, previousData);
+    fNewer = !fFound || data.SequenceNumber > previousData.SequenceNumber;
+    if (!fNewer)
+        return false;
+
+    if (fFound ? !UpdateLocalMutableData(vchInfoHash, data) : !AddLocalMutableData(vchInfoHash, data))
+        return false;
+
+    mutableCache.Insert(vchInfoHash, data);
+    return true;
+}
+
+void SetMutableDataCacheSize(size_t nMaxUsage)
+{
+    LOCK(cs_mutable_cache);
+    mutableCache.SetMaxUsage(nMaxUsage);
+}
+
+void GetMutableDataCacheInfo(size_t& nItems, size_t& nUsage, uint64_t& nHits, uint64_t& nMisses)
+{
+    LOCK(cs_mutable_cache);
+    nItems = mutableCache.GetSize();
+    nUsage = mutableCache.DynamicMemoryUsage();
+    nHits = mutableCache.GetHits();
+    nMisses = mutableCache.GetMisses();
+}
+
 bool CMutableDataDB::AddMutableData(const CMutableData& data)
 {
     bool writeState = false;
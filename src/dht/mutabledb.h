@@ -6,11 +6,49 @@
 #define CASH_DHT_MUTABLE_DB_H
 
 #include "dbwrapper.h"
+#include "dht/mutable.h"
 #include "sync.h"
 
+#include <list>
+#include <map>
+
 static CCriticalSection cs_dht_entry;
 
-class CMutableData;
+/** Default for -dhtmutablecache, the memory in MiB of mutable items kept in front of the database */
+static const int64_t DEFAULT_DHT_MUTABLE_CACHE = 16;
+
+/**
+ * The most recently used mutable items of the local mutable data database,
+ * by info hash, bounded by their estimated memory usage.
+ */
+class CMutableDataCache
+{
+private:
+    typedef std::pair<std::vector<unsigned char>, CMutableData> item_t;
+    typedef std::list<item_t> list_t;
+
+    size_t nMaxUsage;
+    size_t nUsage;
+    list_t listItems;
+    std::map<std::vector<unsigned char>, list_t::iterator> mapIndex;
+    uint64_t nHits;
+    uint64_t nMisses;
+
+    static size_t ItemUsage(const item_t& item);
+    void Trim();
+
+public:
+    explicit CMutableDataCache(size_t nMaxUsageIn) : nMaxUsage(nMaxUsageIn), nUsage(0), nHits(0), nMisses(0) {}
+
+    bool Get(const std::vector<unsigned char>& vchInfoHash, CMutableData& data);
+    void Insert(const std::vector<unsigned char>& vchInfoHash, const CMutableData& data);
+    void Erase(const std::vector<unsigned char>& vchInfoHash);
+    void SetMaxUsage(size_t nMaxUsageIn);
+    size_t GetSize() const { return listItems.size(); }
+    size_t DynamicMemoryUsage() const { return nUsage; }
+    uint64_t GetHits() const { return nHits; }
+    uint64_t GetMisses() const { return nMisses; }
+};
 
 class CMutableDataDB : public CDBWrapper {
 public:
@@ -39,6 +77,16 @@ bool GetAllLocalMutableData(std::vector<CMutableData>& vchMutableData);
 bool InitMemoryMap();
 bool SelectRandomMutableItem(CMutableData& randomItem);
 bool CheckMutableItemDB();
+/** Read a mutable item through the process-wide mutable item cache */
+bool GetCachedMutableData(const std::vector<unsigned char>& vchInfoHash, CMutableData& data);
+/**
+ * Store a mutable item if its sequence number is newer than the one held.
+ * fNewer is false when the item was not newer, the cache is only updated
+ * after the database write succeeds.
+ */
+bool PutNewerMutableData(const std::vector<unsigned char>& vchInfoHash, const CMutableData& data, bool& fNewer);
+void SetMutableDataCacheSize(size_t nMaxUsage);
+void GetMutableDataCacheInfo(size_t& nItems, size_t& nUsage, uint64_t& nHits, uint64_t& nMisses);
 
 extern CMutableDataDB* pMutableDataDB;
 
@@ -83,12 +83,11 @@ bool CDHTStorage::get_mutable_item_seq(sha1_hash const& target, sequence_number&
         return false;
     //bool ret = pDefaultStorage->get_mutable_item_seq(target, seq);
     //return ret;
-    // TODO (DHT): Try to find entry in memory before searching leveldb
     CMutableData mutableData;
     std::string strInfoHash = aux::to_hex(target.to_string());
     CharString vchInfoHash = vchFromString(strInfoHash);
     LogPrint("dht", "CDHTStorage -- get_mutable_item_seq infohash = %s\n", strInfoHash);
-    if (!GetLocalMutableData(vchInfoHash, mutableData)) {
+    if (!GetCachedMutableData(vchInfoHash, mutableData)) {
         LogPrintf("********** CDHTStorage -- get_mutable_item_seq failed to get mutable entry sequence_number for infohash = %s.\n", strInfoHash);
         return false;
     }
@@ -113,11 +112,10 @@ bool CDHTStorage::get_mutable_item(sha1_hash const& target, sequence_number cons
         return false;
     //bool ret = pDefaultStorage->get_mutable_item(target, seq, force_fill, item);
     //return ret;
-    // TODO (DHT): Try to find entry in memory before searching leveldb
     CMutableData mutableData;
     std::string strInfoHash = aux::to_hex(target.to_string());
     CharString vchInfoHash = vchFromString(strInfoHash);
-    if (!GetLocalMutableData(vchInfoHash, mutableData)) {
+    if (!GetCachedMutableData(vchInfoHash, mutableData)) {
         LogPrintf("********** CDHTStorage -- get_mutable_item failed to get mutable entry for infohash = %s.\n", strInfoHash);
         return false;
     }
@@ -154,7 +152,6 @@ void CDHTStorage::put_mutable_item(sha1_hash const& target
 {
     if (!fMasternodeMode) // Do not store DHT data if not a Masternode
         return;
-    // TODO (DHT): Store entries in memory as well
     //pDefaultStorage->put_mutable_item(target, buf, sig, seq, pk, salt, addr);
 
     std::string strInfoHash = aux::to_hex(target.to_string());
@@ -191,21 +188,12 @@ void CDHTStorage::put_mutable_item(sha1_hash const& target
                     __func__, strInfoHash, strPutValue, strSalt, putMutableData.SequenceNumber, 
                     vchPutValue.size(), vchSignature.size(), vchPublicKey.size(), vchSalt.size());
 
-    CMutableData previousData;
-    if (!GetLocalMutableData(vchInfoHash, previousData)) {
-        if (PutLocalMutableData(vchInfoHash, putMutableData)) {
-            LogPrintf("CDHTStorage::%s added successfully\n", __func__);
-        }
+    bool fNewer;
+    if (PutNewerMutableData(vchInfoHash, putMutableData, fNewer)) {
+        LogPrintf("CDHTStorage::%s stored successfully\n", __func__);
     }
-    else {
-        if (putMutableData.SequenceNumber > previousData.SequenceNumber) {
-            if (UpdateLocalMutableData(vchInfoHash, putMutableData)) {
-                LogPrintf("CDHTStorage::%s updated successfully\n", __func__);
-            }
-        }
-        else {
-            LogPrintf("CDHTStorage::%s value unchanged. No database operation needed.\n", __func__);
-        }
+    else if (!fNewer) {
+        LogPrintf("CDHTStorage::%s value unchanged. No database operation needed.\n", __func__);
     }
     // TODO: Log from address (addr). See touch_item in the default storage implementation.
     return;
@@ -12,6 +12,8 @@
 
 #include "pubkey.h"
 
+#include <atomic>
+
 
 inline uint32_t ROTL32(uint32_t x, int8_t r)
 {
@@ -261,3 +263,25 @@ uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint3
     SIPROUND;
     return v0 ^ v1 ^ v2 ^ v3;
 }
+
+namespace
+{
+// Main network switch times, replaced by SelectParams
+std::atomic<uint64_t> nArgon2dFirstSwitchTime{1726660000};
+std::atomic<uint64_t> nArgon2dSecondSwitchTime{4070908800};
+} // namespace
+
+void SetArgon2dSwitchTimes(uint64_t nFirstSwitchTime, uint64_t nSecondSwitchTime)
+{
+    nArgon2dFirstSwitchTime.store(nFirstSwitchTime, std::memory_order_relaxed);
+    nArgon2dSecondSwitchTime.store(nSecondSwitchTime, std::memory_order_relaxed);
+}
+
+unsigned int GetArgon2dPhase(uint64_t nTime)
+{
+    if (nTime >= nArgon2dSecondSwitchTime.load(std::memory_order_relaxed))
+        return 2;
+    if (nTime >= nArgon2dFirstSwitchTime.load(std::memory_order_relaxed))
+        return 1;
+    return 0;
+}
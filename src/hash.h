@@ -9,6 +9,7 @@
 #define CASH_HASH_H
 
 #include "crypto/argon2d/argon2.h"
+#include "crypto/argon2d_arena.h"
 #include "crypto/blake2/blake2.h"
 #include "crypto/ripemd160.h"
 #include "crypto/sha256.h"
@@ -315,7 +316,7 @@ uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint3
 /// A memory cost, which defines the memory usage, given in kibibytes (1 kibibytes = kilobytes 1.024)
 /// A parallelism degree, which defines the number of parallel threads
 
-/// Argon2d Phase 0 Hash parameters
+/// The proof-of-work phases share these Argon2d settings:
 /// Salt and password are the block header.
 /// Output length: 32 bytes.
 /// Input length (in the case of a block header): 80 bytes.
@@ -326,93 +327,49 @@ uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint3
 /// Secret length: 0
 /// Associated data: None
 /// Associated data length: 0
+/// Threads: 1 threads
+template <unsigned int Phase>
+struct Argon2dPhaseParams;
+
+/// Argon2d Phase 0 Hash parameters
 /// Memory cost: 2048 kibibytes
 /// Lanes: 12 parallel threads
-/// Threads: 1 threads
 /// Time Constraint: 3 iterations
-inline int Argon2d_Phase0_Hash(const void* in, const size_t size, const void* out)
-{
-    argon2_context context;
-    context.out = (uint8_t*)out;
-    context.outlen = (uint32_t)OUTPUT_BYTES;
-    context.pwd = (uint8_t*)in;
-    context.pwdlen = (uint32_t)size;
-    context.salt = (uint8_t*)in; //salt = input
-    context.saltlen = (uint32_t)size;
-    context.secret = NULL;
-    context.secretlen = 0;
-    context.ad = NULL;
-    context.adlen = 0;
-    context.allocate_cbk = NULL;
-    context.free_cbk = NULL;
-    context.flags = DEFAULT_ARGON2_FLAG; // = ARGON2_DEFAULT_FLAGS
-    // main configurable Argon2 hash parameters
-    context.m_cost = 2048; // Memory in KiB (2 MiB)
-    context.lanes = 12;    // Degree of Parallelism
-    context.threads = 1;   // Threads
-    context.t_cost = 3;    // Iterations
-
-    return argon2_ctx(&context, Argon2_d);
-}
+template <>
+struct Argon2dPhaseParams<0> {
+    static const uint32_t M_COST = 2048; // Memory in KiB (2 MiB)
+    static const uint32_t LANES = 12;    // Degree of Parallelism
+    static const uint32_t T_COST = 3;    // Iterations
+};
 
 /// Argon2d Phase 1 Hash parameters
-/// Salt and password are the block header.
-/// Output length: 32 bytes.
-/// Input length (in the case of a block header): 80 bytes.
-/// Salt length (same note as input length): 80 bytes.
-/// Input: Block header
-/// Salt: Block header (SAME AS INPUT)
-/// Secret data: None
-/// Secret length: 0
-/// Associated data: None
-/// Associated data length: 0
 /// Memory cost: 1000 kibibytes
 /// Lanes: 8 parallel threads
-/// Threads: 1 threads
 /// Time Constraint: 2 iterations
-inline int Argon2d_Phase1_Hash(const void* in, const size_t size, const void* out)
-{
-    argon2_context context;
-    context.out = (uint8_t*)out;
-    context.outlen = (uint32_t)OUTPUT_BYTES;
-    context.pwd = (uint8_t*)in;
-    context.pwdlen = (uint32_t)size;
-    context.salt = (uint8_t*)in; //salt = input
-    context.saltlen = (uint32_t)size;
-    context.secret = NULL;
-    context.secretlen = 0;
-    context.ad = NULL;
-    context.adlen = 0;
-    context.allocate_cbk = NULL;
-    context.free_cbk = NULL;
-    context.flags = DEFAULT_ARGON2_FLAG; // = ARGON2_DEFAULT_FLAGS
-    // main configurable Argon2 hash parameters
-    context.m_cost = 1000; // Memory in KiB (1000 KiB)
-    context.lanes = 8;     // Degree of Parallelism
-    context.threads = 1;   // Threads
-    context.t_cost = 2;    // Iterations
-
-    return argon2_ctx(&context, Argon2_d);
-}
+template <>
+struct Argon2dPhaseParams<1> {
+    static const uint32_t M_COST = 1000; // Memory in KiB (1000 KiB)
+    static const uint32_t LANES = 8;     // Degree of Parallelism
+    static const uint32_t T_COST = 2;    // Iterations
+};
 
 /// Argon2d Phase 2 Hash parameters
-/// Salt and password are the block header.
-/// Output length: 32 bytes.
-/// Input length (in the case of a block header): 80 bytes.
-/// Salt length (same note as input length): 80 bytes.
-/// Input: Block header
-/// Salt: Block header (SAME AS INPUT)
-/// Secret data: None
-/// Secret length: 0
-/// Associated data: None
-/// Associated data length: 0
 /// Memory cost: 8192 kibibytes
 /// Lanes: 64 parallel threads
-/// Threads: 1 threads
 /// Time Constraint: 16 iterations
-inline int Argon2d_Phase2_Hash(const void* in, const size_t size, const void* out)
+template <>
+struct Argon2dPhaseParams<2> {
+    static const uint32_t M_COST = 8192; // Memory in KiB (8 MiB)
+    static const uint32_t LANES = 64;    // Degree of Parallelism
+    static const uint32_t T_COST = 16;   // Iterations
+};
+
+static const unsigned int ARGON2D_PHASE_COUNT = 3;
+
+/** Set up an Argon2d context with the parameters of the given phase fixed at compile time */
+template <unsigned int Phase>
+inline void Argon2d_Phase_Context(argon2_context& context, const void* in, const size_t size, const void* out)
 {
-    argon2_context context;
     context.out = (uint8_t*)out;
     context.outlen = (uint32_t)OUTPUT_BYTES;
     context.pwd = (uint8_t*)in;
@@ -423,41 +380,85 @@ inline int Argon2d_Phase2_Hash(const void* in, const size_t size, const void* ou
     context.secretlen = 0;
     context.ad = NULL;
     context.adlen = 0;
-    context.allocate_cbk = NULL;
-    context.free_cbk = NULL;
+    context.allocate_cbk = Argon2dArenaAllocate; // reuse the thread's scratch memory
+    context.free_cbk = Argon2dArenaFree;
     context.flags = DEFAULT_ARGON2_FLAG; // = ARGON2_DEFAULT_FLAGS
     // main configurable Argon2 hash parameters
-    context.m_cost = 8192; // Memory in KiB (8 MiB)
-    context.lanes = 64;    // Degree of Parallelism
-    context.threads = 1;   // Threads
-    context.t_cost = 16;    // Iterations
+    context.m_cost = Argon2dPhaseParams<Phase>::M_COST;
+    context.lanes = Argon2dPhaseParams<Phase>::LANES;
+    context.threads = 1;
+    context.t_cost = Argon2dPhaseParams<Phase>::T_COST;
+}
 
+/** Argon2d hash with the parameters of the given phase fixed at compile time */
+template <unsigned int Phase>
+inline int Argon2d_Phase_Hash(const void* in, const size_t size, const void* out)
+{
+    argon2_context context;
+    Argon2d_Phase_Context<Phase>(context, in, size, out);
     return argon2_ctx(&context, Argon2_d);
 }
 
-template <typename T1>
-inline uint256 hash_Argon2d(const T1 pbegin, const T1 pend, const unsigned int& hashPhase)
+/**
+ * Hash count inputs of equal size with the parameters of the given phase,
+ * interleaving their memory fills (see argon2d_ctx_multi)
+ */
+template <unsigned int Phase>
+inline int Argon2d_Phase_Hash_Multi(const void* const* in, const size_t size, void* const* out, const uint32_t count)
+{
+    argon2_context contexts[ARGON2_MAX_INTERLEAVE];
+    if (count == 0 || count > ARGON2_MAX_INTERLEAVE)
+        return ARGON2_INCORRECT_PARAMETER;
+    for (uint32_t i = 0; i < count; i++)
+        Argon2d_Phase_Context<Phase>(contexts[i], in[i], size, out[i]);
+    return argon2d_ctx_multi(contexts, count);
+}
+
+inline int Argon2d_Phase0_Hash(const void* in, const size_t size, const void* out)
+{
+    return Argon2d_Phase_Hash<0>(in, size, out);
+}
+
+inline int Argon2d_Phase1_Hash(const void* in, const size_t size, const void* out)
+{
+    return Argon2d_Phase_Hash<1>(in, size, out);
+}
+
+inline int Argon2d_Phase2_Hash(const void* in, const size_t size, const void* out)
+{
+    return Argon2d_Phase_Hash<2>(in, size, out);
+}
+
+/** Hash [pbegin, pend) with the Argon2d parameters of a phase known at compile time */
+template <unsigned int Phase, typename T1>
+inline uint256 hash_Argon2d(const T1 pbegin, const T1 pend)
 {
     static unsigned char pblank[1];
     const void* input = (pbegin == pend ? pblank : static_cast<const void*>(&pbegin[0]));
     const size_t size = (pend - pbegin) * sizeof(pbegin[0]);
 
     uint256 hashResult;
-    const uint32_t MaxInt32 = std::numeric_limits<uint32_t>::max();
-    if (INPUT_BYTES > MaxInt32 || OUTPUT_BYTES > MaxInt32) {
-        return hashResult;
-    }
-
-    if (hashPhase == 0) {
-        Argon2d_Phase0_Hash((const uint8_t*)input, size, (uint8_t*)&hashResult);
-    } else if (hashPhase == 1) {
-        Argon2d_Phase1_Hash((const uint8_t*)input, size, (uint8_t*)&hashResult);
-    } else if (hashPhase == 2) {
-        Argon2d_Phase2_Hash((const uint8_t*)input, size, (uint8_t*)&hashResult);
-    } else {
-        Argon2d_Phase0_Hash((const uint8_t*)input, size, (uint8_t*)&hashResult);
-    }
+    Argon2d_Phase_Hash<Phase>((const uint8_t*)input, size, (uint8_t*)&hashResult);
     return hashResult;
 }
 
-#endif // CASH_HASH_H
\ No newline at end of file
+template <typename T1>
+inline uint256 hash_Argon2d(const T1 pbegin, const T1 pend, const unsigned int& hashPhase)
+{
+    if (hashPhase == 1)
+        return hash_Argon2d<1>(pbegin, pend);
+    else if (hashPhase == 2)
+        return hash_Argon2d<2>(pbegin, pend);
+    return hash_Argon2d<0>(pbegin, pend);
+}
+
+/**
+ * Set the block times at which proof of work moves to Argon2d phase 1 and 2.
+ * Called by SelectParams; until then the main network switch times are used.
+ */
+void SetArgon2dSwitchTimes(uint64_t nFirstSwitchTime, uint64_t nSecondSwitchTime);
+
+/** The Argon2d phase for a block with the given time. Lock-free and safe to call from any thread. */
+unsigned int GetArgon2dPhase(uint64_t nTime);
+
+#endif // CASH_HASH_H
@@ -24,7 +24,10 @@
 #include "bdap/domainentrydb.h"
 #include "bdap/linkingdb.h"
 #include "bdap/linkmanager.h"
+#include "bdap/vgpmessage.h"
+#include "bdap/vgpmessagestore.h"
 #include "dht/ed25519.h"
+#include "dht/mutabledb.h"
 #include "masternode-payments.h"
 #include "masternode-sync.h"
 #include "masternodeconfig.h"
@@ -53,6 +56,8 @@
 #endif // ENABLE_WALLET
 #include "compat/sanity.h"
 #include "consensus/validation.h"
+#include "crypto/argon2d_arena.h"
+#include "crypto/argon2d_dispatch.h"
 #include "privatesend-server.h"
 #include "psnotificationinterface.h"
 #include "rpc/register.h"
@@ -110,6 +115,7 @@ static const bool DEFAULT_PROXYRANDOMIZE = true;
 static const bool DEFAULT_REST_ENABLE = false;
 static const bool DEFAULT_DISABLE_SAFEMODE = false;
 static const bool DEFAULT_STOPAFTERBLOCKIMPORT = false;
+static const bool DEFAULT_ARGON2_HUGEPAGES = false;
 
 std::unique_ptr<CConnman> g_connman;
 std::unique_ptr<PeerLogicValidation> peerLogic;
@@ -378,6 +384,7 @@ void PrepareShutdown()
         //delete pMutableDataDB;
         //pMutableDataDB = NULL;
     }
+    StopVGPMessageSpill();
 #ifdef ENABLE_WALLET
     if (pwalletMain)
         pwalletMain->Flush(true);
@@ -494,6 +501,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-version", _("Print version and exit"));
     strUsage += HelpMessageOpt("-alerts", strprintf(_("Receive and display P2P network alerts (default: %u)"), DEFAULT_ALERTS));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)"));
+    strUsage += HelpMessageOpt("-argon2hugepages", strprintf(_("Back the per-thread Argon2d hashing memory with huge pages where the OS supports it (default: %u)"), DEFAULT_ARGON2_HUGEPAGES));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
     if (showDebug)
         strUsage += HelpMessageOpt("-blocksonly", strprintf(_("Whether to operate in a blocks only mode (default: %u)"), DEFAULT_BLOCKSONLY));
@@ -508,6 +516,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
     strUsage += HelpMessageOpt("-feefilter", strprintf(_("Tell other nodes to filter invs to us by our mempool min fee (default: %u)"), DEFAULT_FEEFILTER));
+    strUsage += HelpMessageOpt("-headerverifythreads=<n>", strprintf(_("Set the number of threads hashing received block headers for proof-of-work verification (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
+                                               -GetNumCores(), MAX_HEADERVERIFY_THREADS, DEFAULT_HEADERVERIFY_THREADS));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file on startup"));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
     strUsage += HelpMessageOpt("-maxmempool=<n>", strprintf(_("Keep the transaction memory pool below <n> megabytes (default: %u)"), DEFAULT_MAX_MEMPOOL_SIZE));
@@ -531,6 +541,14 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-addressindex", strprintf(_("Maintain a full address index, used to query for the balance, txids and unspent outputs for addresses (default: %u)"), DEFAULT_ADDRESSINDEX));
     strUsage += HelpMessageOpt("-timestampindex", strprintf(_("Maintain a timestamp index for block hashes, used to query blocks hashes by a range of timestamps (default: %u)"), DEFAULT_TIMESTAMPINDEX));
     strUsage += HelpMessageOpt("-spentindex", strprintf(_("Maintain a full spent index, used to query the spending txid and input index for an outpoint (default: %u)"), DEFAULT_SPENTINDEX));
+    strUsage += HelpMessageOpt("-bdapentrycache=<n>", strprintf(_("Memory in megabytes of decoded BDAP entries kept for lookups (default: %u)"), DEFAULT_BDAP_ENTRY_CACHE));
+    strUsage += HelpMessageOpt("-dhtmutablecache=<n>", strprintf(_("Memory in megabytes of DHT mutable items a masternode keeps in front of its DHT database (default: %u)"), DEFAULT_DHT_MUTABLE_CACHE));
+    strUsage += HelpMessageOpt("-vgpmessagethreads=<n>", strprintf(_("Set the number of threads checking the proof of work of received VGP messages (0 to %d, 0 = check them on the message handler thread, default: %d)"),
+                                               MAX_VGP_MESSAGE_CHECK_THREADS, DEFAULT_VGP_MESSAGE_CHECK_THREADS));
+    strUsage += HelpMessageOpt("-vgpmessagepeerrate=<n>", strprintf(_("Failed VGP messages per second a peer may send on average before its messages are dropped (default: %d)"), DEFAULT_VGP_MESSAGE_PEER_RATE));
+    strUsage += HelpMessageOpt("-vgpmessagepeerburst=<n>", strprintf(_("Failed VGP messages a peer may send at once (default: %d)"), DEFAULT_VGP_MESSAGE_PEER_BURST));
+    strUsage += HelpMessageOpt("-vgpmessagelogsize=<n>", strprintf(_("Remember at most <n> received VGP messages for duplicate detection (default: %u)"), DEFAULT_VGP_MESSAGE_LOG_SIZE));
+    strUsage += HelpMessageOpt("-vgpmessagespill", strprintf(_("Move my kept last VGP messages to disk once they are older than %d seconds (default: %u)"), KEEP_MY_MESSAGE_ALIVE_SECONDS, DEFAULT_VGP_MESSAGE_SPILL));
 
     strUsage += HelpMessageGroup(_("Connection options:"));
     strUsage += HelpMessageOpt("-addnode=<ip>", _("Add a node to connect to and attempt to keep the connection open"));
@@ -684,6 +702,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageGroup(_("Block creation options:"));
     strUsage += HelpMessageOpt("-blockmaxsize=<n>", strprintf(_("Set maximum block size in bytes (default: %d)"), DEFAULT_BLOCK_MAX_SIZE));
     strUsage += HelpMessageOpt("-blockprioritysize=<n>", strprintf(_("Set maximum size of high-priority/low-fee transactions in bytes (default: %d)"), DEFAULT_BLOCK_PRIORITY_SIZE));
+    strUsage += HelpMessageOpt("-cpuminerinterleave=<n>", strprintf(_("Set the number of nonces each CPU miner thread hashes at once, interleaving their Argon2d memory fills (1 to %d, default: %u)"), ARGON2_MAX_INTERLEAVE, DEFAULT_CPU_MINER_INTERLEAVE));
+    strUsage += HelpMessageOpt("-minerthreadaffinity", strprintf(_("Pin each CPU miner thread to its own logical processor, keeping its Argon2d memory on that processor's NUMA node. Threads beyond one per processor are not pinned. Combine with -argon2hugepages for huge page backed memory (default: %u)"), DEFAULT_MINER_THREAD_AFFINITY));
     strUsage += HelpMessageOpt("-blockmintxfee=<amt>", strprintf(_("Set lowest fee rate (in %s/kB) for transactions to be included in block creation. (default: %s)"), CURRENCY_UNIT, FormatMoney(DEFAULT_BLOCK_MIN_TX_FEE)));
     if (showDebug)
         strUsage += HelpMessageOpt("-blockversion=<n>", "Override block version to test forking scenarios");
@@ -1234,6 +1254,8 @@ bool AppInitParameterInteraction()
         incrementalRelayFee = CFeeRate(n);
     }
 
+    Argon2dArenaSetHugePages(GetBoolArg("-argon2hugepages", DEFAULT_ARGON2_HUGEPAGES));
+
     // -par=0 means autodetect, but nScriptCheckThreads==0 means no concurrency
     nScriptCheckThreads = GetArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
     if (nScriptCheckThreads <= 0)
@@ -1243,6 +1265,21 @@ bool AppInitParameterInteraction()
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    // -headerverifythreads=0 means autodetect, but nHeaderVerifyThreads==0 means no concurrency
+    nHeaderVerifyThreads = GetArg("-headerverifythreads", DEFAULT_HEADERVERIFY_THREADS);
+    if (nHeaderVerifyThreads <= 0)
+        nHeaderVerifyThreads += GetNumCores();
+    if (nHeaderVerifyThreads <= 1)
+        nHeaderVerifyThreads = 0;
+    else if (nHeaderVerifyThreads > MAX_HEADERVERIFY_THREADS)
+        nHeaderVerifyThreads = MAX_HEADERVERIFY_THREADS;
+
+    nVGPMessageCheckThreads = std::max(0, std::min((int)GetArg("-vgpmessagethreads", DEFAULT_VGP_MESSAGE_CHECK_THREADS), MAX_VGP_MESSAGE_CHECK_THREADS));
+    nVGPMessagePeerRate = std::max(0, (int)GetArg("-vgpmessagepeerrate", DEFAULT_VGP_MESSAGE_PEER_RATE));
+    nVGPMessagePeerBurst = std::max(1, (int)GetArg("-vgpmessagepeerburst", DEFAULT_VGP_MESSAGE_PEER_BURST));
+    SetVGPMessageLogSize(std::max((int64_t)0, GetArg("-vgpmessagelogsize", DEFAULT_VGP_MESSAGE_LOG_SIZE)));
+    SetMutableDataCacheSize(std::max((int64_t)0, GetArg("-dhtmutablecache", DEFAULT_DHT_MUTABLE_CACHE)) << 20);
+
     // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
     int64_t nPruneArg = GetArg("-prune", 0);
     if (nPruneArg < 0) {
@@ -1403,6 +1440,8 @@ bool AppInitSanityChecks()
 {
     // ********************************************************* Step 4: sanity checks
     RandomInit();
+    std::string argon2d_algo = Argon2dAutoDetect();
+    LogPrintf("Using the '%s' Argon2d implementation\n", argon2d_algo);
     // Initialize elliptic curve code
     ECC_Start();
     ECC_Start_Stealth();
@@ -1455,10 +1494,24 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
-        for (int i = 0; i < nScriptCheckThreads - 1; i++)
+        for (int i = 0; i < nScriptCheckThreads - 1; i++) {
             threadGroup.create_thread(&ThreadScriptCheck);
+            threadGroup.create_thread(&ThreadBDAPCheck);
+        }
+    }
+
+    LogPrintf("Using %u threads for header proof-of-work verification\n", nHeaderVerifyThreads);
+    if (nHeaderVerifyThreads) {
+        for (int i = 0; i < nHeaderVerifyThreads - 1; i++)
+            threadGroup.create_thread(&ThreadHeaderVerify);
     }
 
+    LogPrintf("Using %u threads for VGP message proof-of-work verification\n", nVGPMessageCheckThreads);
+    for (int i = 0; i < nVGPMessageCheckThreads; i++)
+        threadGroup.create_thread(&ThreadVGPMessageCheck);
+    if (GetBoolArg("-vgpmessagespill", DEFAULT_VGP_MESSAGE_SPILL) && !StartVGPMessageSpill(GetDataDir() / "vgpmessages"))
+        return InitError(_("Error opening VGP message spill database"));
+
     std::vector<std::string> vSporkAddresses;
     if (mapMultiArgs.count("-sporkaddr")) {
         vSporkAddresses = mapMultiArgs.at("-sporkaddr");
@@ -1755,13 +1808,27 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
                 pFluidSovereignDB = new CFluidSovereignDB(nTotalCache * 35, false, fReindex, obfuscate);
                 pBanAccountDB = new CBanAccountDB(nTotalCache * 35, false, fReindex, obfuscate);
                 // Init BDAP Services DBs
-                pDomainEntryDB = new CDomainEntryDB(nTotalCache * 35, false, fReindex, obfuscate);
-                pAuditDB = new CAuditDB(nTotalCache * 35, false, fReindex, obfuscate);
-                pCertificateDB = new CCertificateDB(nTotalCache * 35, false, fReindex, obfuscate);
-                pLinkDB = new CLinkDB(nTotalCache * 35, false, fReindex, obfuscate);
+                // The BDAP databases are rebuilt with the chainstate, their undo records do not reach back to genesis
+                pDomainEntryDB = new CDomainEntryDB(nTotalCache * 35, false, fReindex || fReindexChainState, obfuscate, GetArg("-bdapentrycache", DEFAULT_BDAP_ENTRY_CACHE) << 20);
+                pAuditDB = new CAuditDB(nTotalCache * 35, false, fReindex || fReindexChainState, obfuscate);
+                pCertificateDB = new CCertificateDB(nTotalCache * 35, false, fReindex || fReindexChainState, obfuscate);
+                pLinkDB = new CLinkDB(nTotalCache * 35, false, fReindex || fReindexChainState, obfuscate);
                 pLinkManager = new CLinkManager();
                 // Init DHT Services DB
                 //pMutableDataDB = new CMutableDataDB(nTotalCache * 35, false, fReindex, obfuscate);
+                // Index BDAP entries written before the directory index existed
+                if (!pDomainEntryDB->UpgradeDirectoryIndex()) {
+                    strLoadError = _("Error upgrading BDAP entry database");
+                    break;
+                }
+                if (!pAuditDB->UpgradeAuditIndex()) {
+                    strLoadError = _("Error upgrading BDAP audit database");
+                    break;
+                }
+                if (!pCertificateDB->UpgradeCertificateIndex()) {
+                    strLoadError = _("Error upgrading BDAP certificate database");
+                    break;
+                }
 
                 if (fReindex) {
                     pblocktree->WriteReindexing(true);
@@ -1824,6 +1891,11 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
                     }
                 }
 
+                if (!SyncBDAPDatabases()) {
+                    strLoadError = _("Error syncing the BDAP databases with the active chain. You need to rebuild the database using -reindex");
+                    break;
+                }
+
                 if (!CVerifyDB().VerifyDB(chainparams, pcoinsdbview, GetArg("-checklevel", DEFAULT_CHECKLEVEL),
                         GetArg("-checkblocks", DEFAULT_CHECKBLOCKS))) {
                     strLoadError = _("Corrupted block database detected");
@@ -1,27 +1,104 @@
-
 // Copyright (c) 2019-2021 Duality Blockchain Solutions Developers
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "miner/impl/miner-cpu.h"
+#include "crypto/common.h"
+#include "miner/miner-util.h"
 #include "primitives/block.h"
+#include "util.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+
 
+std::atomic<unsigned int> CPUMiner::_miners(0);
 
 CPUMiner::CPUMiner(MinerContextRef ctx, std::size_t device_index)
-    : MinerBase(ctx, device_index){};
+    : MinerBase(ctx, device_index)
+{
+    int interleave = GetArg("-cpuminerinterleave", DEFAULT_CPU_MINER_INTERLEAVE);
+    _interleave = std::max(1, std::min(interleave, ARGON2_MAX_INTERLEAVE));
+    _pin = _miners++ < TotalDevices();
+}
+
+CPUMiner::~CPUMiner()
+{
+    _miners--;
+}
+
+unsigned int CPUMiner::TotalDevices()
+{
+    return std::max(GetNumAffinityProcessors(), 1);
+}
+
+void CPUMiner::InitThread()
+{
+    if (!GetBoolArg("-minerthreadaffinity", DEFAULT_MINER_THREAD_AFFINITY))
+        return;
+    if (!_pin) {
+        LogPrint("miner", "CashMiner -- not pinning %s#%d, there are more miner threads than processors\n", DeviceName(), device_index());
+        return;
+    }
+    // The Argon2d arena of this thread is mapped by its first hash, which
+    // happens after pinning, so first-touch places it on the core's NUMA node
+    if (SetThreadAffinity(device_index()))
+        LogPrint("miner", "CashMiner -- pinned %s#%d to its processor\n", DeviceName(), device_index());
+    else
+        LogPrintf("CashMiner -- could not pin %s#%d to a processor\n", DeviceName(), device_index());
+}
+
+template <unsigned int Phase>
+static int HashHeaders(const unsigned char (*headers)[INPUT_BYTES], uint256* hashes, uint32_t count)
+{
+    const void* in[ARGON2_MAX_INTERLEAVE];
+    void* out[ARGON2_MAX_INTERLEAVE];
+    for (uint32_t i = 0; i < count; i++) {
+        in[i] = headers[i];
+        out[i] = hashes[i].begin();
+    }
+    return Argon2d_Phase_Hash_Multi<Phase>(in, INPUT_BYTES, out, count);
+}
+
+int CPUMiner::ScanNonces(unsigned int phase)
+{
+    if (phase == 1)
+        return HashHeaders<1>(_headers, _hashes, _interleave);
+    else if (phase == 2)
+        return HashHeaders<2>(_headers, _hashes, _interleave);
+    else
+        return HashHeaders<0>(_headers, _hashes, _interleave);
+}
 
 int64_t CPUMiner::TryMineBlock(CBlock& block)
 {
+    // Work on the serialized header, only the trailing nonce changes per hash
+    assert(END(block.nNonce) - BEGIN(block.nVersion) == (ptrdiff_t)INPUT_BYTES);
+    for (uint32_t i = 0; i < _interleave; i++)
+        memcpy(_headers[i], BEGIN(block.nVersion), INPUT_BYTES);
+    const unsigned int phase = GetArgon2dPhase(block.nTime);
+
     int64_t hashes_done = 0;
     while (true) {
-        uint256 hash = block.GetHash();
-        if (UintToArith256(hash) <= _hash_target) {
-            this->ProcessFoundSolution(block, hash);
+        for (uint32_t i = 0; i < _interleave; i++)
+            WriteLE32(&_headers[i][INPUT_BYTES - 4], block.nNonce + i);
+        // _hashes holds nothing of these nonces if hashing failed
+        int status = ScanNonces(phase);
+        if (status != ARGON2_OK) {
+            LogPrintf("CashMiner -- %s#%d failed to hash nonces: %s\n", DeviceName(), device_index(), argon2_error_message(status));
             break;
         }
-        block.nNonce += 1;
-        hashes_done += 1;
-        if ((block.nNonce & 0xFF) == 0)
+        hashes_done += _interleave;
+        for (uint32_t i = 0; i < _interleave; i++) {
+            if (UintToArith256(_hashes[i]) <= _hash_target) {
+                block.nNonce += i;
+                this->ProcessFoundSolution(block, _hashes[i]);
+                return hashes_done;
+            }
+        }
+        block.nNonce += _interleave;
+        if ((block.nNonce & 0xFF) < _interleave)
             break;
     }
     return hashes_done;
@@ -5,7 +5,11 @@
 #ifndef CASH_MINER_IMPL_CPU_H
 #define CASH_MINER_IMPL_CPU_H
 
+#include "hash.h"
 #include "miner/internal/miner-base.h"
+#include "uint256.h"
+
+#include <atomic>
 
 
 /**
@@ -15,22 +19,35 @@ class CPUMiner final : public MinerBase
 {
 public:
     CPUMiner(MinerContextRef ctx, std::size_t device_index);
-    virtual ~CPUMiner() = default;
-
-    static unsigned int TotalDevices()
-    {
-        // Currently it's one until I'll solve
-        // physical CPU vs CPU core count vs vCPU count
-        // and get it fixed on Windows, OSx and Linux
-        // Until then we will just use OS scheduler
-        // (not a priority at all; here just for GPU)
-        return 1;
-    };
+    virtual ~CPUMiner();
+
+    // One device per logical processor the process may run on, miner
+    // threads are spread over them in order
+    static unsigned int TotalDevices();
 
     virtual const char* DeviceName() override { return "CPU"; };
 
 protected:
     virtual int64_t TryMineBlock(CBlock& block) override;
+
+    // Pins the thread to its processor, see -minerthreadaffinity
+    virtual void InitThread() override;
+
+private:
+    // Hashes _interleave headers that only differ in their nonce, returns the Argon2 status
+    int ScanNonces(unsigned int phase);
+
+    // Number of nonces hashed at once, see -cpuminerinterleave
+    uint32_t _interleave;
+
+    // Miner threads beyond one per processor are not pinned, they would
+    // share a processor with a pinned thread
+    static std::atomic<unsigned int> _miners;
+    bool _pin;
+
+    // Serialized headers and their hashes, one per interleaved nonce
+    unsigned char _headers[ARGON2_MAX_INTERLEAVE][INPUT_BYTES];
+    uint256 _hashes[ARGON2_MAX_INTERLEAVE];
 };
 
 #endif // CASH_MINER_IMPL_CPU_H
@@ -35,6 +35,7 @@ void MinerBase::Loop()
     LogPrintf("CashMiner -- started on %s#%d\n", DeviceName(), _device_index);
     SetThreadPriority(THREAD_PRIORITY_LOWEST);
     RenameThread(tfm::format("Cash-%s-miner-%d", DeviceName(), _device_index).data());
+    InitThread();
 
     CBlock block;
     CBlockIndex* chain_tip = nullptr;
@@ -38,6 +38,12 @@ protected:
     // tries to mine a block
     virtual int64_t TryMineBlock(CBlock& block) = 0;
 
+    // Prepares the miner thread, called once from the thread before mining
+    virtual void InitThread(){};
+
+    // Returns miner device index
+    std::size_t device_index() const { return _device_index; }
+
     // Solution must be lower or equal to
     arith_uint256 _hash_target = 0;
 
@@ -5,6 +5,7 @@
 #include "miner/internal/miner-context.h"
 #include "miner/miner-util.h"
 #include "txmempool.h"
+#include "utiltime.h"
 #include "validation.h"
 
 MinerContext::MinerContext(const CChainParams& chainparams_, CConnman& connman_)
@@ -23,8 +24,14 @@ void MinerSharedContext::RecreateBlock()
     // pass if nothing changed
     if (_chain_tip == chainActive.Tip() && _last_txn == txn_time)
         return;
+    std::unique_ptr<CBlockTemplate> block_template;
+    // Only the mempool changed, add its new transactions to the current template
+    if (_chain_tip == chainActive.Tip() && _block_template)
+        block_template = UpdateBlockTemplate(chainparams, *_block_template);
+    if (!block_template)
+        block_template = CreateNewBlock(chainparams);
     _chain_tip = chainActive.Tip();
-    _block_time = GetTime();
-    _block_template = CreateNewBlock(chainparams);
+    _block_time = GetTimeMicros();
+    _block_template = std::move(block_template);
     _last_txn = txn_time;
 }
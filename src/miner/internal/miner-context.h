@@ -61,7 +61,7 @@ protected:
 private:
     // current block chain tip
     std::atomic<CBlockIndex*> _chain_tip{nullptr};
-    // atomic flag incremented on recreated block
+    // time in microseconds the block template was last recreated
     std::atomic<int64_t> _block_time{0};
     // last transaction update time
     std::atomic<uint32_t> _last_txn{0};
@@ -100,7 +100,9 @@ void MinerSignals::NotifyTransaction(const CTransaction& txn, const CBlockIndex*
     // check if blockchain has synced, has more than 1 peer and is enabled before recreating blocks
     if (IsInitialBlockDownload() || !_ctr->can_start())
         return;
-    if (GetTime() - _ctr->_ctx->shared->last_txn() > 60) {
-        _ctr->_ctx->shared->RecreateBlock();
-    }
+    // transactions confirmed in a block are picked up by NotifyBlock
+    if (index != nullptr)
+        return;
+    // extends the current block template with the new transaction
+    _ctr->_ctx->shared->RecreateBlock();
 };
@@ -8,6 +8,8 @@
 #include "miner/internal/miner-context.h"
 #include "miner/internal/thread-group.h"
 
+#include <vector>
+
 
 /**
  * Miners group threads controller.
@@ -43,6 +45,15 @@ public:
 
     // Gets hash rate of all threads in the group
     int64_t GetHashRate() const { return *this->_ctx->counter; };
+
+    // Gets hash rate of each thread in the group
+    std::vector<int64_t> GetThreadHashRates() const
+    {
+        std::vector<int64_t> rates;
+        for (const MinerContextRef& ctx : this->thread_contexts())
+            rates.push_back(*ctx->counter);
+        return rates;
+    };
 };
 
 
@@ -46,6 +46,13 @@ public:
     // Size of a thread group
     uint8_t size() const { return _target_threads; }
 
+    // Contexts of the running threads, in start order
+    std::vector<Context> thread_contexts() const
+    {
+        boost::shared_lock<boost::shared_mutex> guard(_mutex);
+        return _thread_contexts;
+    };
+
 protected:
     Context _ctx;
 
@@ -57,6 +64,7 @@ private:
     size_t _devices;
     uint8_t _target_threads = 0;
     std::vector<std::shared_ptr<boost::thread> > _threads;
+    std::vector<Context> _thread_contexts;
     mutable boost::shared_mutex _mutex;
 };
 
@@ -71,13 +79,16 @@ void ThreadGroup<T, Context>::SyncGroupTarget()
     size_t current;
     while ((current = _threads.size()) != _target_threads) {
         if (current < _target_threads) {
-            auto miner = std::shared_ptr<T>(new T(_ctx->MakeChild(), current % _devices));
+            Context ctx = _ctx->MakeChild();
+            auto miner = std::shared_ptr<T>(new T(ctx, current % _devices));
             _threads.push_back(std::make_shared<boost::thread>([miner] {
                 (*miner)();
             }));
+            _thread_contexts.push_back(ctx);
         } else {
             std::shared_ptr<boost::thread> thread = _threads.back();
             _threads.pop_back();
+            _thread_contexts.pop_back();
             thread->interrupt();
         }
     }
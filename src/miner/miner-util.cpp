@@ -24,8 +24,13 @@
 #include "validation.h"
 #include "wallet/wallet.h"
 
+#include <algorithm>
 #include <queue>
 
+#include <boost/multi_index/identity.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index_container.hpp>
+
 bool ProcessBlockFound(const CBlock& block, const CChainParams& chainparams)
 {
     LogPrintf("%s\n", block.ToString());
@@ -67,286 +72,682 @@ int64_t UpdateTime(CBlockHeader& block, const Consensus::Params& cparams, const
     return new_time - old_time;
 }
 
-class ScoreCompare
+namespace
 {
-public:
-    ScoreCompare() {}
+// Ancestor state of a mempool entry with the ancestors that are already in
+// the block being assembled taken out.
+struct CTxMemPoolModifiedEntry {
+    explicit CTxMemPoolModifiedEntry(CTxMemPool::txiter entry)
+        : iter(entry),
+          nSizeWithAncestors(entry->GetSizeWithAncestors()),
+          nModFeesWithAncestors(entry->GetModFeesWithAncestors()),
+          nSigOpCountWithAncestors(entry->GetSigOpCountWithAncestors())
+    {
+    }
 
-    bool operator()(const CTxMemPool::txiter a, const CTxMemPool::txiter b)
+    CTxMemPool::txiter iter;
+    uint64_t nSizeWithAncestors;
+    CAmount nModFeesWithAncestors;
+    unsigned int nSigOpCountWithAncestors;
+};
+
+struct CompareCTxMemPoolIter {
+    bool operator()(const CTxMemPool::txiter& a, const CTxMemPool::txiter& b) const
     {
-        return CompareTxMemPoolEntryByScore()(*b, *a); // Convert to less than
+        return &(*a) < &(*b);
     }
 };
 
-// Unconfirmed transactions in the memory pool often depend on other
-// transactions in the memory pool. When we select transactions from the
-// pool, we select by highest priority or fee rate, so we might consider
-// transactions that depend on transactions that aren't yet in the block.
-uint64_t nLastBlockTx = 0;
-uint64_t nLastBlockSize = 0;
+struct modifiedentry_iter {
+    typedef CTxMemPool::txiter result_type;
+    result_type operator()(const CTxMemPoolModifiedEntry& entry) const
+    {
+        return entry.iter;
+    }
+};
 
-std::unique_ptr<CBlockTemplate> CreateNewBlock(const CChainParams& chainparams, const CScript* scriptPubKeyIn)
+// Same ordering as CompareTxMemPoolEntryByAncestorFee, on the modified ancestor state
+struct CompareModifiedEntry {
+    bool operator()(const CTxMemPoolModifiedEntry& a, const CTxMemPoolModifiedEntry& b) const
+    {
+        double f1 = (double)a.nModFeesWithAncestors * b.nSizeWithAncestors;
+        double f2 = (double)b.nModFeesWithAncestors * a.nSizeWithAncestors;
+        if (f1 == f2) {
+            return CTxMemPool::CompareIteratorByHash()(a.iter, b.iter);
+        }
+        return f1 > f2;
+    }
+};
+
+// Parents have fewer in-mempool ancestors than their children
+struct CompareTxIterByAncestorCount {
+    bool operator()(const CTxMemPool::txiter& a, const CTxMemPool::txiter& b) const
+    {
+        if (a->GetCountWithAncestors() != b->GetCountWithAncestors())
+            return a->GetCountWithAncestors() < b->GetCountWithAncestors();
+        return CTxMemPool::CompareIteratorByHash()(a, b);
+    }
+};
+
+typedef boost::multi_index_container<
+    CTxMemPoolModifiedEntry,
+    boost::multi_index::indexed_by<
+        boost::multi_index::ordered_unique<
+            modifiedentry_iter,
+            CompareCTxMemPoolIter>,
+        // sorted by modified ancestor fee rate
+        boost::multi_index::ordered_non_unique<
+            boost::multi_index::tag<ancestor_score>,
+            boost::multi_index::identity<CTxMemPoolModifiedEntry>,
+            CompareModifiedEntry> > >
+    indexed_modified_transaction_set;
+
+typedef indexed_modified_transaction_set::nth_index<0>::type::iterator modtxiter;
+typedef indexed_modified_transaction_set::index<ancestor_score>::type::iterator modtxscoreiter;
+
+struct update_for_parent_inclusion {
+    explicit update_for_parent_inclusion(CTxMemPool::txiter it) : iter(it) {}
+
+    void operator()(CTxMemPoolModifiedEntry& e)
+    {
+        e.nModFeesWithAncestors -= iter->GetModifiedFee();
+        e.nSizeWithAncestors -= iter->GetTxSize();
+        e.nSigOpCountWithAncestors -= iter->GetSigOpCount();
+    }
+
+    CTxMemPool::txiter iter;
+};
+
+/**
+ * Fills a block template from the mempool. A configurable amount of space
+ * goes to the highest coin-age priority transactions, the rest is filled
+ * with whole ancestor packages in order of package fee rate, so a high fee
+ * child pays for its low fee parents.
+ */
+class BlockAssembler
 {
-    // Create new block
-    std::unique_ptr<CBlockTemplate> pblocktemplate(new CBlockTemplate());
-    CBlock& block = pblocktemplate->block; // pointer for convenience
+private:
+    const CChainParams& chainparams;
 
-    // Create coinbase tx with fluid issuance
-    // TODO: Can this be made any more elegant?
-    CMutableTransaction txNew;
-    txNew.vin.resize(1);
-    txNew.vin[0].prevout.SetNull();
-    txNew.vout.resize(1);
+    std::unique_ptr<CBlockTemplate> pblocktemplate;
+    CBlock* pblock;
+
+    // Configuration parameters for the block size
+    unsigned int nBlockMaxSize;
+    unsigned int nBlockPrioritySize;
+
+    // Information on the current status of the block
+    uint64_t nBlockSize;
+    uint64_t nBlockTx;
+    unsigned int nBlockSigOps;
+    CAmount nFees;
+    CTxMemPool::setEntries inBlock;
+
+    // Chain context for the block
+    int nHeight;
+    int64_t nLockTimeCutoff;
+
+    // Variables used for addPriorityTxs
+    int lastFewTxs;
+    bool blockFinished;
 
+    bool fPrintPriority;
+
+public:
+    explicit BlockAssembler(const CChainParams& chainparams);
+
+    std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn);
+    std::unique_ptr<CBlockTemplate> UpdateBlock(const CBlockTemplate& blocktemplate);
+
+private:
+    /** Clear the block's state and prepare for assembling a new block on indexPrev */
+    void resetBlock(const CBlockIndex* indexPrev);
+    /** Add a tx to the block */
+    void AddToBlock(CTxMemPool::txiter iter);
+
+    /** Add transactions based on coin-age priority */
+    void addPriorityTxs();
+    /** Add transactions based on modified ancestor fee rate */
+    void addPackageTxs();
+
+    /** Build the coinbase and header and check the result is a valid block */
+    void FinishBlock(const CScript& scriptPubKeyIn, CBlockIndex* indexPrev);
+
+    /** Test if tx will still "fit" in the block */
+    bool TestForBlock(CTxMemPool::txiter iter);
+    /** Test if tx still has unconfirmed parents not yet in block */
+    bool isStillDependent(CTxMemPool::txiter iter);
+
+    /** Remove confirmed (inBlock) entries from given set */
+    void onlyUnconfirmed(CTxMemPool::setEntries& testSet);
+    /** Test if a new package would "fit" in the block */
+    bool TestPackage(uint64_t packageSize, unsigned int packageSigOps);
+    /** Test if all transactions of a package are final */
+    bool TestPackageFinality(const CTxMemPool::setEntries& package);
+    /** Skip entries of mapTx that are in the block, already in mapModifiedTx or failed */
+    bool SkipMapTxEntry(CTxMemPool::txiter it, indexed_modified_transaction_set& mapModifiedTx, CTxMemPool::setEntries& failedTx);
+    /** Sort the package in an order that is valid to appear in a block */
+    void SortForBlock(const CTxMemPool::setEntries& package, std::vector<CTxMemPool::txiter>& sortedEntries);
+    /** Take the newly added transactions out of the ancestor state of their descendants */
+    void UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set& mapModifiedTx);
+};
+
+BlockAssembler::BlockAssembler(const CChainParams& _chainparams)
+    : chainparams(_chainparams)
+{
     // Largest block you're willing to create:
-    unsigned int nBlockMaxSize = GetArg("-blockmaxsize", DEFAULT_BLOCK_MAX_SIZE);
+    nBlockMaxSize = GetArg("-blockmaxsize", DEFAULT_BLOCK_MAX_SIZE);
     // Limit to between 1K and MAX_BLOCK_SIZE-1K for sanity:
     nBlockMaxSize = std::max((unsigned int)1000, std::min((unsigned int)(MAX_BLOCK_SIZE - 1000), nBlockMaxSize));
 
     // How much of the block should be dedicated to high-priority transactions,
     // included regardless of the fees they pay
-    unsigned int nBlockPrioritySize = GetArg("-blockprioritysize", DEFAULT_BLOCK_PRIORITY_SIZE);
+    nBlockPrioritySize = GetArg("-blockprioritysize", DEFAULT_BLOCK_PRIORITY_SIZE);
     nBlockPrioritySize = std::min(nBlockMaxSize, nBlockPrioritySize);
 
-    // Minimum block size you want to create; block will be filled with free transactions
-    // until there are no more or the block reaches this size:
-    unsigned int nBlockMinSize = GetArg("-blockminsize", DEFAULT_BLOCK_MIN_SIZE);
-    nBlockMinSize = std::min(nBlockMaxSize, nBlockMinSize);
+    fPrintPriority = GetBoolArg("-printpriority", DEFAULT_PRINTPRIORITY);
+}
 
-    // Collect memory pool transactions into the block
-    CTxMemPool::setEntries inBlock;
-    CTxMemPool::setEntries waitSet;
+void BlockAssembler::resetBlock(const CBlockIndex* indexPrev)
+{
+    inBlock.clear();
 
-    // This vector will be sorted into a priority queue:
-    std::vector<TxCoinAgePriority> vecPriority;
-    TxCoinAgePriorityCompare pricomparer;
-    std::map<CTxMemPool::txiter, double, CTxMemPool::CompareIteratorByHash> waitPriMap;
-    typedef std::map<CTxMemPool::txiter, double, CTxMemPool::CompareIteratorByHash>::iterator waitPriIter;
-    double actualPriority = -1;
+    // Reserve space for coinbase tx
+    nBlockSize = 1000;
+    nBlockSigOps = 100;
 
-    std::priority_queue<CTxMemPool::txiter, std::vector<CTxMemPool::txiter>, ScoreCompare> clearedTxs;
-    bool fPrintPriority = GetBoolArg("-printpriority", DEFAULT_PRINTPRIORITY);
-    uint64_t nBlockSize = 1000;
-    uint64_t nBlockTx = 0;
-    unsigned int nBlockSigOps = 100;
-    int lastFewTxs = 0;
-    CAmount nFees = 0;
+    // These counters do not include coinbase tx
+    nBlockTx = 0;
+    nFees = 0;
 
-    {
-        LOCK2(cs_main, governance.cs);
-        LOCK(mempool.cs);
-        CBlockIndex* indexPrev = chainActive.Tip();
-        const int nHeight = indexPrev->nHeight + 1;
-        block.nTime = GetAdjustedTime();
-        const int64_t nMedianTimePast = indexPrev->GetMedianTimePast();
-
-        // Add our coinbase tx as first transaction
-        block.vtx.emplace_back();
-        pblocktemplate->vTxFees.push_back(-1);   // updated at end
-        pblocktemplate->vTxSigOps.push_back(-1); // updated at end
-        block.nVersion = ComputeBlockVersion(indexPrev, chainparams.GetConsensus());
-        // -regtest only: allow overriding block.nVersion with
-        // -blockversion=N to test forking scenarios
-        if (chainparams.MineBlocksOnDemand())
-            block.nVersion = GetArg("-blockversion", block.nVersion);
-
-        int64_t nLockTimeCutoff = (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST) ? nMedianTimePast : block.GetBlockTime();
-
-
-        bool fPriorityBlock = nBlockPrioritySize > 0;
-        if (fPriorityBlock) {
-            vecPriority.reserve(mempool.mapTx.size());
-            for (CTxMemPool::indexed_transaction_set::iterator mi = mempool.mapTx.begin(); mi != mempool.mapTx.end(); ++mi) {
-                double dPriority = mi->GetPriority(nHeight);
-                CAmount dummy;
-                mempool.ApplyDeltas(mi->GetTx().GetHash(), dPriority, dummy);
-                vecPriority.push_back(TxCoinAgePriority(dPriority, mi));
-            }
-            std::make_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+    lastFewTxs = 0;
+    blockFinished = false;
+
+    pblocktemplate.reset(new CBlockTemplate());
+    pblock = &pblocktemplate->block; // pointer for convenience
+
+    // Add dummy coinbase tx as first transaction
+    pblock->vtx.emplace_back();
+    pblocktemplate->vTxFees.push_back(-1);   // updated at end
+    pblocktemplate->vTxSigOps.push_back(-1); // updated at end
+
+    nHeight = indexPrev->nHeight + 1;
+    pblock->nTime = GetAdjustedTime();
+    pblock->nVersion = ComputeBlockVersion(indexPrev, chainparams.GetConsensus());
+    // -regtest only: allow overriding block.nVersion with
+    // -blockversion=N to test forking scenarios
+    if (chainparams.MineBlocksOnDemand())
+        pblock->nVersion = GetArg("-blockversion", pblock->nVersion);
+
+    const int64_t nMedianTimePast = indexPrev->GetMedianTimePast();
+    nLockTimeCutoff = (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST) ? nMedianTimePast : pblock->GetBlockTime();
+}
+
+std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn)
+{
+    LOCK2(cs_main, governance.cs);
+    LOCK(mempool.cs);
+    CBlockIndex* indexPrev = chainActive.Tip();
+    resetBlock(indexPrev);
+
+    addPriorityTxs();
+    addPackageTxs();
+
+    FinishBlock(scriptPubKeyIn, indexPrev);
+    return std::move(pblocktemplate);
+}
+
+std::unique_ptr<CBlockTemplate> BlockAssembler::UpdateBlock(const CBlockTemplate& blocktemplate)
+{
+    LOCK2(cs_main, governance.cs);
+    LOCK(mempool.cs);
+    CBlockIndex* indexPrev = chainActive.Tip();
+    if (blocktemplate.block.hashPrevBlock != indexPrev->GetBlockHash())
+        return nullptr;
+    resetBlock(indexPrev);
+
+    // Carry the template's transactions over in their order. They are still
+    // valid on this tip as long as the mempool still has every one of them.
+    for (size_t i = 1; i < blocktemplate.block.vtx.size(); i++) {
+        CTxMemPool::txiter iter = mempool.mapTx.find(blocktemplate.block.vtx[i]->GetHash());
+        if (iter == mempool.mapTx.end())
+            return nullptr;
+        AddToBlock(iter);
+    }
+
+    const uint64_t nBlockTxPrev = nBlockTx;
+    addPackageTxs();
+    if (nBlockTx == nBlockTxPrev) {
+        // Nothing new made it in, the template stands as it is
+        return std::unique_ptr<CBlockTemplate>(new CBlockTemplate(blocktemplate));
+    }
+
+    FinishBlock(blocktemplate.block.vtx[0]->vout[0].scriptPubKey, indexPrev);
+    return std::move(pblocktemplate);
+}
+
+void BlockAssembler::FinishBlock(const CScript& scriptPubKeyIn, CBlockIndex* indexPrev)
+{
+    // Create coinbase tx with fluid issuance
+    // TODO: Can this be made any more elegant?
+    CMutableTransaction txNew;
+    txNew.vin.resize(1);
+    txNew.vin[0].prevout.SetNull();
+    txNew.vout.resize(1);
+
+    CAmount blockReward;
+    if (chainActive.Height() > Params().GetConsensus().nFeeRewardStart) {
+        blockReward = nFees + GetFluidMiningReward(nHeight);
+    } else if (chainActive.Height() <= Params().GetConsensus().nFeeRewardStart) {
+        blockReward = GetFluidMiningReward(nHeight);
+    }
+
+    CDebitAddress mintAddress;
+    CAmount fluidIssuance = 0;
+    CFluidMint fluidMint;
+    bool areWeMinting = GetMintingInstructions(nHeight, fluidMint);
+
+    // Compute regular coinbase transaction.
+    // HACK: move outside for split-miner
+    txNew.vout[0].scriptPubKey = scriptPubKeyIn;
+    txNew.vin[0].scriptSig = CScript() << nHeight << OP_0;
+
+    if (areWeMinting) {
+        mintAddress = fluidMint.GetDestinationAddress();
+        fluidIssuance = fluidMint.MintAmount;
+        txNew.vout[0].nValue = blockReward + fluidIssuance;
+    } else {
+        txNew.vout[0].nValue = blockReward;
+    }
+
+    CScript script;
+    if (areWeMinting) {
+        // Pick out the amount of issuance
+        txNew.vout[0].nValue -= fluidIssuance;
+
+        assert(mintAddress.IsValid());
+        if (!mintAddress.IsScript()) {
+            script = GetScriptForDestination(mintAddress.Get());
+        } else {
+            CScriptID fluidScriptID = boost::get<CScriptID>(mintAddress.Get());
+            script = CScript() << OP_HASH160 << ToByteVector(fluidScriptID) << OP_EQUAL;
         }
+        txNew.vout.push_back(CTxOut(fluidIssuance, script));
+        LogPrintf("CreateNewBlock(): Generated Fluid Issuance Transaction:\n%s\n", txNew.ToString());
+    }
 
-        CTxMemPool::indexed_transaction_set::index<mining_score>::type::iterator mi = mempool.mapTx.get<mining_score>().begin();
-        CTxMemPool::txiter iter;
-
-        while (mi != mempool.mapTx.get<mining_score>().end() || !clearedTxs.empty()) {
-            bool priorityTx = false;
-            if (fPriorityBlock && !vecPriority.empty()) { // add a tx from priority queue to fill the blockprioritysize
-                priorityTx = true;
-                iter = vecPriority.front().second;
-                actualPriority = vecPriority.front().first;
-                std::pop_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
-                vecPriority.pop_back();
-            } else if (clearedTxs.empty()) { // add tx with next highest score
-                iter = mempool.mapTx.project<0>(mi);
-                mi++;
-            } else { // try to add a previously postponed child tx
-                iter = clearedTxs.top();
-                clearedTxs.pop();
-            }
+    // Update coinbase transaction with additional info about masternode and governance payments,
+    // get some info back to pass to getblocktemplate
+    FillBlockPayments(txNew, nHeight, blockReward, pblocktemplate->txoutMasternode, pblocktemplate->voutSuperblock);
+    // LogPrintf("CreateNewBlock -- nBlockHeight %d blockReward %lld txoutMasternode %s txNew %s",
+    //             nHeight, blockReward, pblock->txoutMasternode.ToString(), txNew.ToString());
 
-            if (inBlock.count(iter))
-                continue; // could have been added to the priorityBlock
+    nLastBlockTx = nBlockTx;
+    nLastBlockSize = nBlockSize;
+    LogPrintf("CreateNewBlock(): total size %u txs: %u fees: %ld sigops %d\n", nBlockSize, nBlockTx, nFees, nBlockSigOps);
 
-            const CTransaction& tx = iter->GetTx();
+    CAmount blockAmount = blockReward + fluidIssuance;
+    LogPrintf("CreateNewBlock(): Computed Miner Block Reward is %ld 0DYNC\n", FormatMoney(blockAmount));
 
-            bool fOrphan = false;
-            BOOST_FOREACH (CTxMemPool::txiter parent, mempool.GetMemPoolParents(iter)) {
-                if (!inBlock.count(parent)) {
-                    fOrphan = true;
-                    break;
-                }
-            }
-            if (fOrphan) {
-                if (priorityTx)
-                    waitPriMap.insert(std::make_pair(iter, actualPriority));
-                else
-                    waitSet.insert(iter);
+    // Update block coinbase
+    pblock->vtx[0] = MakeTransactionRef(std::move(txNew));
+    pblocktemplate->vTxFees[0] = -nFees;
+
+    // Fill in header
+    pblock->hashPrevBlock = indexPrev->GetBlockHash();
+    UpdateTime(*pblock, chainparams.GetConsensus(), indexPrev);
+    pblock->nBits = GetNextWorkRequired(indexPrev, *pblock, chainparams.GetConsensus());
+    pblock->nNonce = 0;
+    pblocktemplate->vTxSigOps[0] = GetLegacySigOpCount(*pblock->vtx[0]);
+
+    CValidationState state;
+    if (!TestBlockValidity(state, chainparams, *pblock, indexPrev, false, false)) {
+        LogPrintf("CreateNewBlock(): Generated Transaction:\n%s\n", pblock->vtx[0]->ToString());
+        throw std::runtime_error(tfm::format("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
+    }
+}
+
+bool BlockAssembler::isStillDependent(CTxMemPool::txiter iter)
+{
+    BOOST_FOREACH (CTxMemPool::txiter parent, mempool.GetMemPoolParents(iter)) {
+        if (!inBlock.count(parent)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void BlockAssembler::onlyUnconfirmed(CTxMemPool::setEntries& testSet)
+{
+    for (CTxMemPool::setEntries::iterator iit = testSet.begin(); iit != testSet.end();) {
+        // Only test txs not already in the block
+        if (inBlock.count(*iit)) {
+            testSet.erase(iit++);
+        } else {
+            iit++;
+        }
+    }
+}
+
+bool BlockAssembler::TestPackage(uint64_t packageSize, unsigned int packageSigOps)
+{
+    if (nBlockSize + packageSize >= nBlockMaxSize)
+        return false;
+    if (nBlockSigOps + packageSigOps >= MAX_BLOCK_SIGOPS)
+        return false;
+    return true;
+}
+
+bool BlockAssembler::TestPackageFinality(const CTxMemPool::setEntries& package)
+{
+    BOOST_FOREACH (const CTxMemPool::txiter it, package) {
+        if (!IsFinalTx(it->GetTx(), nHeight, nLockTimeCutoff))
+            return false;
+    }
+    return true;
+}
+
+bool BlockAssembler::TestForBlock(CTxMemPool::txiter iter)
+{
+    if (nBlockSize + iter->GetTxSize() >= nBlockMaxSize) {
+        // If the block is so close to full that no more txs will fit
+        // or if we've tried more than 50 times to fill remaining space
+        // then flag that the block is finished
+        if (nBlockSize > nBlockMaxSize - 100 || lastFewTxs > 50) {
+            blockFinished = true;
+            return false;
+        }
+        // Once we're within 1000 bytes of a full block, only look at 50 more txs
+        // to try to fill the remaining space.
+        if (nBlockSize > nBlockMaxSize - 1000) {
+            lastFewTxs++;
+        }
+        return false;
+    }
+
+    if (nBlockSigOps + iter->GetSigOpCount() >= MAX_BLOCK_SIGOPS) {
+        // If the block has room for no more sig ops then
+        // flag that the block is finished
+        if (nBlockSigOps > MAX_BLOCK_SIGOPS - 2) {
+            blockFinished = true;
+            return false;
+        }
+        // Otherwise attempt to find another tx with fewer sigops
+        // to put in the block.
+        return false;
+    }
+
+    // Must check that lock times are still valid
+    if (!IsFinalTx(iter->GetTx(), nHeight, nLockTimeCutoff))
+        return false;
+
+    return true;
+}
+
+void BlockAssembler::AddToBlock(CTxMemPool::txiter iter)
+{
+    pblock->vtx.emplace_back(iter->GetSharedTx());
+    pblocktemplate->vTxFees.push_back(iter->GetFee());
+    pblocktemplate->vTxSigOps.push_back(iter->GetSigOpCount());
+    nBlockSize += iter->GetTxSize();
+    ++nBlockTx;
+    nBlockSigOps += iter->GetSigOpCount();
+    nFees += iter->GetFee();
+    inBlock.insert(iter);
+
+    if (fPrintPriority) {
+        double dPriority = iter->GetPriority(nHeight);
+        CAmount dummy;
+        mempool.ApplyDeltas(iter->GetTx().GetHash(), dPriority, dummy);
+        LogPrintf("priority %.1f fee %s txid %s\n", dPriority, CFeeRate(iter->GetModifiedFee(), iter->GetTxSize()).ToString(),
+            iter->GetTx().GetHash().ToString());
+    }
+}
+
+void BlockAssembler::UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set& mapModifiedTx)
+{
+    BOOST_FOREACH (const CTxMemPool::txiter it, alreadyAdded) {
+        CTxMemPool::setEntries descendants;
+        mempool.CalculateDescendants(it, descendants);
+        // Insert all descendants (not yet in block) into the modified set
+        BOOST_FOREACH (CTxMemPool::txiter desc, descendants) {
+            if (alreadyAdded.count(desc))
                 continue;
+            modtxiter mit = mapModifiedTx.find(desc);
+            if (mit == mapModifiedTx.end()) {
+                CTxMemPoolModifiedEntry modEntry(desc);
+                modEntry.nSizeWithAncestors -= it->GetTxSize();
+                modEntry.nModFeesWithAncestors -= it->GetModifiedFee();
+                modEntry.nSigOpCountWithAncestors -= it->GetSigOpCount();
+                mapModifiedTx.insert(modEntry);
+            } else {
+                mapModifiedTx.modify(mit, update_for_parent_inclusion(it));
             }
+        }
+    }
+}
 
-            unsigned int nTxSize = iter->GetTxSize();
-            if (fPriorityBlock && (nBlockSize + nTxSize >= nBlockPrioritySize || !AllowFree(actualPriority))) {
-                fPriorityBlock = false;
-                waitPriMap.clear();
-            }
-            if (!priorityTx && (iter->GetModifiedFee() < ::minRelayTxFee.GetFee(nTxSize) && nBlockSize >= nBlockMinSize)) {
-                break;
-            }
-            if (nBlockSize + nTxSize >= nBlockMaxSize) {
-                if (nBlockSize > nBlockMaxSize - 100 || lastFewTxs > 50) {
-                    break;
-                }
-                // Once we're within 1000 bytes of a full block, only look at 50 more txs
-                // to try to fill the remaining space.
-                if (nBlockSize > nBlockMaxSize - 1000) {
-                    lastFewTxs++;
-                }
-                continue;
+bool BlockAssembler::SkipMapTxEntry(CTxMemPool::txiter it, indexed_modified_transaction_set& mapModifiedTx, CTxMemPool::setEntries& failedTx)
+{
+    assert(it != mempool.mapTx.end());
+    // An entry in mapModifiedTx means the mapTx ancestor state is stale
+    return mapModifiedTx.count(it) || inBlock.count(it) || failedTx.count(it);
+}
+
+void BlockAssembler::SortForBlock(const CTxMemPool::setEntries& package, std::vector<CTxMemPool::txiter>& sortedEntries)
+{
+    // Sort package by ancestor count
+    // If a transaction A depends on transaction B, then A's ancestor count
+    // must be greater than B's.  So this is sufficient to validly order the
+    // transactions for block inclusion.
+    sortedEntries.clear();
+    sortedEntries.insert(sortedEntries.begin(), package.begin(), package.end());
+    std::sort(sortedEntries.begin(), sortedEntries.end(), CompareTxIterByAncestorCount());
+}
+
+void BlockAssembler::addPackageTxs()
+{
+    // mapModifiedTx will store sorted packages after they are modified
+    // because some of their txs are already in the block
+    indexed_modified_transaction_set mapModifiedTx;
+    // Keep track of entries that failed inclusion, to avoid duplicate work
+    CTxMemPool::setEntries failedTx;
+
+    // Start by adding all descendants of previously added txs to mapModifiedTx
+    // and modifying them for their already included ancestors
+    UpdatePackagesForAdded(inBlock, mapModifiedTx);
+
+    CTxMemPool::indexed_transaction_set::index<ancestor_score>::type::iterator mi = mempool.mapTx.get<ancestor_score>().begin();
+    CTxMemPool::txiter iter;
+
+    // Limit the number of attempts to add transactions to the block when it is
+    // close to full; this is just a simple heuristic to finish quickly if the
+    // mempool has a lot of entries.
+    const int64_t MAX_CONSECUTIVE_FAILURES = 1000;
+    int64_t nConsecutiveFailed = 0;
+
+    while (mi != mempool.mapTx.get<ancestor_score>().end() || !mapModifiedTx.empty()) {
+        // First try to find a new transaction in mapTx to evaluate.
+        if (mi != mempool.mapTx.get<ancestor_score>().end() &&
+            SkipMapTxEntry(mempool.mapTx.project<0>(mi), mapModifiedTx, failedTx)) {
+            ++mi;
+            continue;
+        }
+
+        // Now that mi is not stale, determine which transaction to evaluate:
+        // the next entry from mapTx, or the best from mapModifiedTx?
+        bool fUsingModified = false;
+
+        modtxscoreiter modit = mapModifiedTx.get<ancestor_score>().begin();
+        if (mi == mempool.mapTx.get<ancestor_score>().end()) {
+            // We're out of entries in mapTx; use the entry from mapModifiedTx
+            iter = modit->iter;
+            fUsingModified = true;
+        } else {
+            // Try to compare the mapTx entry to the mapModifiedTx entry
+            iter = mempool.mapTx.project<0>(mi);
+            if (modit != mapModifiedTx.get<ancestor_score>().end() &&
+                CompareModifiedEntry()(*modit, CTxMemPoolModifiedEntry(iter))) {
+                // The best entry in mapModifiedTx has higher score
+                // than the one from mapTx.
+                // Switch which transaction (package) to consider
+                iter = modit->iter;
+                fUsingModified = true;
+            } else {
+                // Either no entry in mapModifiedTx, or it's worse than mapTx.
+                // Increment mi for the next loop iteration.
+                ++mi;
             }
+        }
 
-            if (!IsFinalTx(tx, nHeight, nLockTimeCutoff))
-                continue;
+        // We skip mapTx entries that are inBlock, and mapModifiedTx shouldn't
+        // contain anything that is inBlock.
+        assert(!inBlock.count(iter));
+
+        uint64_t packageSize = iter->GetSizeWithAncestors();
+        CAmount packageFees = iter->GetModFeesWithAncestors();
+        unsigned int packageSigOps = iter->GetSigOpCountWithAncestors();
+        if (fUsingModified) {
+            packageSize = modit->nSizeWithAncestors;
+            packageFees = modit->nModFeesWithAncestors;
+            packageSigOps = modit->nSigOpCountWithAncestors;
+        }
 
-            unsigned int nTxSigOps = iter->GetSigOpCount();
-            if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS) {
-                if (nBlockSigOps > MAX_BLOCK_SIGOPS - 2) {
-                    break;
-                }
-                continue;
+        if (packageFees < ::minRelayTxFee.GetFee(packageSize)) {
+            // Everything else we might consider has a lower fee rate
+            return;
+        }
+
+        if (!TestPackage(packageSize, packageSigOps)) {
+            if (fUsingModified) {
+                // Since we always look at the best entry in mapModifiedTx,
+                // we must erase failed entries so that we can consider the
+                // next best entry on the next loop iteration
+                mapModifiedTx.get<ancestor_score>().erase(modit);
+                failedTx.insert(iter);
             }
 
-            block.vtx.emplace_back(iter->GetSharedTx());
-
-            pblocktemplate->vTxFees.push_back(iter->GetFee());
-            pblocktemplate->vTxSigOps.push_back(iter->GetSigOpCount());
-            nBlockSize += iter->GetTxSize();
-            ++nBlockTx;
-            nBlockSigOps += iter->GetSigOpCount();
-            nFees += iter->GetFee();
-
-            if (fPrintPriority) {
-                double dPriority = iter->GetPriority(nHeight);
-                CAmount dummy;
-                mempool.ApplyDeltas(tx.GetHash(), dPriority, dummy);
-                LogPrintf("priority %.1f fee %s txid %s\n", dPriority, CFeeRate(iter->GetModifiedFee(), nTxSize).ToString(),
-                    tx.GetHash().ToString());
+            ++nConsecutiveFailed;
+
+            if (nConsecutiveFailed > MAX_CONSECUTIVE_FAILURES && nBlockSize > nBlockMaxSize - 1000) {
+                // Give up if we're close to full and haven't succeeded in a while
+                break;
             }
+            continue;
+        }
 
-            inBlock.insert(iter);
+        CTxMemPool::setEntries ancestors;
+        uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+        std::string dummy;
+        mempool.CalculateMemPoolAncestors(*iter, ancestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
 
-            // Add transactions that depend on this one to the priority queue
-            BOOST_FOREACH (CTxMemPool::txiter child, mempool.GetMemPoolChildren(iter)) {
-                if (fPriorityBlock) {
-                    waitPriIter wpiter = waitPriMap.find(child);
-                    if (wpiter != waitPriMap.end()) {
-                        vecPriority.push_back(TxCoinAgePriority(wpiter->second, child));
-                        std::push_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
-                        waitPriMap.erase(wpiter);
-                    }
-                } else {
-                    if (waitSet.count(child)) {
-                        clearedTxs.push(child);
-                        waitSet.erase(child);
-                    }
-                }
+        onlyUnconfirmed(ancestors);
+        ancestors.insert(iter);
+
+        // Test if all tx's are final
+        if (!TestPackageFinality(ancestors)) {
+            if (fUsingModified) {
+                mapModifiedTx.get<ancestor_score>().erase(modit);
+                failedTx.insert(iter);
             }
+            continue;
         }
 
-        CAmount blockReward;
-        if (chainActive.Height() > Params().GetConsensus().nFeeRewardStart) {
-            blockReward = nFees + GetFluidMiningReward(nHeight);
-        } else if (chainActive.Height() <= Params().GetConsensus().nFeeRewardStart) {
-            blockReward = GetFluidMiningReward(nHeight);
+        // This transaction will make it in; reset the failed counter.
+        nConsecutiveFailed = 0;
+
+        // Package can be added. Sort the entries in a valid order.
+        std::vector<CTxMemPool::txiter> sortedEntries;
+        SortForBlock(ancestors, sortedEntries);
+
+        for (size_t i = 0; i < sortedEntries.size(); ++i) {
+            AddToBlock(sortedEntries[i]);
+            // Erase from the modified set, if present
+            mapModifiedTx.erase(sortedEntries[i]);
         }
 
-        CDebitAddress mintAddress;
-        CAmount fluidIssuance = 0;
-        CFluidMint fluidMint;
-        bool areWeMinting = GetMintingInstructions(nHeight, fluidMint);
+        // Update transactions that depend on each of these
+        UpdatePackagesForAdded(ancestors, mapModifiedTx);
+    }
+}
+
+void BlockAssembler::addPriorityTxs()
+{
+    if (nBlockPrioritySize == 0) {
+        return;
+    }
+
+    // This vector will be sorted into a priority queue:
+    std::vector<TxCoinAgePriority> vecPriority;
+    TxCoinAgePriorityCompare pricomparer;
+    std::map<CTxMemPool::txiter, double, CTxMemPool::CompareIteratorByHash> waitPriMap;
+    typedef std::map<CTxMemPool::txiter, double, CTxMemPool::CompareIteratorByHash>::iterator waitPriIter;
+    double actualPriority = -1;
 
-        // Compute regular coinbase transaction.
-        // HACK: move outside for split-miner
-        if (scriptPubKeyIn) {
-            txNew.vout[0].scriptPubKey = *scriptPubKeyIn;
+    vecPriority.reserve(mempool.mapTx.size());
+    for (CTxMemPool::indexed_transaction_set::iterator mi = mempool.mapTx.begin(); mi != mempool.mapTx.end(); ++mi) {
+        double dPriority = mi->GetPriority(nHeight);
+        CAmount dummy;
+        mempool.ApplyDeltas(mi->GetTx().GetHash(), dPriority, dummy);
+        vecPriority.push_back(TxCoinAgePriority(dPriority, mi));
+    }
+    std::make_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+
+    CTxMemPool::txiter iter;
+    while (!vecPriority.empty() && !blockFinished) { // add a tx from priority queue to fill the blockprioritysize
+        iter = vecPriority.front().second;
+        actualPriority = vecPriority.front().first;
+        std::pop_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+        vecPriority.pop_back();
+
+        // If tx already in block, skip
+        if (inBlock.count(iter)) {
+            assert(false); // shouldn't happen for priority txs
+            continue;
         }
-        txNew.vin[0].scriptSig = CScript() << nHeight << OP_0;
 
-        if (areWeMinting) {
-            mintAddress = fluidMint.GetDestinationAddress();
-            fluidIssuance = fluidMint.MintAmount;
-            txNew.vout[0].nValue = blockReward + fluidIssuance;
-        } else {
-            txNew.vout[0].nValue = blockReward;
+        // If tx is dependent on other mempool txs which haven't yet been included
+        // then put it in the waitSet
+        if (isStillDependent(iter)) {
+            waitPriMap.insert(std::make_pair(iter, actualPriority));
+            continue;
         }
 
-        CScript script;
-        if (areWeMinting) {
-            // Pick out the amount of issuance
-            txNew.vout[0].nValue -= fluidIssuance;
+        // If this tx fits in the block add it, otherwise keep looping
+        if (TestForBlock(iter)) {
+            AddToBlock(iter);
 
-            assert(mintAddress.IsValid());
-            if (!mintAddress.IsScript()) {
-                script = GetScriptForDestination(mintAddress.Get());
-            } else {
-                CScriptID fluidScriptID = boost::get<CScriptID>(mintAddress.Get());
-                script = CScript() << OP_HASH160 << ToByteVector(fluidScriptID) << OP_EQUAL;
+            // If now that this txs is added we've surpassed our desired priority size
+            // or have dropped below the AllowFree threshold, then we're done adding priority txs
+            if (nBlockSize >= nBlockPrioritySize || !AllowFree(actualPriority)) {
+                break;
             }
-            txNew.vout.push_back(CTxOut(fluidIssuance, script));
-            LogPrintf("CreateNewBlock(): Generated Fluid Issuance Transaction:\n%s\n", txNew.ToString());
-        }
 
-        // Update coinbase transaction with additional info about masternode and governance payments,
-        // get some info back to pass to getblocktemplate
-        FillBlockPayments(txNew, nHeight, blockReward, pblocktemplate->txoutMasternode, pblocktemplate->voutSuperblock);
-        // LogPrintf("CreateNewBlock -- nBlockHeight %d blockReward %lld txoutMasternode %s txNew %s",
-        //             nHeight, blockReward, block.txoutMasternode.ToString(), txNew.ToString());
-
-        nLastBlockTx = nBlockTx;
-        nLastBlockSize = nBlockSize;
-        LogPrintf("CreateNewBlock(): total size %u txs: %u fees: %ld sigops %d\n", nBlockSize, nBlockTx, nFees, nBlockSigOps);
-
-        CAmount blockAmount = blockReward + fluidIssuance;
-        LogPrintf("CreateNewBlock(): Computed Miner Block Reward is %ld 0DYNC\n", FormatMoney(blockAmount));
-
-        // Update block coinbase
-        block.vtx[0] = MakeTransactionRef(std::move(txNew));
-        pblocktemplate->vTxFees[0] = -nFees;
-
-        // Fill in header
-        block.hashPrevBlock = indexPrev->GetBlockHash();
-        UpdateTime(block, chainparams.GetConsensus(), indexPrev);
-        block.nBits = GetNextWorkRequired(indexPrev, block, chainparams.GetConsensus());
-        block.nNonce = 0;
-        pblocktemplate->vTxSigOps[0] = GetLegacySigOpCount(*block.vtx[0]);
-
-        CValidationState state;
-        if (!TestBlockValidity(state, chainparams, block, indexPrev, false, false)) {
-            LogPrintf("CreateNewBlock(): Generated Transaction:\n%s\n", txNew.ToString());
-            throw std::runtime_error(tfm::format("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
+            // This tx was successfully added, so
+            // add transactions that depend on this one to the priority queue to try again
+            BOOST_FOREACH (CTxMemPool::txiter child, mempool.GetMemPoolChildren(iter)) {
+                waitPriIter wpiter = waitPriMap.find(child);
+                if (wpiter != waitPriMap.end()) {
+                    vecPriority.push_back(TxCoinAgePriority(wpiter->second, child));
+                    std::push_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+                    waitPriMap.erase(wpiter);
+                }
+            }
         }
     }
+}
+} // namespace
+
+// Unconfirmed transactions in the memory pool often depend on other
+// transactions in the memory pool. When we select transactions from the
+// pool, we select whole packages of a transaction and its unconfirmed
+// ancestors, so a child can pay for a parent that isn't in the block yet.
+uint64_t nLastBlockTx = 0;
+uint64_t nLastBlockSize = 0;
 
-    return pblocktemplate;
+std::unique_ptr<CBlockTemplate> CreateNewBlock(const CChainParams& chainparams, const CScript* scriptPubKeyIn)
+{
+    return BlockAssembler(chainparams).CreateNewBlock(scriptPubKeyIn ? *scriptPubKeyIn : CScript());
 }
 
 std::unique_ptr<CBlockTemplate> CreateNewBlock(const CChainParams& chainparams, const CScript& scriptPubKeyIn)
@@ -354,6 +755,11 @@ std::unique_ptr<CBlockTemplate> CreateNewBlock(const CChainParams& chainparams,
     return CreateNewBlock(chainparams, &scriptPubKeyIn);
 }
 
+std::unique_ptr<CBlockTemplate> UpdateBlockTemplate(const CChainParams& chainparams, const CBlockTemplate& blocktemplate)
+{
+    return BlockAssembler(chainparams).UpdateBlock(blocktemplate);
+}
+
 void IncrementExtraNonce(CBlock& block, const CBlockIndex* indexPrev, unsigned int& nExtraNonce)
 {
     // Update nExtraNonce
@@ -29,6 +29,10 @@ struct Params;
 static const bool DEFAULT_GENERATE = false;
 static const uint8_t DEFAULT_GENERATE_THREADS_CPU = 0;
 static const uint8_t DEFAULT_GENERATE_THREADS_GPU = 0;
+/** Default number of nonces a CPU miner thread hashes at once */
+static const unsigned int DEFAULT_CPU_MINER_INTERLEAVE = 1;
+/** Default for pinning each CPU miner thread to its own core */
+static const bool DEFAULT_MINER_THREAD_AFFINITY = true;
 
 static const bool DEFAULT_PRINTPRIORITY = false;
 
@@ -45,6 +49,13 @@ void SetBlockPubkeyScript(CBlock& block, const CScript& scriptPubKeyIn);
 /** Generate a new block, without valid proof-of-work */
 std::unique_ptr<CBlockTemplate> CreateNewBlock(const CChainParams& chainparams, const CScript* scriptPubKeyIn = nullptr);
 std::unique_ptr<CBlockTemplate> CreateNewBlock(const CChainParams& chainparams, const CScript& scriptPubKeyIn);
+/**
+ * Extend a block template with the mempool transactions that arrived since it
+ * was created, keeping the transactions it already has. Returns nullptr when
+ * the template can't be extended (the chain tip moved or some of its
+ * transactions left the mempool) and a new block has to be created instead.
+ */
+std::unique_ptr<CBlockTemplate> UpdateBlockTemplate(const CChainParams& chainparams, const CBlockTemplate& blocktemplate);
 /** Called by a miner when new block was found. */
 bool ProcessBlockFound(const CBlock& block, const CChainParams& chainparams);
 
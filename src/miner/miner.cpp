@@ -62,6 +62,13 @@ int64_t GetCPUHashRate()
     return 0;
 };
 
+std::vector<int64_t> GetCPUThreadHashRates()
+{
+    if (gMiners)
+        return gMiners->group_cpu().GetThreadHashRates();
+    return std::vector<int64_t>();
+};
+
 int64_t GetGPUHashRate()
 {
 #ifdef ENABLE_GPU
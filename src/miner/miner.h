@@ -32,6 +32,8 @@ int64_t GetHashRate();
 int64_t GetCPUHashRate();
 /** Gets hash rate of GPU */
 int64_t GetGPUHashRate();
+/** Gets hash rate of each CPU miner thread */
+std::vector<int64_t> GetCPUThreadHashRates();
 
 /** Sets amount of CPU miner threads */
 void SetCPUMinerThreads(uint8_t target);
@@ -768,6 +768,8 @@ public:
     std::vector<CAddress> vAddrToSend;
     CRollingBloomFilter addrKnown;
     bool fGetAddr;
+    // Alerts and VGP messages are relayed from the message handler and the VGP check threads
+    CCriticalSection cs_setKnown;
     std::set<uint256> setKnown;
     int64_t nNextAddrSend;
     int64_t nNextLocalAddrSend;
@@ -901,6 +903,19 @@ public:
     }
 
 
+    // returns true if the hash wasn't already known
+    bool AddKnown(const uint256& hash)
+    {
+        LOCK(cs_setKnown);
+        return setKnown.insert(hash).second;
+    }
+
+    bool IsKnown(const uint256& hash)
+    {
+        LOCK(cs_setKnown);
+        return setKnown.count(hash) > 0;
+    }
+
     void AddInventoryKnown(const CInv& inv)
     {
         {
@@ -286,6 +286,7 @@ void InitializeNode(CNode* pnode, CConnman& connman)
 void FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTime)
 {
     fUpdateConnectionTime = false;
+    FinalizeVGPPeer(nodeid);
     LOCK(cs_main);
     CNodeState* state = State(nodeid);
 
@@ -1072,45 +1073,51 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 // it's available before trying to send.
                 if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
                     // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
-                        assert(!"cannot load block from disk");
-                    if (inv.type == MSG_BLOCK)
-                        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, block));
-                    else if (inv.type == MSG_FILTERED_BLOCK) {
-                        bool sendMerkleBlock = false;
-                        CMerkleBlock merkleBlock;
-                        {
-                            LOCK(pfrom->cs_filter);
-                            if (pfrom->pfilter) {
-                                sendMerkleBlock = true;
-                                merkleBlock = CMerkleBlock(block, *pfrom->pfilter);
+                    if (inv.type == MSG_BLOCK) {
+                        // Full blocks are relayed as stored, skipping deserialization and the Argon2d re-hash
+                        std::vector<uint8_t> vBlockData;
+                        if (!ReadRawBlockFromDisk(vBlockData, (*mi).second, Params().MessageStart()))
+                            assert(!"cannot load block from disk");
+                        connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, CFlatData(vBlockData)));
+                    } else {
+                        CBlock block;
+                        if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
+                            assert(!"cannot load block from disk");
+                        if (inv.type == MSG_FILTERED_BLOCK) {
+                            bool sendMerkleBlock = false;
+                            CMerkleBlock merkleBlock;
+                            {
+                                LOCK(pfrom->cs_filter);
+                                if (pfrom->pfilter) {
+                                    sendMerkleBlock = true;
+                                    merkleBlock = CMerkleBlock(block, *pfrom->pfilter);
+                                }
                             }
+                            if (sendMerkleBlock) {
+                                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MERKLEBLOCK, merkleBlock));
+                                // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
+                                // This avoids hurting performance by pointlessly requiring a round-trip
+                                // Note that there is currently no way for a node to request any single transactions we didn't send here -
+                                // they must either disconnect and retry or request the full block.
+                                // Thus, the protocol spec specified allows for us to provide duplicate txn here,
+                                // however we MUST always provide at least what the remote peer needs
+                                typedef std::pair<unsigned int, uint256> PairType;
+                                BOOST_FOREACH (PairType& pair, merkleBlock.vMatchedTxn)
+                                    connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::TX, *block.vtx[pair.first]));
+                            }
+                            // else
+                            // no response
+                        } else if (inv.type == MSG_CMPCT_BLOCK) {
+                            // If a peer is asking for old blocks, we're almost guaranteed
+                            // they won't have a useful mempool to match against a compact block,
+                            // and we don't feel like constructing the object for them, so
+                            // instead we respond with the full, non-compact block.
+                            if (CanDirectFetch(consensusParams) && mi->second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
+                                CBlockHeaderAndShortTxIDs cmpctblock(block);
+                                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::CMPCTBLOCK, cmpctblock));
+                            } else
+                                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, block));
                         }
-                        if (sendMerkleBlock) {
-                            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MERKLEBLOCK, merkleBlock));
-                            // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
-                            // This avoids hurting performance by pointlessly requiring a round-trip
-                            // Note that there is currently no way for a node to request any single transactions we didn't send here -
-                            // they must either disconnect and retry or request the full block.
-                            // Thus, the protocol spec specified allows for us to provide duplicate txn here,
-                            // however we MUST always provide at least what the remote peer needs
-                            typedef std::pair<unsigned int, uint256> PairType;
-                            BOOST_FOREACH (PairType& pair, merkleBlock.vMatchedTxn)
-                                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::TX, *block.vtx[pair.first]));
-                        }
-                        // else
-                        // no response
-                    } else if (inv.type == MSG_CMPCT_BLOCK) {
-                        // If a peer is asking for old blocks, we're almost guaranteed
-                        // they won't have a useful mempool to match against a compact block,
-                        // and we don't feel like constructing the object for them, so
-                        // instead we respond with the full, non-compact block.
-                        if (CanDirectFetch(consensusParams) && mi->second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
-                            CBlockHeaderAndShortTxIDs cmpctblock(block);
-                            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::CMPCTBLOCK, cmpctblock));
-                        } else
-                            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, block));
                     }
 
                     // Trigger the peer node to send a getblocks request for the next batch of inventory
@@ -2383,6 +2390,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             return true;
         }
 
+        // Hash the whole batch on the header verification threads before taking
+        // cs_main; the linkage checks below then use the cached hashes.
+        PrecomputeHeaderHashes(headers);
+
         const CBlockIndex* pindexLast = NULL;
         {
             LOCK(cs_main);
@@ -2669,10 +2680,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         vRecv >> alert;
 
         uint256 alertHash = alert.GetHash();
-        if (pfrom->setKnown.count(alertHash) == 0) {
+        if (!pfrom->IsKnown(alertHash)) {
             if (alert.ProcessAlert(chainparams.AlertKey())) {
                 // Relay
-                pfrom->setKnown.insert(alertHash);
+                pfrom->AddKnown(alertHash);
                 {
                     connman.ForEachNode([&alert, &connman](CNode* pnode) {
                         alert.RelayTo(pnode, connman);
@@ -2693,58 +2704,57 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     else if (strCommand == NetMsgType::VGPMESSAGE) {
         CVGPMessage message;
         vRecv >> message;
-        CUnsignedVGPMessage unsignedMessage(message.vchMsg);
+        const CUnsignedVGPMessage& unsignedMessage = message.UnsignedMessage();
 
-        LogPrint("bdap", "%s -- VGP message received: size = %d, SubjectID = %s, MessageID = %s, HashID = %s \n",
-                        __func__, message.vchMsg.size(), unsignedMessage.SubjectID.ToString(), unsignedMessage.MessageID.ToString(), message.GetHash().ToString());
+        LogPrint("bdap", "%s -- VGP message received: size = %d, SubjectID = %s, MessageID = %s, MsgHash = %s \n",
+                        __func__, message.vchMsg.size(), unsignedMessage.SubjectID.ToString(), unsignedMessage.MessageID.ToString(), message.GetMsgHash().ToString());
 
+        // Admitted messages are checked for proof of work and relayed by the VGP message check threads
         std::string strErrorMessage = "";
-        int statusBan = message.ProcessMessage(strErrorMessage);
+        int statusBan = AdmitVGPMessage(message, pfrom->GetId(), strErrorMessage);
         if (strErrorMessage.size() > 0)
         {
-            LogPrint("bdap", "%s -- Error processing message. Hash %s,  MessageID %s, SubjectID %s, Error %s\n", __func__,
-                                message.GetHash().ToString(), unsignedMessage.MessageID.ToString(), unsignedMessage.SubjectID.ToString(), strErrorMessage);
+            LogPrint("bdap", "%s -- Error processing message. MsgHash %s,  MessageID %s, SubjectID %s, Error %s\n", __func__,
+                                message.GetMsgHash().ToString(), unsignedMessage.MessageID.ToString(), unsignedMessage.SubjectID.ToString(), strErrorMessage);
         }
-        if (statusBan == 0)
-        {
-            // Relay
-            pfrom->setKnown.insert(message.GetHash());
-            {
-                connman.ForEachNode([&message, &connman](CNode* pnode) {
-                    message.RelayTo(pnode, connman);
-                });
-            }
-        }
-        else if (statusBan > 0)
+        if (statusBan > 0)
         {
+            LOCK(cs_main);
             Misbehaving(pfrom->GetId(), statusBan);
         }
         else if (statusBan == -1)
         {
-            LogPrint("bdap", "%s -- Duplicate message recieved. Hash %s,  MessageID %s, SubjectID %s\n", __func__,
-                                message.GetHash().ToString(), unsignedMessage.MessageID.ToString(), unsignedMessage.SubjectID.ToString());
+            LogPrint("bdap", "%s -- Duplicate message recieved. MsgHash %s,  MessageID %s, SubjectID %s\n", __func__,
+                                message.GetMsgHash().ToString(), unsignedMessage.MessageID.ToString(), unsignedMessage.SubjectID.ToString());
         }
         else if (statusBan == -2)
         {
-            LogPrint("bdap", "%s -- Message either too old or timestamp is in the future. Hash %s,  MessageID %s, SubjectID %s\n", __func__,
-                                message.GetHash().ToString(), unsignedMessage.MessageID.ToString(), unsignedMessage.SubjectID.ToString());
+            LogPrint("bdap", "%s -- Message either too old or timestamp is in the future. MsgHash %s,  MessageID %s, SubjectID %s\n", __func__,
+                                message.GetMsgHash().ToString(), unsignedMessage.MessageID.ToString(), unsignedMessage.SubjectID.ToString());
         }
         else if (statusBan == -3)
         {
-            LogPrint("bdap", "%s -- Timestamp is greater than relay until time. Hash %s,  MessageID %s, SubjectID %s\n", __func__,
-                                message.GetHash().ToString(), unsignedMessage.MessageID.ToString(), unsignedMessage.SubjectID.ToString());
+            LogPrint("bdap", "%s -- Timestamp is greater than relay until time. MsgHash %s,  MessageID %s, SubjectID %s\n", __func__,
+                                message.GetMsgHash().ToString(), unsignedMessage.MessageID.ToString(), unsignedMessage.SubjectID.ToString());
+            LOCK(cs_main);
             Misbehaving(pfrom->GetId(), 10); // there is no reason to have a timestamp greater than the relay until time so ban node.
         }
         else if (statusBan == -4)
         {
-            LogPrint("bdap", "%s -- Relay time is too much.  max relay is 120 seconds. Hash %s,  MessageID %s, SubjectID %s\n", __func__,
-                                message.GetHash().ToString(), unsignedMessage.MessageID.ToString(), unsignedMessage.SubjectID.ToString());
+            LogPrint("bdap", "%s -- Relay time is too much.  max relay is 120 seconds. MsgHash %s,  MessageID %s, SubjectID %s\n", __func__,
+                                message.GetMsgHash().ToString(), unsignedMessage.MessageID.ToString(), unsignedMessage.SubjectID.ToString());
+            LOCK(cs_main);
             Misbehaving(pfrom->GetId(), 10); // there is no reason to have longer relay until time span so ban node.
         }
-        else
+        else if (statusBan == -5 || statusBan == -6)
+        {
+            LogPrint("bdap", "%s -- Message dropped. MsgHash %s,  MessageID %s, SubjectID %s\n", __func__,
+                                message.GetMsgHash().ToString(), unsignedMessage.MessageID.ToString(), unsignedMessage.SubjectID.ToString());
+        }
+        else if (statusBan != 0)
         {
-            LogPrintf("%s -- Unkown ProcessMessage status. Hash %s,  MessageID %s, SubjectID %s\n", __func__,
-                                message.GetHash().ToString(), unsignedMessage.MessageID.ToString(), unsignedMessage.SubjectID.ToString());
+            LogPrintf("%s -- Unkown ProcessMessage status. MsgHash %s,  MessageID %s, SubjectID %s\n", __func__,
+                                message.GetMsgHash().ToString(), unsignedMessage.MessageID.ToString(), unsignedMessage.SubjectID.ToString());
         }
     }
 
@@ -5,44 +5,90 @@
 
 #include "primitives/block.h"
 
-#include "chainparams.h"
-#include "chainparamsbase.h"
 #include "crypto/common.h"
 #include "hash.h"
 #include "tinyformat.h"
 #include "utilstrencodings.h"
 
+#include <assert.h>
+#include <cstring>
 #include <string>
 
-uint256 CBlockHeader::GetHash() const
+CBlockHeaderHashCache::CBlockHeaderHashCache(const CBlockHeaderHashCache& other)
+{
+    std::lock_guard<std::mutex> lock(other.mutex);
+    fValid = other.fValid;
+    nPhase = other.nPhase;
+    memcpy(vchHeader, other.vchHeader, HEADER_SIZE);
+    hash = other.hash;
+}
+
+CBlockHeaderHashCache& CBlockHeaderHashCache::operator=(const CBlockHeaderHashCache& other)
+{
+    if (this == &other)
+        return *this;
+    bool fValidOther;
+    unsigned int nPhaseOther;
+    unsigned char vchHeaderOther[HEADER_SIZE];
+    uint256 hashOther;
+    {
+        std::lock_guard<std::mutex> lock(other.mutex);
+        fValidOther = other.fValid;
+        nPhaseOther = other.nPhase;
+        memcpy(vchHeaderOther, other.vchHeader, HEADER_SIZE);
+        hashOther = other.hash;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    fValid = fValidOther;
+    nPhase = nPhaseOther;
+    memcpy(vchHeader, vchHeaderOther, HEADER_SIZE);
+    hash = hashOther;
+    return *this;
+}
+
+bool CBlockHeaderHashCache::Get(const unsigned char* pheader, unsigned int nPhaseIn, uint256& hashRet) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!fValid || nPhase != nPhaseIn || memcmp(vchHeader, pheader, HEADER_SIZE) != 0)
+        return false;
+    hashRet = hash;
+    return true;
+}
+
+void CBlockHeaderHashCache::Set(const unsigned char* pheader, unsigned int nPhaseIn, const uint256& hashIn)
 {
-    // UpdateCurrentBlockTime
-    CurrentBlockTime::UpdateCurrentBlockTime(nTime);
+    std::lock_guard<std::mutex> lock(mutex);
+    fValid = true;
+    nPhase = nPhaseIn;
+    memcpy(vchHeader, pheader, HEADER_SIZE);
+    hash = hashIn;
+}
 
-    // Get the current block time
-    uint64_t currentTime = nTime;
+void CBlockHeaderHashCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    fValid = false;
+}
 
+uint256 CBlockHeader::GetHash() const
+{
     // Determine Argon2d phase
-    int hashPhase = 0;
+    const unsigned int hashPhase = GetArgon2dPhase(nTime);
+
+    // Header fields are laid out contiguously, nVersion through nNonce
+    static_assert(sizeof(nVersion) + sizeof(hashPrevBlock) + sizeof(hashMerkleRoot) + sizeof(nTime) + sizeof(nBits) + sizeof(nNonce) == CBlockHeaderHashCache::HEADER_SIZE,
+        "unexpected block header size");
+    const unsigned char* pheader = (const unsigned char*)BEGIN(nVersion);
+    assert((const unsigned char*)END(nNonce) - pheader == (ptrdiff_t)CBlockHeaderHashCache::HEADER_SIZE);
 
-    #ifdef __APPLE__
-        // On macOS we use hardcoded timestamps
-        if (currentTime >= 1726660000 && currentTime < 4070908800) {
-            hashPhase = 1;
-        } else if (currentTime >= 4070908800) {
-            hashPhase = 2;
-        }
-    #else  // For other platforms (Linux/Windows, etc.)
-        // Default logic based on dynamic switch times
-        if (currentTime >= FirstSwitchTime() && currentTime < SecondSwitchTime()) {
-            hashPhase = 1;
-        } else if (currentTime >= SecondSwitchTime()) {
-            hashPhase = 2;
-        }
-    #endif
+    uint256 hash;
+    if (hashCache.Get(pheader, hashPhase, hash))
+        return hash;
 
-    // Return the hash using the determined Argon2d phase
-    return hash_Argon2d(BEGIN(nVersion), END(nNonce), hashPhase);
+    // Compute the hash using the determined Argon2d phase and remember it
+    hash = hash_Argon2d(BEGIN(nVersion), END(nNonce), hashPhase);
+    hashCache.Set(pheader, hashPhase, hash);
+    return hash;
 }
 
 std::string CBlock::ToString() const
@@ -60,14 +106,3 @@ std::string CBlock::ToString() const
     }
     return s.str();
 }
-
-namespace CurrentBlockTime
-{
-    std::atomic<uint64_t> currentBlockTime{0};
-    void UpdateCurrentBlockTime(uint64_t nTime) {
-        CurrentBlockTime::currentBlockTime.store(nTime, std::memory_order_relaxed);
-    }
-    uint64_t GetCurrentBlockTime() {
-        return currentBlockTime.load(std::memory_order_acquire);
-    }
-}
@@ -13,6 +13,39 @@
 #include "utilstrencodings.h"
 
 #include <atomic>
+#include <mutex>
+
+/** Memory-only cache for the Argon2d proof-of-work hash of a block header.
+ *
+ * The hash is stored together with the 80 serialized header bytes and the
+ * Argon2d phase it was computed for. Header fields are public and are written
+ * directly all over the code base (deserialization, the miners, tests), so
+ * instead of tracking writes the cache is validated against the current header
+ * bytes on every lookup: any change to nVersion, hashPrevBlock, hashMerkleRoot,
+ * nTime, nBits or nNonce makes it miss.
+ */
+class CBlockHeaderHashCache
+{
+public:
+    static const size_t HEADER_SIZE = 80;
+
+private:
+    mutable std::mutex mutex;
+    bool fValid;
+    unsigned int nPhase;
+    unsigned char vchHeader[HEADER_SIZE];
+    uint256 hash;
+
+public:
+    CBlockHeaderHashCache() : fValid(false), nPhase(0) {}
+    CBlockHeaderHashCache(const CBlockHeaderHashCache& other);
+    CBlockHeaderHashCache& operator=(const CBlockHeaderHashCache& other);
+
+    /** Return true and set hashRet if a hash for exactly these header bytes and phase is cached */
+    bool Get(const unsigned char* pheader, unsigned int nPhaseIn, uint256& hashRet) const;
+    void Set(const unsigned char* pheader, unsigned int nPhaseIn, const uint256& hashIn);
+    void Clear();
+};
 
 /** Nodes collect new transactions into a block, hash them into a hash tree,
  * and scan through nonce values to make the block's hash satisfy proof-of-work
@@ -32,6 +65,9 @@ public:
     uint32_t nBits;
     uint32_t nNonce;
 
+    // memory only
+    mutable CBlockHeaderHashCache hashCache;
+
     CBlockHeader()
     {
         SetNull();
@@ -58,6 +94,7 @@ public:
         nTime = 0;
         nBits = 0;
         nNonce = 0;
+        hashCache.Clear();
     }
 
     bool IsNull() const
@@ -65,6 +102,7 @@ public:
         return (nBits == 0);
     }
 
+    /** Argon2d proof-of-work hash, computed once and cached until a header field changes */
     uint256 GetHash() const;
 
     int64_t GetBlockTime() const
@@ -123,6 +161,7 @@ public:
         block.nTime = nTime;
         block.nBits = nBits;
         block.nNonce = nNonce;
+        block.hashCache = hashCache;
         return block;
     }
 
@@ -165,11 +204,4 @@ struct CBlockLocator {
     }
 };
 
-namespace CurrentBlockTime {
-    extern std::atomic<uint64_t> currentBlockTime;
-
-    void UpdateCurrentBlockTime(uint64_t nTime);
-    uint64_t GetCurrentBlockTime();
-}
-
 #endif // CASH_PRIMITIVES_BLOCK_H
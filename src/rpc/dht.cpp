@@ -1114,6 +1114,36 @@ UniValue dhtdb(const JSONRPCRequest& request)
     return result;
 }
 
+UniValue getdhtcacheinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getdhtcacheinfo\n"
+            "\nReturns the state of the in-memory DHT mutable item cache.\n"
+            "\nResult:\n"
+            "{(json object)\n"
+            "  \"items\"              (int)     Mutable items cached by info hash\n"
+            "  \"usage\"              (int)     Estimated memory usage of the cache in bytes\n"
+            "  \"hits\"               (int)     Lookups answered from the cache\n"
+            "  \"misses\"             (int)     Lookups that read the mutable data database\n"
+            "  }\n"
+            "\nExamples\n" +
+           HelpExampleCli("getdhtcacheinfo", "") +
+           "\nAs a JSON-RPC call\n" +
+           HelpExampleRpc("getdhtcacheinfo", ""));
+
+    size_t nItems, nUsage;
+    uint64_t nHits, nMisses;
+    GetMutableDataCacheInfo(nItems, nUsage, nHits, nMisses);
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("items", (uint64_t)nItems));
+    result.push_back(Pair("usage", (uint64_t)nUsage));
+    result.push_back(Pair("hits", nHits));
+    result.push_back(Pair("misses", nMisses));
+    return result;
+}
+
 UniValue dhtputmessages(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0)
@@ -1310,6 +1340,7 @@ static const CRPCCommand commands[] =
     { "dht",             "dht",                      &dht_rpc,                      true,    {"command", "param1", "param2", "param3"}  },
 #endif //ENABLE_WALLET
     { "dht",             "dhtdb",                    &dhtdb,                        true,    {} },
+    { "dht",             "getdhtcacheinfo",          &getdhtcacheinfo,              true,    {} },
     { "dht",             "dhtputmessages",           &dhtputmessages,               true,    {} },
     { "dht",             "dhtgetmessages",           &dhtgetmessages,               true,    {} },
 };
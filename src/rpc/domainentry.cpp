@@ -784,6 +784,39 @@ UniValue deletegroup(const JSONRPCRequest& request)
 }
 #endif // ENABLE_WALLET
 
+UniValue getbdapcacheinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getbdapcacheinfo\n"
+            "\nReturns the state of the in-memory BDAP entry cache.\n"
+            "\nResult:\n"
+            "{(json object)\n"
+            "  \"entries\"            (int)     Entries cached by object path and by DHT public key\n"
+            "  \"usage\"              (int)     Estimated memory usage of the cache in bytes\n"
+            "  \"hits\"               (int)     Lookups answered from the cache\n"
+            "  \"misses\"             (int)     Lookups that read the entry database\n"
+            "  }\n"
+            "\nExamples\n" +
+           HelpExampleCli("getbdapcacheinfo", "") +
+           "\nAs a JSON-RPC call\n" +
+           HelpExampleRpc("getbdapcacheinfo", ""));
+
+    if (!CheckDomainEntryDB())
+        throw JSONRPCError(RPC_DATABASE_ERROR, "BDAP entry database is not available");
+
+    size_t nEntries, nUsage;
+    uint64_t nHits, nMisses;
+    pDomainEntryDB->GetCacheInfo(nEntries, nUsage, nHits, nMisses);
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("entries", (uint64_t)nEntries));
+    result.push_back(Pair("usage", (uint64_t)nUsage));
+    result.push_back(Pair("hits", nHits));
+    result.push_back(Pair("misses", nMisses));
+    return result;
+}
+
 UniValue makekeypair(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() > 1)
@@ -1236,6 +1269,7 @@ static const CRPCCommand commands[] =
     { "bdap",            "bdapfees",                 &bdapfees,                     true, {} },
 #endif //ENABLE_WALLET
     { "bdap",            "makekeypair",              &makekeypair,                  true, {"prefix"} },
+    { "bdap",            "getbdapcacheinfo",         &getbdapcacheinfo,             true, {} },
 };
 
 void RegisterDomainEntryRPCCommands(CRPCTable &t)
@@ -1187,7 +1187,7 @@ static UniValue GetAccountMessages(const JSONRPCRequest& request)
         for (CVGPMessage& messageWrapper : vMessages)
         {
             UniValue oMessage(UniValue::VOBJ);
-            CUnsignedVGPMessage unsignedMessage(messageWrapper.vchMsg);
+            const CUnsignedVGPMessage& unsignedMessage = messageWrapper.UnsignedMessage();
             oMessage.push_back(Pair("sender_fqdn", stringFromVch(unsignedMessage.SenderFQDN())));
             oMessage.push_back(Pair("type", stringFromVch(unsignedMessage.Type())));
             oMessage.push_back(Pair("message", stringFromVch(unsignedMessage.Value())));
@@ -1250,7 +1250,7 @@ static UniValue GetMessages(const JSONRPCRequest& request)
         for (CVGPMessage& messageWrapper : vMessages)
         {
             UniValue oMessage(UniValue::VOBJ);
-            CUnsignedVGPMessage unsignedMessage(messageWrapper.vchMsg);
+            const CUnsignedVGPMessage& unsignedMessage = messageWrapper.UnsignedMessage();
             oMessage.push_back(Pair("sender_fqdn", stringFromVch(unsignedMessage.SenderFQDN())));
             oMessage.push_back(Pair("type", stringFromVch(unsignedMessage.Type())));
             oMessage.push_back(Pair("message", stringFromVch(unsignedMessage.Value())));
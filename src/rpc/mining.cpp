@@ -14,6 +14,7 @@
 #include "consensus/params.h"
 #include "consensus/validation.h"
 #include "core_io.h"
+#include "crypto/argon2d_dispatch.h"
 #include "fluid/fluid.h"
 #include "fluid/fluiddb.h"
 #include "fluid/fluidmint.h"
@@ -420,6 +421,8 @@ UniValue getmininginfo(const JSONRPCRequest& request)
             "  \"hashespersec\": n          (numeric) The recent hashes per second when generation is on (will return 0 if generation is off)\n"
             "  \"cpuhashespersec\": n       (numeric) The recent CPU hashes per second when generation is on (will return 0 if generation is off)\n"
             "  \"gpuhashespersec\": n       (numeric) The recent GPU hashes per second when generation is on (will return 0 if generation is off)\n"
+            "  \"cputhreadhashespersec\": [n,...] (array) The recent hashes per second of each CPU miner thread\n"
+            "  \"argon2d\": \"xxxx\",        (string) The instruction set of the Argon2d implementation used for CPU hashing\n"
             "}\n"
             "\nExamples:\n" +
             HelpExampleCli("getmininginfo", "") + HelpExampleRpc("getmininginfo", ""));
@@ -442,6 +445,11 @@ UniValue getmininginfo(const JSONRPCRequest& request)
     obj.push_back(Pair("hashespersec", gethashespersec(request)));
     obj.push_back(Pair("cpuhashespersec", getcpuhashespersec(request)));
     obj.push_back(Pair("gpuhashespersec", getgpuhashespersec(request)));
+    UniValue threadRates(UniValue::VARR);
+    for (int64_t nRate : GetCPUThreadHashRates())
+        threadRates.push_back(nRate);
+    obj.push_back(Pair("cputhreadhashespersec", threadRates));
+    obj.push_back(Pair("argon2d", Argon2dImplementation()));
     return obj;
 }
 
@@ -723,6 +731,7 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
     if (pindexPrev != chainActive.Tip() ||
         (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5)) {
         // Clear pindexPrev so future calls make a new block, despite any failures from here on
+        CBlockIndex* pindexPrevOld = pindexPrev;
         pindexPrev = nullptr;
 
         // Store the chainActive.Tip() used before CreateNewBlock, to avoid races
@@ -730,9 +739,17 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
         CBlockIndex* pindexPrevNew = chainActive.Tip();
         nStart = GetTime();
 
+        // Only the mempool changed: add its new transactions to the previous template
+        std::unique_ptr<CBlockTemplate> pblocktemplateNew;
+        if (pblocktemplate && pindexPrevOld == pindexPrevNew)
+            pblocktemplateNew = UpdateBlockTemplate(Params(), *pblocktemplate);
+
         // Create new block
-        CScript scriptDummy = CScript() << OP_TRUE;
-        pblocktemplate = CreateNewBlock(Params(), scriptDummy);
+        if (!pblocktemplateNew) {
+            CScript scriptDummy = CScript() << OP_TRUE;
+            pblocktemplateNew = CreateNewBlock(Params(), scriptDummy);
+        }
+        pblocktemplate = std::move(pblocktemplateNew);
         if (!pblocktemplate)
             throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
 
@@ -0,0 +1,98 @@
+// Copyright (c) 2016-2021 Duality Blockchain Solutions Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "arith_uint256.h"
+#include "bdap/auditdb.h"
+#include "bdap/utils.h"
+#include "test/test_cash.h"
+#include "utilstrencodings.h"
+
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(bdap_auditdb_tests, TestingSetup)
+
+static CAudit MakeAudit(const std::vector<std::string>& vHashes, const std::string& strOwner, int nTx)
+{
+    CAuditData auditData;
+    for (const std::string& strHash : vHashes)
+        auditData.vAuditData.push_back(vchFromString(strHash));
+    auditData.nTimeStamp = 1726660000 + nTx;
+    CAudit audit(auditData);
+    audit.vchOwnerFullObjectPath = vchFromString(strOwner);
+    audit.txHash = ArithToUint256(arith_uint256(nTx + 1));
+    return audit;
+}
+
+BOOST_AUTO_TEST_CASE(bdap_auditdb_indexes)
+{
+    CAuditDB db(1 << 20, true, false, false);
+    const CharString vchOwner = vchFromString("auditor@public.bdap.io");
+
+    for (int i = 0; i < 20; i++)
+        BOOST_CHECK(db.AddAudit(MakeAudit({"hash" + std::to_string(i), "shared"}, "auditor@public.bdap.io", i)));
+    BOOST_CHECK(db.AddAudit(MakeAudit({"shared"}, "other@public.bdap.io", 100)));
+
+    std::vector<CAudit> vAudits;
+    BOOST_CHECK(db.ReadAuditMN(vchOwner, vAudits));
+    BOOST_CHECK_EQUAL(vAudits.size(), 20U);
+
+    // Paging through the owner index
+    std::vector<CAudit> vPage1, vPage2;
+    BOOST_CHECK(db.ReadAuditMN(vchOwner, vPage1, 0, 15));
+    BOOST_CHECK(db.ReadAuditMN(vchOwner, vPage2, 15, 15));
+    BOOST_CHECK_EQUAL(vPage1.size(), 15U);
+    BOOST_CHECK_EQUAL(vPage2.size(), 5U);
+    BOOST_CHECK(vPage1[0].txHash == vAudits[0].txHash);
+    BOOST_CHECK(vPage2[0].txHash == vAudits[15].txHash);
+
+    vAudits.clear();
+    BOOST_CHECK(db.ReadAuditHash(vchFromString("shared"), vAudits));
+    BOOST_CHECK_EQUAL(vAudits.size(), 21U);
+    vAudits.clear();
+    BOOST_CHECK(db.ReadAuditHash(vchFromString("hash7"), vAudits));
+    BOOST_CHECK_EQUAL(vAudits.size(), 1U);
+    BOOST_CHECK(db.AuditExists(vchFromString("hash7")));
+    BOOST_CHECK(!db.AuditExists(vchFromString("hash")));
+
+    // Erasing a transaction drops it from both indexes
+    BOOST_CHECK(db.EraseAuditTxId(vchFromString(vAudits[0].txHash.ToString())));
+    BOOST_CHECK(!db.AuditExists(vchFromString("hash7")));
+    vAudits.clear();
+    BOOST_CHECK(db.ReadAuditMN(vchOwner, vAudits));
+    BOOST_CHECK_EQUAL(vAudits.size(), 19U);
+    vAudits.clear();
+    BOOST_CHECK(db.ReadAuditHash(vchFromString("shared"), vAudits));
+    BOOST_CHECK_EQUAL(vAudits.size(), 20U);
+}
+
+BOOST_AUTO_TEST_CASE(bdap_auditdb_upgrade)
+{
+    CAuditDB db(1 << 20, true, false, false);
+    const CharString vchOwner = vchFromString("auditor@public.bdap.io");
+
+    // Records in the vector-valued layout of earlier versions
+    std::vector<std::vector<unsigned char>> vvTxId;
+    for (int i = 0; i < 3; i++) {
+        CAudit audit = MakeAudit({"legacy"}, "auditor@public.bdap.io", i);
+        BOOST_CHECK(db.Write(std::make_pair(std::string("txid"), vchFromString(audit.txHash.ToString())), audit));
+        vvTxId.push_back(vchFromString(audit.txHash.ToString()));
+    }
+    BOOST_CHECK(db.Write(std::make_pair(std::string("mn"), vchOwner), vvTxId));
+    BOOST_CHECK(db.Write(std::make_pair(std::string("audit"), vchFromString("legacy")), vvTxId));
+
+    BOOST_CHECK(db.UpgradeAuditIndex());
+    BOOST_CHECK(!db.Exists(std::make_pair(std::string("mn"), vchOwner)));
+
+    std::vector<CAudit> vAudits;
+    BOOST_CHECK(db.ReadAuditMN(vchOwner, vAudits));
+    BOOST_CHECK_EQUAL(vAudits.size(), 3U);
+    vAudits.clear();
+    BOOST_CHECK(db.ReadAuditHash(vchFromString("legacy"), vAudits));
+    BOOST_CHECK_EQUAL(vAudits.size(), 3U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
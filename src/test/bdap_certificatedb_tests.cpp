@@ -0,0 +1,83 @@
+// Copyright (c) 2016-2021 Duality Blockchain Solutions Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "arith_uint256.h"
+#include "bdap/certificatedb.h"
+#include "bdap/utils.h"
+#include "test/test_cash.h"
+
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(bdap_certificatedb_tests, TestingSetup)
+
+static CX509Certificate MakeRequest(const std::string& strSubject, const std::string& strIssuer, int nTx)
+{
+    CX509Certificate certificate;
+    certificate.Subject = vchFromString(strSubject);
+    certificate.Issuer = vchFromString(strIssuer);
+    certificate.SerialNumber = 1000 + nTx;
+    certificate.txHashRequest = ArithToUint256(arith_uint256(nTx + 1));
+    return certificate;
+}
+
+static CX509Certificate MakeApprove(const CX509Certificate& request, int nTx)
+{
+    CX509Certificate certificate = request;
+    certificate.SerialNumber = 0;
+    certificate.IssuerSignature = vchFromString("signature");
+    certificate.txHashSigned = ArithToUint256(arith_uint256(nTx + 1));
+    return certificate;
+}
+
+BOOST_AUTO_TEST_CASE(bdap_certificatedb_indexes)
+{
+    CCertificateDB db(1 << 20, true, false, false);
+    const CharString vchIssuer = vchFromString("issuer@public.bdap.io");
+
+    std::vector<CX509Certificate> vRequests;
+    for (int i = 0; i < 10; i++) {
+        vRequests.push_back(MakeRequest("subject" + std::to_string(i) + "@public.bdap.io", "issuer@public.bdap.io", i));
+        BOOST_CHECK(db.AddCertificate(vRequests.back()));
+    }
+
+    std::vector<CX509Certificate> vCertificates;
+    BOOST_CHECK(db.ReadCertificateIssuerMNRequest(vchIssuer, vCertificates, false));
+    BOOST_CHECK_EQUAL(vCertificates.size(), 10U);
+
+    // Approving a request takes it out of the pending index
+    for (int i = 0; i < 4; i++)
+        BOOST_CHECK(db.AddCertificate(MakeApprove(vRequests[i], 100 + i)));
+    vCertificates.clear();
+    BOOST_CHECK(db.ReadCertificateIssuerMNRequest(vchIssuer, vCertificates, false));
+    BOOST_CHECK_EQUAL(vCertificates.size(), 6U);
+    vCertificates.clear();
+    BOOST_CHECK(db.ReadCertificateIssuerMNRequest(vchIssuer, vCertificates, true));
+    BOOST_CHECK_EQUAL(vCertificates.size(), 10U);
+    vCertificates.clear();
+    BOOST_CHECK(db.ReadCertificateIssuerMNApprove(vchIssuer, vCertificates));
+    BOOST_CHECK_EQUAL(vCertificates.size(), 4U);
+    vCertificates.clear();
+    BOOST_CHECK(db.ReadCertificateSubjectMNApprove(vRequests[2].Subject, vCertificates));
+    BOOST_CHECK_EQUAL(vCertificates.size(), 1U);
+
+    // Paged reads
+    std::vector<CX509Certificate> vPage1, vPage2;
+    BOOST_CHECK(db.ReadCertificateIssuerMNRequest(vchIssuer, vPage1, true, 0, 6));
+    BOOST_CHECK(db.ReadCertificateIssuerMNRequest(vchIssuer, vPage2, true, 6, 6));
+    BOOST_CHECK_EQUAL(vPage1.size(), 6U);
+    BOOST_CHECK_EQUAL(vPage2.size(), 4U);
+
+    // Erasing a request removes it from every index
+    BOOST_CHECK(db.EraseCertificateTxId(vchFromString(vRequests[9].txHashRequest.ToString())));
+    vCertificates.clear();
+    BOOST_CHECK(db.ReadCertificateIssuerMNRequest(vchIssuer, vCertificates, false));
+    BOOST_CHECK_EQUAL(vCertificates.size(), 5U);
+    vCertificates.clear();
+    BOOST_CHECK(!db.ReadCertificateSubjectMNRequest(vRequests[9].Subject, vCertificates));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,381 @@
+// Copyright (c) 2016-2021 Duality Blockchain Solutions Developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bdap/domainentrydb.h"
+#include "bdap/utils.h"
+#include "chain.h"
+#include "test/test_cash.h"
+
+#include <univalue.h>
+
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(bdap_domainentrydb_tests, TestingSetup)
+
+static CDomainEntry MakeDomainEntry(const std::string& strObjectID, const std::string& strOU, BDAP::ObjectType objectType)
+{
+    CDomainEntry entry;
+    entry.DomainComponent = vchFromString("bdap.io");
+    entry.OrganizationalUnit = vchFromString(strOU);
+    entry.ObjectID = vchFromString(strObjectID);
+    entry.CommonName = vchFromString("Common " + strObjectID);
+    entry.nObjectType = GetObjectTypeInt(objectType);
+    entry.DHTPublicKey = vchFromString("pubkey-" + strObjectID + "@" + strOU);
+    entry.nExpireTime = 4070908800;
+    return entry;
+}
+
+BOOST_AUTO_TEST_CASE(bdap_domainentrydb_list_directories)
+{
+    CDomainEntryDB db(1 << 20, true, false, false);
+    const CharString vchPublic = vchFromString("public.bdap.io");
+    const CharString vchAdmin = vchFromString("admin.bdap.io");
+
+    for (int i = 0; i < 25; i++)
+        BOOST_CHECK(db.AddDomainEntry(MakeDomainEntry("user" + std::to_string(i), "public", BDAP::ObjectType::BDAP_USER), OP_BDAP_NEW));
+    for (int i = 0; i < 5; i++)
+        BOOST_CHECK(db.AddDomainEntry(MakeDomainEntry("group" + std::to_string(i), "public", BDAP::ObjectType::BDAP_GROUP), OP_BDAP_NEW));
+    BOOST_CHECK(db.AddDomainEntry(MakeDomainEntry("user100", "admin", BDAP::ObjectType::BDAP_USER), OP_BDAP_NEW));
+
+    // Pages of a location and type
+    UniValue oPage1(UniValue::VARR), oPage3(UniValue::VARR), oPage4(UniValue::VARR);
+    BOOST_CHECK(db.ListDirectories(vchPublic, 10, 1, oPage1, BDAP::ObjectType::BDAP_USER));
+    BOOST_CHECK(db.ListDirectories(vchPublic, 10, 3, oPage3, BDAP::ObjectType::BDAP_USER));
+    BOOST_CHECK(db.ListDirectories(vchPublic, 10, 4, oPage4, BDAP::ObjectType::BDAP_USER));
+    BOOST_CHECK_EQUAL(oPage1.size(), 10U);
+    BOOST_CHECK_EQUAL(oPage3.size(), 5U);
+    BOOST_CHECK_EQUAL(oPage4.size(), 0U);
+
+    UniValue oGroups(UniValue::VARR), oAdmin(UniValue::VARR), oAll(UniValue::VARR);
+    BOOST_CHECK(db.ListDirectories(vchPublic, 100, 1, oGroups, BDAP::ObjectType::BDAP_GROUP));
+    BOOST_CHECK(db.ListDirectories(vchAdmin, 100, 1, oAdmin, BDAP::ObjectType::BDAP_USER));
+    BOOST_CHECK(db.ListDirectories(CharString(), 100, 1, oAll));
+    BOOST_CHECK_EQUAL(oGroups.size(), 5U);
+    BOOST_CHECK_EQUAL(oAdmin.size(), 1U);
+    BOOST_CHECK_EQUAL(oAll.size(), 31U);
+
+    // Search strings filter before paging
+    UniValue oSearch(UniValue::VARR);
+    BOOST_CHECK(db.ListDirectories(vchPublic, 100, 1, oSearch, BDAP::ObjectType::BDAP_USER, "user1"));
+    BOOST_CHECK_EQUAL(oSearch.size(), 11U); // user1, user10-user19
+
+    // Cursor paging visits every entry once
+    std::vector<unsigned char> vchCursor, vchNextCursor;
+    std::set<CharString> setSeen;
+    do {
+        std::vector<CDomainEntry> vEntries;
+        BOOST_CHECK(db.ListDirectories(vchPublic, BDAP::ObjectType::BDAP_USER, vchCursor, 7, vEntries, vchNextCursor));
+        BOOST_CHECK(vEntries.size() <= 7);
+        for (const CDomainEntry& entry : vEntries)
+            BOOST_CHECK(setSeen.insert(entry.ObjectID).second);
+        vchCursor = vchNextCursor;
+    } while (!vchCursor.empty());
+    BOOST_CHECK_EQUAL(setSeen.size(), 25U);
+
+    // Erased entries leave the index
+    CDomainEntry erased = MakeDomainEntry("user0", "public", BDAP::ObjectType::BDAP_USER);
+    BOOST_CHECK(db.EraseDomainEntry(erased.vchFullObjectPath()));
+    UniValue oAfterErase(UniValue::VARR);
+    BOOST_CHECK(db.ListDirectories(vchPublic, 100, 1, oAfterErase, BDAP::ObjectType::BDAP_USER));
+    BOOST_CHECK_EQUAL(oAfterErase.size(), 24U);
+}
+
+BOOST_AUTO_TEST_CASE(bdap_domainentrydb_search)
+{
+    CDomainEntryDB db(1 << 20, true, false, false);
+    const CharString vchPublic = vchFromString("public.bdap.io");
+
+    BOOST_CHECK(db.AddDomainEntry(MakeDomainEntry("alice", "public", BDAP::ObjectType::BDAP_USER), OP_BDAP_NEW));
+    BOOST_CHECK(db.AddDomainEntry(MakeDomainEntry("malice", "public", BDAP::ObjectType::BDAP_USER), OP_BDAP_NEW));
+    BOOST_CHECK(db.AddDomainEntry(MakeDomainEntry("alicebob", "public", BDAP::ObjectType::BDAP_USER), OP_BDAP_NEW));
+    BOOST_CHECK(db.AddDomainEntry(MakeDomainEntry("bob", "public", BDAP::ObjectType::BDAP_USER), OP_BDAP_NEW));
+    BOOST_CHECK(db.AddDomainEntry(MakeDomainEntry("alice", "admin", BDAP::ObjectType::BDAP_USER), OP_BDAP_NEW));
+    BOOST_CHECK(db.AddDomainEntry(MakeDomainEntry("alicegroup", "public", BDAP::ObjectType::BDAP_GROUP), OP_BDAP_NEW));
+
+    // Exact, then prefix, then substring matches
+    std::vector<CDomainEntry> vEntries;
+    BOOST_CHECK(db.SearchDomainEntries("alice", vchPublic, BDAP::ObjectType::BDAP_USER, 0, 10, vEntries));
+    BOOST_CHECK_EQUAL(vEntries.size(), 3U);
+    BOOST_CHECK_EQUAL(stringFromVch(vEntries[0].ObjectID), "alice");
+    BOOST_CHECK_EQUAL(stringFromVch(vEntries[1].ObjectID), "alicebob");
+    BOOST_CHECK_EQUAL(stringFromVch(vEntries[2].ObjectID), "malice");
+
+    // Paging over the ranked results, across locations and types
+    vEntries.clear();
+    BOOST_CHECK(db.SearchDomainEntries("alice", CharString(), DEFAULT_ACCOUNT_TYPE, 2, 2, vEntries));
+    BOOST_CHECK_EQUAL(vEntries.size(), 2U);
+
+    // Search strings shorter than a gram, and ones matching the CommonName
+    vEntries.clear();
+    BOOST_CHECK(db.SearchDomainEntries("bo", vchPublic, BDAP::ObjectType::BDAP_USER, 0, 10, vEntries));
+    BOOST_CHECK_EQUAL(vEntries.size(), 2U);
+    vEntries.clear();
+    BOOST_CHECK(db.SearchDomainEntries("Common bob", vchPublic, BDAP::ObjectType::BDAP_USER, 0, 10, vEntries));
+    BOOST_CHECK_EQUAL(vEntries.size(), 1U);
+    vEntries.clear();
+    BOOST_CHECK(db.SearchDomainEntries("carol", CharString(), DEFAULT_ACCOUNT_TYPE, 0, 10, vEntries));
+    BOOST_CHECK(vEntries.empty());
+
+    // Erased entries leave the index
+    BOOST_CHECK(db.EraseDomainEntry(vchFromString("malice@public.bdap.io")));
+    UniValue oPage(UniValue::VARR);
+    BOOST_CHECK(db.ListDirectories(vchPublic, 10, 1, oPage, BDAP::ObjectType::BDAP_USER, "lice"));
+    BOOST_CHECK_EQUAL(oPage.size(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(bdap_domainentrydb_remove_expired)
+{
+    CDomainEntryDB db(1 << 20, true, false, false);
+    const CharString vchPublic = vchFromString("public.bdap.io");
+
+    // Entries expiring at 1000, 2000, ... 10000, added out of order
+    for (int i = 10; i > 0; i--) {
+        CDomainEntry entry = MakeDomainEntry("user" + std::to_string(i), "public", BDAP::ObjectType::BDAP_USER);
+        entry.nExpireTime = i * 1000;
+        BOOST_CHECK(db.AddDomainEntry(entry, OP_BDAP_NEW));
+    }
+
+    // Nothing has expired yet
+    int nRemoved = 0;
+    BOOST_CHECK(db.RemoveExpired(999, 100, nRemoved));
+    BOOST_CHECK_EQUAL(nRemoved, 0);
+
+    // The removal bound leaves later expired entries for the next call
+    BOOST_CHECK(db.RemoveExpired(5000, 3, nRemoved));
+    BOOST_CHECK_EQUAL(nRemoved, 3);
+    BOOST_CHECK(!db.DomainEntryExists(vchFromString("user1@public.bdap.io")));
+    BOOST_CHECK(!db.DomainEntryExistsPubKey(vchFromString("pubkey-user3@public")));
+    BOOST_CHECK(db.DomainEntryExists(vchFromString("user4@public.bdap.io")));
+
+    BOOST_CHECK(db.RemoveExpired(5000, 100, nRemoved));
+    BOOST_CHECK_EQUAL(nRemoved, 5);
+    BOOST_CHECK(!db.DomainEntryExists(vchFromString("user5@public.bdap.io")));
+    BOOST_CHECK(db.DomainEntryExists(vchFromString("user6@public.bdap.io")));
+
+    // An update moves the entry to its new expiry time
+    CDomainEntry entry;
+    BOOST_CHECK(db.ReadDomainEntry(vchFromString("user6@public.bdap.io"), entry));
+    entry.nExpireTime = 20000;
+    BOOST_CHECK(db.UpdateDomainEntry(entry.vchFullObjectPath(), entry));
+    BOOST_CHECK(db.RemoveExpired(10000, 100, nRemoved));
+    BOOST_CHECK_EQUAL(nRemoved, 9);
+    BOOST_CHECK(db.DomainEntryExists(vchFromString("user6@public.bdap.io")));
+
+    UniValue oRemaining(UniValue::VARR);
+    BOOST_CHECK(db.ListDirectories(vchPublic, 100, 1, oRemaining, BDAP::ObjectType::BDAP_USER));
+    BOOST_CHECK_EQUAL(oRemaining.size(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(bdap_domainentrydb_cache)
+{
+    CDomainEntryDB db(1 << 20, true, false, false);
+    const CDomainEntry alice = MakeDomainEntry("alice", "public", BDAP::ObjectType::BDAP_USER);
+    BOOST_CHECK(db.AddDomainEntry(alice, OP_BDAP_NEW));
+
+    size_t nEntries, nUsage;
+    uint64_t nHits, nMisses;
+    CDomainEntry entry;
+    BOOST_CHECK(db.ReadDomainEntry(alice.vchFullObjectPath(), entry));
+    BOOST_CHECK(db.ReadDomainEntry(alice.vchFullObjectPath(), entry));
+    BOOST_CHECK(db.DomainEntryExists(alice.vchFullObjectPath()));
+    BOOST_CHECK(db.ReadDomainEntryPubKey(alice.DHTPublicKey, entry));
+    db.GetCacheInfo(nEntries, nUsage, nHits, nMisses);
+    BOOST_CHECK_EQUAL(nEntries, 2U);
+    BOOST_CHECK(nUsage > 0);
+    BOOST_CHECK_EQUAL(nHits, 2U);
+    BOOST_CHECK_EQUAL(nMisses, 2U);
+
+    // Updates replace the cached entry
+    CDomainEntry updated = alice;
+    updated.CommonName = vchFromString("Alice Updated");
+    BOOST_CHECK(db.UpdateDomainEntry(updated.vchFullObjectPath(), updated));
+    BOOST_CHECK(db.ReadDomainEntry(alice.vchFullObjectPath(), entry));
+    BOOST_CHECK(entry.CommonName == updated.CommonName);
+    BOOST_CHECK(db.ReadDomainEntryPubKey(alice.DHTPublicKey, entry));
+    BOOST_CHECK(entry.CommonName == updated.CommonName);
+
+    // Erased entries are no longer found
+    BOOST_CHECK(db.EraseDomainEntry(alice.vchFullObjectPath()));
+    BOOST_CHECK(db.EraseDomainEntryPubKey(alice.DHTPublicKey));
+    BOOST_CHECK(!db.ReadDomainEntry(alice.vchFullObjectPath(), entry));
+    BOOST_CHECK(!db.DomainEntryExists(alice.vchFullObjectPath()));
+    BOOST_CHECK(!db.DomainEntryExistsPubKey(alice.DHTPublicKey));
+
+    // The cache stays within its memory bound
+    CDomainEntryDB dbSmall(1 << 20, true, false, false, 16 << 10);
+    for (int i = 0; i < 200; i++) {
+        CDomainEntry user = MakeDomainEntry("user" + std::to_string(i), "public", BDAP::ObjectType::BDAP_USER);
+        BOOST_CHECK(dbSmall.AddDomainEntry(user, OP_BDAP_NEW));
+        BOOST_CHECK(dbSmall.ReadDomainEntry(user.vchFullObjectPath(), entry));
+    }
+    dbSmall.GetCacheInfo(nEntries, nUsage, nHits, nMisses);
+    BOOST_CHECK(nEntries > 0 && nEntries < 200);
+    BOOST_CHECK(nUsage <= (16 << 10));
+}
+
+BOOST_AUTO_TEST_CASE(bdap_domainentrydb_block_stage)
+{
+    CDomainEntryDB db(1 << 20, true, false, false);
+    const CDomainEntry alice = MakeDomainEntry("alice", "public", BDAP::ObjectType::BDAP_USER);
+    const CDomainEntry bob = MakeDomainEntry("bob", "public", BDAP::ObjectType::BDAP_USER);
+    BOOST_CHECK(db.AddDomainEntry(alice, OP_BDAP_NEW));
+    const CBDAPBlock block1(1, uint256S("01"));
+    const CBDAPBlock block2(2, uint256S("02"));
+
+    // Staged changes are read back before they are committed
+    CDomainEntry updated = alice;
+    updated.CommonName = vchFromString("Alice Updated");
+    CDomainEntry entry;
+    db.BeginBlock(block1);
+    BOOST_CHECK(db.UpdateDomainEntry(updated.vchFullObjectPath(), updated));
+    BOOST_CHECK(db.AddDomainEntry(bob, OP_BDAP_NEW));
+    BOOST_CHECK(db.ReadDomainEntry(alice.vchFullObjectPath(), entry));
+    BOOST_CHECK(entry.CommonName == updated.CommonName);
+    BOOST_CHECK(db.DomainEntryExists(bob.vchFullObjectPath()));
+
+    // Other threads only see committed values, and staged ones are not cached for them
+    bool fOtherHasBob = true;
+    CDomainEntry otherEntry;
+    std::thread([&] {
+        fOtherHasBob = db.DomainEntryExists(bob.vchFullObjectPath());
+        db.ReadDomainEntry(alice.vchFullObjectPath(), otherEntry);
+    }).join();
+    BOOST_CHECK(!fOtherHasBob);
+    BOOST_CHECK(otherEntry.CommonName == alice.CommonName);
+
+    BOOST_CHECK(db.CommitBlock());
+    BOOST_CHECK(db.ReadDomainEntry(alice.vchFullObjectPath(), entry));
+    BOOST_CHECK(entry.CommonName == updated.CommonName);
+    BOOST_CHECK(db.DomainEntryExistsPubKey(bob.DHTPublicKey));
+    BOOST_CHECK(db.GetBestBlock().hash == block1.hash);
+    std::thread([&] {
+        fOtherHasBob = db.DomainEntryExists(bob.vchFullObjectPath());
+        db.ReadDomainEntry(alice.vchFullObjectPath(), otherEntry);
+    }).join();
+    BOOST_CHECK(fOtherHasBob);
+    BOOST_CHECK(otherEntry.CommonName == updated.CommonName);
+
+    // Aborted changes are dropped
+    db.BeginBlock(block2);
+    BOOST_CHECK(db.EraseDomainEntry(bob.vchFullObjectPath()));
+    BOOST_CHECK(!db.DomainEntryExists(bob.vchFullObjectPath()));
+    db.AbortBlock();
+    BOOST_CHECK(db.ReadDomainEntry(bob.vchFullObjectPath(), entry));
+    BOOST_CHECK(db.GetBestBlock().hash == block1.hash);
+    bool fFound = true;
+    BOOST_CHECK(db.DisconnectBlock(block2, fFound));
+    BOOST_CHECK(!fFound);
+
+    // Disconnecting restores the values from before the block
+    BOOST_CHECK(db.DisconnectBlock(block1, fFound));
+    BOOST_CHECK(fFound);
+    BOOST_CHECK(db.ReadDomainEntry(alice.vchFullObjectPath(), entry));
+    BOOST_CHECK(entry.CommonName == alice.CommonName);
+    BOOST_CHECK(!db.DomainEntryExists(bob.vchFullObjectPath()));
+    BOOST_CHECK(!db.DomainEntryExistsPubKey(bob.DHTPublicKey));
+    std::vector<CDomainEntry> vEntries;
+    BOOST_CHECK(db.SearchDomainEntries("bob", CharString(), DEFAULT_ACCOUNT_TYPE, 0, 10, vEntries));
+    BOOST_CHECK(vEntries.empty());
+    BOOST_CHECK(db.GetBestBlock().IsNull());
+}
+
+BOOST_AUTO_TEST_CASE(bdap_domainentrydb_rewind)
+{
+    CDomainEntryDB db(1 << 20, true, false, false);
+    const CDomainEntry alice = MakeDomainEntry("alice", "public", BDAP::ObjectType::BDAP_USER);
+    const CDomainEntry bob = MakeDomainEntry("bob", "public", BDAP::ObjectType::BDAP_USER);
+    CDomainEntry updated = alice;
+    updated.CommonName = vchFromString("Alice Updated");
+
+    std::vector<uint256> vHashes;
+    for (int i = 0; i < 4; i++)
+        vHashes.push_back(uint256S(std::to_string(i + 1)));
+    std::vector<CBlockIndex> vIndex(vHashes.size());
+    for (size_t i = 0; i < vIndex.size(); i++) {
+        vIndex[i].nHeight = i;
+        vIndex[i].phashBlock = &vHashes[i];
+        vIndex[i].pprev = i > 0 ? &vIndex[i - 1] : NULL;
+    }
+
+    // Block 0 adds alice, block 1 adds bob, block 2 updates alice and
+    // deletes bob, block 3 changes nothing
+    db.BeginBlock(CBDAPBlock(0, vHashes[0]));
+    BOOST_CHECK(db.AddDomainEntry(alice, OP_BDAP_NEW));
+    BOOST_CHECK(db.CommitBlock());
+    db.BeginBlock(CBDAPBlock(1, vHashes[1]));
+    BOOST_CHECK(db.AddDomainEntry(bob, OP_BDAP_NEW));
+    BOOST_CHECK(db.CommitBlock());
+    db.BeginBlock(CBDAPBlock(2, vHashes[2]));
+    BOOST_CHECK(db.UpdateDomainEntry(updated.vchFullObjectPath(), updated));
+    BOOST_CHECK(db.EraseDomainEntry(bob.vchFullObjectPath()));
+    BOOST_CHECK(db.CommitBlock());
+    db.BeginBlock(CBDAPBlock(3, vHashes[3]));
+    BOOST_CHECK(db.CommitBlock());
+    BOOST_CHECK(db.GetBestBlock().hash == vHashes[2]);
+
+    // Nothing to undo while every committed block is in the chain
+    CChain chain;
+    chain.SetTip(&vIndex[3]);
+    BOOST_CHECK(db.SyncToChain(chain));
+    BOOST_CHECK(db.GetBestBlock().hash == vHashes[2]);
+
+    // A crash left the chainstate at block 0: blocks 2 and 1 are undone in that order
+    chain.SetTip(&vIndex[0]);
+    BOOST_CHECK(db.SyncToChain(chain));
+    BOOST_CHECK(db.GetBestBlock().hash == vHashes[0]);
+    CDomainEntry entry;
+    BOOST_CHECK(db.ReadDomainEntry(alice.vchFullObjectPath(), entry));
+    BOOST_CHECK(entry.CommonName == alice.CommonName);
+    BOOST_CHECK(!db.DomainEntryExists(bob.vchFullObjectPath()));
+    BOOST_CHECK(!db.DomainEntryExistsPubKey(bob.DHTPublicKey));
+
+    // Blocks 2 and 1 were disconnected, but a crash left the chainstate at
+    // block 3: they are applied again in order
+    chain.SetTip(&vIndex[3]);
+    BOOST_CHECK(db.SyncToChain(chain));
+    BOOST_CHECK(db.GetBestBlock().hash == vHashes[2]);
+    BOOST_CHECK(db.ReadDomainEntry(alice.vchFullObjectPath(), entry));
+    BOOST_CHECK(entry.CommonName == updated.CommonName);
+    BOOST_CHECK(!db.DomainEntryExists(bob.vchFullObjectPath()));
+    BOOST_CHECK(db.DomainEntryExistsPubKey(bob.DHTPublicKey));
+
+    // Block 1 connects again after both were disconnected, and block 2 is
+    // applied again on top of it
+    bool fFound = false;
+    BOOST_CHECK(db.DisconnectBlock(CBDAPBlock(2, vHashes[2]), fFound));
+    BOOST_CHECK(fFound);
+    BOOST_CHECK(db.DisconnectBlock(CBDAPBlock(1, vHashes[1]), fFound));
+    BOOST_CHECK(fFound);
+    db.BeginBlock(CBDAPBlock(1, vHashes[1]));
+    BOOST_CHECK(db.AddDomainEntry(bob, OP_BDAP_NEW));
+    BOOST_CHECK(db.CommitBlock());
+    BOOST_CHECK(db.SyncToChain(chain));
+    BOOST_CHECK(db.GetBestBlock().hash == vHashes[2]);
+    BOOST_CHECK(db.ReadDomainEntry(alice.vchFullObjectPath(), entry));
+    BOOST_CHECK(entry.CommonName == updated.CommonName);
+    BOOST_CHECK(!db.DomainEntryExists(bob.vchFullObjectPath()));
+
+    // Pruned undo records are gone, later ones stay
+    BOOST_CHECK(db.PruneUndo(1));
+    BOOST_CHECK(db.DisconnectBlock(CBDAPBlock(0, vHashes[0]), fFound));
+    BOOST_CHECK(!fFound);
+    BOOST_CHECK(db.DisconnectBlock(CBDAPBlock(2, vHashes[2]), fFound));
+    BOOST_CHECK(fFound);
+    BOOST_CHECK(db.DisconnectBlock(CBDAPBlock(1, vHashes[1]), fFound));
+    BOOST_CHECK(fFound);
+    BOOST_CHECK(!db.DomainEntryExists(bob.vchFullObjectPath()));
+    BOOST_CHECK(db.GetBestBlock().hash == vHashes[0]);
+
+    // Pruned redo records are not applied again
+    BOOST_CHECK(db.PruneUndo(3));
+    BOOST_CHECK(db.SyncToChain(chain));
+    BOOST_CHECK(db.GetBestBlock().hash == vHashes[0]);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -13,6 +13,8 @@
 #include "utilstrencodings.h"
 #include "test/test_cash.h"
 #include "bdap/linking.h"
+#include "bdap/linkmanager.h"
+#include "bdap/utils.h"
 
 
 #include <string>
@@ -43,4 +45,81 @@ BOOST_AUTO_TEST_CASE(bdap_link_test1)
 
 }
 
+BOOST_AUTO_TEST_CASE(bdap_link_manager_indexes)
+{
+    CLinkManager linkManager;
+    const std::vector<unsigned char> vchRequestorPubKey = vchFromString("requestor-pubkey");
+    const std::vector<unsigned char> vchRecipientPubKey = vchFromString("recipient-pubkey");
+    const std::vector<unsigned char> vchNewRequestorPubKey = vchFromString("new-requestor-pubkey");
+
+    // A pending request from me, without message info yet
+    CLink link;
+    link.LinkID = uint256S("01");
+    link.nLinkState = BDAP::LinkState::pending_state;
+    link.fRequestFromMe = true;
+    link.RequestorPubKey = vchRequestorPubKey;
+    link.txHashRequest = uint256S("a1");
+    linkManager.AddLink(link);
+
+    // Another link, whose entries must survive changes to the first one
+    CLink other;
+    other.LinkID = uint256S("02");
+    other.nLinkState = BDAP::LinkState::complete_state;
+    other.RequestorPubKey = vchFromString("other-requestor-pubkey");
+    other.RecipientPubKey = vchFromString("other-recipient-pubkey");
+    other.txHashRequest = uint256S("b1");
+    other.SubjectID = uint256S("bb");
+    linkManager.AddLink(other);
+
+    CLink found;
+    std::vector<CLink> vLinks;
+    BOOST_CHECK_EQUAL(linkManager.LinkCount(), 2U);
+    BOOST_CHECK(linkManager.FindLinkByPubKey(vchRequestorPubKey, found) && found.LinkID == link.LinkID);
+    BOOST_CHECK(!linkManager.FindLinkByPubKey(vchRecipientPubKey, found));
+    BOOST_CHECK(!linkManager.FindLinkBySubjectID(uint256(), found));
+    linkManager.ListMyPendingRequests(vLinks);
+    BOOST_REQUIRE_EQUAL(vLinks.size(), 1U);
+    BOOST_CHECK(vLinks[0].LinkID == link.LinkID);
+    vLinks.clear();
+    linkManager.ListMyCompleted(vLinks);
+    BOOST_REQUIRE_EQUAL(vLinks.size(), 1U);
+    BOOST_CHECK(vLinks[0].LinkID == other.LinkID);
+
+    // The accept completes the link, with a new requestor pubkey and message info
+    link.nLinkState = BDAP::LinkState::complete_state;
+    link.RequestorPubKey = vchNewRequestorPubKey;
+    link.RecipientPubKey = vchRecipientPubKey;
+    link.txHashAccept = uint256S("a2");
+    link.SubjectID = uint256S("aa");
+    linkManager.AddLink(link);
+
+    BOOST_CHECK_EQUAL(linkManager.LinkCount(), 2U);
+    BOOST_CHECK(!linkManager.FindLinkByPubKey(vchRequestorPubKey, found));
+    BOOST_CHECK(linkManager.FindLinkByPubKey(vchNewRequestorPubKey, found) && found.LinkID == link.LinkID);
+    BOOST_CHECK(linkManager.FindLinkByPubKey(vchRecipientPubKey, found) && found.LinkID == link.LinkID);
+    BOOST_CHECK(linkManager.FindLinkBySubjectID(link.SubjectID, found) && found.LinkID == link.LinkID);
+    BOOST_CHECK(found.txHashAccept == link.txHashAccept);
+    vLinks.clear();
+    linkManager.ListMyPendingRequests(vLinks);
+    BOOST_CHECK(vLinks.empty());
+    vLinks.clear();
+    linkManager.ListMyCompleted(vLinks);
+    BOOST_CHECK_EQUAL(vLinks.size(), 2U);
+
+    linkManager.RemoveLink(link.LinkID);
+
+    BOOST_CHECK_EQUAL(linkManager.LinkCount(), 1U);
+    BOOST_CHECK(!linkManager.FindLink(link.LinkID, found));
+    BOOST_CHECK(!linkManager.FindLinkByPubKey(vchNewRequestorPubKey, found));
+    BOOST_CHECK(!linkManager.FindLinkByPubKey(vchRecipientPubKey, found));
+    BOOST_CHECK(!linkManager.FindLinkBySubjectID(link.SubjectID, found));
+    vLinks.clear();
+    linkManager.ListMyCompleted(vLinks);
+    BOOST_REQUIRE_EQUAL(vLinks.size(), 1U);
+    BOOST_CHECK(vLinks[0].LinkID == other.LinkID);
+    BOOST_CHECK(linkManager.FindLinkBySubjectID(other.SubjectID, found) && found.LinkID == other.LinkID);
+    BOOST_CHECK(linkManager.FindLinkByPubKey(other.RequestorPubKey, found) && found.LinkID == other.LinkID);
+    BOOST_CHECK(linkManager.FindLinkByPubKey(other.RecipientPubKey, found) && found.LinkID == other.LinkID);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
@@ -7,8 +7,11 @@
 
 #include "key.h"
 
+#include "arith_uint256.h"
 #include "base58.h"
+#include "hash.h"
 #include "script/script.h"
+#include "streams.h"
 #include "uint256.h"
 #include "util.h"
 #include "utilstrencodings.h"
@@ -22,12 +25,14 @@
 
 #include "bdap/bdap.h"
 #include "bdap/vgpmessage.h"
+#include "bdap/vgpmessagestore.h"
 #include "bdap/domainentry.h"
 #include "bdap/domainentrydb.h"
 #include "bdap/linkmanager.h"
 #include "timedata.h"
 #include "wallet/wallet.h"
 #include "net.h"
+#include "random.h"
 
 #include "chain.h"
 #include "chainparams.h"
@@ -261,4 +266,197 @@ BOOST_AUTO_TEST_CASE(bdap_vgp_message_test1)
 
 }
 
+BOOST_AUTO_TEST_CASE(bdap_vgp_message_decode_once)
+{
+    CUnsignedVGPMessage unsignedMessage(uint256S("01"), uint256S("02"), std::vector<unsigned char>(33, 0x03), 1726660000, 1726660000 + 60);
+    unsignedMessage.fEncrypted = false;
+    unsignedMessage.vchMessageData = std::vector<unsigned char>(64, 0x04);
+    unsignedMessage.nNonce = 7;
+
+    CVGPMessage message(unsignedMessage);
+    BOOST_CHECK(message.GetHash() == unsignedMessage.GetHash());
+    BOOST_CHECK(message.UnsignedMessage().SubjectID == unsignedMessage.SubjectID);
+    BOOST_CHECK(message.UnsignedMessage().nTimeStamp == unsignedMessage.nTimeStamp);
+    BOOST_CHECK_EQUAL(message.Version(), CUnsignedVGPMessage::CURRENT_VERSION);
+
+    // Received messages are decoded as they are deserialized
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << message;
+    CVGPMessage received;
+    ss >> received;
+    BOOST_CHECK(received.GetHash() == message.GetHash());
+    BOOST_CHECK(received.UnsignedMessage().MessageID == unsignedMessage.MessageID);
+    BOOST_CHECK(received.UnsignedMessage().vchMessageData == unsignedMessage.vchMessageData);
+
+    // Mining sets the hash of the mined message
+    received.MineMessage();
+    BOOST_CHECK(received.GetHash() == CUnsignedVGPMessage(received.vchMsg).GetHash());
+    BOOST_CHECK(UintToArith256(received.GetHash()) <= UintToArith256(VGP_MESSAGE_MIN_HASH_TARGET));
+    BOOST_CHECK(received.UnsignedMessage().nNonce == CUnsignedVGPMessage(received.vchMsg).nNonce);
+
+    received.SetNull();
+    BOOST_CHECK(received.GetHash().IsNull());
+    BOOST_CHECK_EQUAL(received.Version(), -1);
+}
+
+BOOST_AUTO_TEST_CASE(bdap_vgp_message_admission)
+{
+    int64_t timestamp = GetAdjustedTime();
+    CUnsignedVGPMessage unsignedMessage(uint256S("01"), uint256S("02"), std::vector<unsigned char>(33, 0x03), timestamp, timestamp + 60);
+    unsignedMessage.fEncrypted = false;
+    unsignedMessage.vchMessageData = std::vector<unsigned char>(64, 0x04);
+    std::string strErrorMessage;
+
+    CVGPMessage message(unsignedMessage);
+    BOOST_CHECK_EQUAL(message.CheckMessage(strErrorMessage), 0);
+    BOOST_CHECK(message.GetMsgHash() == Hash(message.vchMsg.begin(), message.vchMsg.end()));
+
+    // Out of the time window
+    CUnsignedVGPMessage staleMessage = unsignedMessage;
+    staleMessage.nTimeStamp = timestamp - VGP_MESSAGE_IN_EFFECT_SECONDS - 10;
+    staleMessage.nRelayUntil = staleMessage.nTimeStamp + 60;
+    BOOST_CHECK_EQUAL(CVGPMessage(staleMessage).CheckMessage(strErrorMessage), -2);
+
+    CUnsignedVGPMessage largeKeyMessage = unsignedMessage;
+    largeKeyMessage.vchWalletPubKey = std::vector<unsigned char>(MAX_WALLET_PUBKEY_SIZE + 1, 0x03);
+    BOOST_CHECK_EQUAL(CVGPMessage(largeKeyMessage).CheckMessage(strErrorMessage), 100);
+
+    // Unsigned messages are rejected before their proof of work is checked
+    // until the peer has used up its rate budget
+    const int nPeerRate = nVGPMessagePeerRate;
+    const int nPeerBurst = nVGPMessagePeerBurst;
+    nVGPMessagePeerRate = 0;
+    nVGPMessagePeerBurst = 10;
+    NodeId nodeFrom = 1000;
+    for (int i = 0; i < nVGPMessagePeerBurst; i++) {
+        unsignedMessage.nNonce = i;
+        BOOST_CHECK_EQUAL(AdmitVGPMessage(CVGPMessage(unsignedMessage), nodeFrom, strErrorMessage), 100);
+    }
+    unsignedMessage.nNonce = nVGPMessagePeerBurst;
+    CVGPMessage overBudget(unsignedMessage);
+    BOOST_CHECK_EQUAL(AdmitVGPMessage(overBudget, nodeFrom, strErrorMessage), -5);
+    BOOST_CHECK_EQUAL(AdmitVGPMessage(overBudget, nodeFrom + 1, strErrorMessage), 100);
+    FinalizeVGPPeer(nodeFrom);
+    BOOST_CHECK_EQUAL(AdmitVGPMessage(overBudget, nodeFrom, strErrorMessage), 100);
+    FinalizeVGPPeer(nodeFrom);
+    FinalizeVGPPeer(nodeFrom + 1);
+
+    // Duplicates are found by the SHA256 hash of the message
+    BOOST_CHECK(!ReceivedMessage(overBudget.GetMsgHash()));
+    BOOST_CHECK_EQUAL(AdmitVGPMessage(overBudget, nodeFrom, strErrorMessage), -1);
+
+    // Duplicates do not use up the budget
+    for (int i = 0; i < nVGPMessagePeerBurst; i++)
+        BOOST_CHECK_EQUAL(AdmitVGPMessage(overBudget, nodeFrom, strErrorMessage), -1);
+    unsignedMessage.nNonce = nVGPMessagePeerBurst + 1;
+    BOOST_CHECK_EQUAL(AdmitVGPMessage(CVGPMessage(unsignedMessage), nodeFrom, strErrorMessage), 100);
+    FinalizeVGPPeer(nodeFrom);
+    nVGPMessagePeerRate = nPeerRate;
+    nVGPMessagePeerBurst = nPeerBurst;
+}
+
+BOOST_AUTO_TEST_CASE(bdap_vgp_message_log)
+{
+    const int64_t nTime = 1726660000;
+    CVGPMessageLog log(100);
+    BOOST_CHECK(log.Insert(uint256S("01"), nTime));
+    BOOST_CHECK(!log.Insert(uint256S("01"), nTime + 10));
+    BOOST_CHECK(log.Contains(uint256S("01"), nTime + KEEP_MESSAGE_LOG_ALIVE_SECONDS - 1));
+    BOOST_CHECK(!log.Contains(uint256S("02"), nTime));
+
+    // Kept for at least KEEP_MESSAGE_LOG_ALIVE_SECONDS, then dropped with its bucket
+    BOOST_CHECK(log.Insert(uint256S("02"), nTime + KEEP_MESSAGE_LOG_ALIVE_SECONDS));
+    BOOST_CHECK(log.Contains(uint256S("01"), nTime + KEEP_MESSAGE_LOG_ALIVE_SECONDS));
+    BOOST_CHECK(!log.Contains(uint256S("01"), nTime + 2 * KEEP_MESSAGE_LOG_ALIVE_SECONDS));
+    BOOST_CHECK(log.Contains(uint256S("02"), nTime + 2 * KEEP_MESSAGE_LOG_ALIVE_SECONDS - 1));
+    BOOST_CHECK(log.Insert(uint256S("01"), nTime + 2 * KEEP_MESSAGE_LOG_ALIVE_SECONDS));
+
+    // Over its size the oldest messages are forgotten first
+    CVGPMessageLog smallLog(10);
+    for (int i = 0; i < 10; i++)
+        BOOST_CHECK(smallLog.Insert(ArithToUint256(arith_uint256(i + 1)), nTime + i * 10));
+    BOOST_CHECK_EQUAL(smallLog.Size(), 10U);
+    BOOST_CHECK(smallLog.Insert(uint256S("ff"), nTime + 100));
+    BOOST_CHECK(smallLog.Size() <= 10U);
+    BOOST_CHECK(!smallLog.Contains(ArithToUint256(arith_uint256(1)), nTime + 100));
+    BOOST_CHECK(smallLog.Contains(uint256S("ff"), nTime + 100));
+}
+
+static CVGPMessage MakeStoreMessage(const uint256& subjectID, const std::string& strType, const std::string& strSender, bool fKeepLast, int64_t nTimeStamp)
+{
+    CUnsignedVGPMessage unsignedMessage(subjectID, GetRandHash(), std::vector<unsigned char>(33, 0x03), nTimeStamp, nTimeStamp + 60);
+    unsignedMessage.fEncrypted = false;
+    // Serialized like CMessage
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << 1 << vchFromString(strType) << vchFromString("value") << vchFromString(strSender) << fKeepLast;
+    unsignedMessage.vchMessageData = std::vector<unsigned char>(ss.begin(), ss.end());
+    return CVGPMessage(unsignedMessage);
+}
+
+BOOST_AUTO_TEST_CASE(bdap_vgp_message_store)
+{
+    const int64_t nTime = 1726660000;
+    const uint256 linkA = uint256S("0a");
+    const uint256 linkB = uint256S("0b");
+    CVGPMessageStore store;
+    BOOST_CHECK(store.Add(MakeStoreMessage(linkA, "chat", "alice@public.bdap.io", false, nTime)));
+    BOOST_CHECK(store.Add(MakeStoreMessage(linkB, "chat", "bob@public.bdap.io", false, nTime + 1)));
+    CVGPMessage status = MakeStoreMessage(linkA, "status", "alice@public.bdap.io", true, nTime + 10);
+    BOOST_CHECK(store.Add(status));
+
+    std::vector<CVGPMessage> vMessages;
+    store.GetBySubject(linkA, vMessages);
+    BOOST_CHECK_EQUAL(vMessages.size(), 2U);
+    vMessages.clear();
+    store.GetByType(vchFromString("chat"), vMessages);
+    BOOST_CHECK_EQUAL(vMessages.size(), 2U);
+    vMessages.clear();
+    store.GetByType(std::vector<unsigned char>(), vMessages);
+    BOOST_CHECK_EQUAL(vMessages.size(), 3U);
+    vMessages.clear();
+    store.GetBySubjectAndSender(linkA, vchFromString("alice@public.bdap.io"), vchFromString("chat"), vMessages);
+    BOOST_CHECK_EQUAL(vMessages.size(), 1U);
+    vMessages.clear();
+    store.GetBySubjectAndSender(linkB, vchFromString("alice@public.bdap.io"), std::vector<unsigned char>(), vMessages);
+    BOOST_CHECK(vMessages.empty());
+
+    // Only the newest kept last message of a type from a sender stays
+    BOOST_CHECK(!store.Add(MakeStoreMessage(linkA, "status", "alice@public.bdap.io", true, nTime + 5)));
+    CVGPMessage newStatus = MakeStoreMessage(linkA, "status", "alice@public.bdap.io", true, nTime + 20);
+    BOOST_CHECK(store.Add(newStatus));
+    BOOST_CHECK_EQUAL(store.Size(), 3U);
+    vMessages.clear();
+    store.GetByType(vchFromString("status"), vMessages);
+    BOOST_REQUIRE_EQUAL(vMessages.size(), 1U);
+    BOOST_CHECK(vMessages[0].GetMsgHash() == newStatus.GetMsgHash());
+
+    // Kept last messages outlive the others
+    store.Expire(nTime + KEEP_MY_MESSAGE_ALIVE_SECONDS + 1);
+    BOOST_CHECK_EQUAL(store.Size(), 2U);
+    store.Expire(nTime + KEEP_MY_MESSAGE_ALIVE_SECONDS + 100);
+    BOOST_CHECK_EQUAL(store.Size(), 1U);
+    vMessages.clear();
+    store.GetBySubject(linkA, vMessages);
+    BOOST_REQUIRE_EQUAL(vMessages.size(), 1U);
+    BOOST_CHECK(vMessages[0].GetMsgHash() == newStatus.GetMsgHash());
+
+    // Spilled messages are read from the database
+    boost::filesystem::path pathSpill = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    BOOST_REQUIRE(store.StartSpill(pathSpill));
+    store.Expire(nTime + KEEP_MY_MESSAGE_ALIVE_SECONDS + 100);
+    BOOST_CHECK_EQUAL(store.Size(), 1U);
+    vMessages.clear();
+    store.GetByType(vchFromString("status"), vMessages);
+    BOOST_REQUIRE_EQUAL(vMessages.size(), 1U);
+    BOOST_CHECK(vMessages[0].GetMsgHash() == newStatus.GetMsgHash());
+    vMessages.clear();
+    store.GetBySubjectAndSender(linkA, vchFromString("alice@public.bdap.io"), vchFromString("status"), vMessages);
+    BOOST_REQUIRE_EQUAL(vMessages.size(), 1U);
+    BOOST_CHECK(vMessages[0].GetMsgHash() == newStatus.GetMsgHash());
+    store.Remove(newStatus.GetMsgHash());
+    BOOST_CHECK_EQUAL(store.Size(), 0U);
+    store.StopSpill();
+    boost::filesystem::remove_all(pathSpill);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
@@ -2,6 +2,9 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "crypto/argon2d/argon2.h"
+#include "crypto/argon2d_dispatch.h"
+#include "crypto/common.h"
 #include "crypto/ripemd160.h"
 #include "crypto/sha1.h"
 #include "crypto/sha256.h"
@@ -9,6 +12,7 @@
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
 
+#include "hash.h"
 #include "test_random.h"
 #include "utilstrencodings.h"
 #include "test/test_cash.h"
@@ -274,4 +278,46 @@ BOOST_AUTO_TEST_CASE(pbkdf2_hmac_sha512_test) {
     BOOST_CHECK(HexStr(k, k + 64) == "8c0511f4c6e597c6ac6315d8f0362e225f3c501495ba23b868c005174dc4ee71115b59f9e60cd9532fa33e0f75aefe30225c583a186cd82bd4daea9724a3d3b8");
 }
 
+BOOST_AUTO_TEST_CASE(argon2d_autodetect) {
+    // The runtime selected memory filling must match the build default for every phase
+    std::vector<unsigned char> header(INPUT_BYTES);
+    for (size_t i = 0; i < header.size(); i++)
+        header[i] = insecure_rand();
+
+    BOOST_CHECK(argon2_select_impl(Argon2_impl_native) == ARGON2_OK);
+    std::vector<uint256> vNative;
+    for (unsigned int nPhase = 0; nPhase < 3; nPhase++)
+        vNative.push_back(hash_Argon2d(header.begin(), header.end(), nPhase));
+
+    std::string strImpl = Argon2dAutoDetect();
+    BOOST_CHECK(strImpl == Argon2dImplementation());
+    for (unsigned int nPhase = 0; nPhase < 3; nPhase++)
+        BOOST_CHECK_MESSAGE(hash_Argon2d(header.begin(), header.end(), nPhase) == vNative[nPhase], strImpl);
+}
+
+BOOST_AUTO_TEST_CASE(argon2d_interleaved) {
+    // Interleaved hashing must give the same result as hashing each header on its own
+    std::vector<std::vector<unsigned char> > headers(ARGON2_MAX_INTERLEAVE, std::vector<unsigned char>(INPUT_BYTES));
+    for (size_t i = 0; i < headers[0].size(); i++)
+        headers[0][i] = insecure_rand();
+    for (size_t k = 1; k < headers.size(); k++) {
+        headers[k] = headers[0];
+        WriteLE32(&headers[k][INPUT_BYTES - 4], ReadLE32(&headers[0][INPUT_BYTES - 4]) + k);
+    }
+
+    const void* in[ARGON2_MAX_INTERLEAVE];
+    void* out[ARGON2_MAX_INTERLEAVE];
+    std::vector<uint256> hashes(ARGON2_MAX_INTERLEAVE);
+    for (uint32_t count = 1; count <= ARGON2_MAX_INTERLEAVE; count *= 2) {
+        for (uint32_t k = 0; k < count; k++) {
+            in[k] = headers[k].data();
+            out[k] = hashes[k].begin();
+        }
+        BOOST_CHECK(Argon2d_Phase_Hash_Multi<1>(in, INPUT_BYTES, out, count) == ARGON2_OK);
+        for (uint32_t k = 0; k < count; k++)
+            BOOST_CHECK(hashes[k] == hash_Argon2d<1>(headers[k].begin(), headers[k].end()));
+    }
+    BOOST_CHECK(Argon2d_Phase_Hash_Multi<1>(in, INPUT_BYTES, out, ARGON2_MAX_INTERLEAVE + 1) != ARGON2_OK);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
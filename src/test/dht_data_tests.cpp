@@ -19,6 +19,7 @@
 #include "dht/datarecord.h"
 #include "dht/dataheader.h"
 #include "dht/datachunk.h"
+#include "dht/mutabledb.h"
 
 #include <string>
 #include <stdint.h>
@@ -68,4 +69,70 @@ BOOST_AUTO_TEST_CASE(dht_data_test1)
 
 }
 
+BOOST_AUTO_TEST_CASE(dht_mutable_cache)
+{
+    const CharString targetA = vchFromString("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa");
+    const CharString targetB = vchFromString("bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb");
+    CMutableData dataA(vchFromString("61"), vchFromString("pubkey"), vchFromString("sig"), 1, vchFromString("salt"), vchFromString("value a"));
+    CMutableData dataB(vchFromString("62"), vchFromString("pubkey"), vchFromString("sig"), 1, vchFromString("salt"), vchFromString("value b"));
+
+    CMutableDataCache cache(1 << 20);
+    CMutableData data;
+    BOOST_CHECK(!cache.Get(targetA, data));
+    cache.Insert(targetA, dataA);
+    BOOST_CHECK(cache.Get(targetA, data));
+    BOOST_CHECK(data.vchValue == dataA.vchValue);
+    BOOST_CHECK_EQUAL(cache.GetHits(), 1U);
+    BOOST_CHECK_EQUAL(cache.GetMisses(), 1U);
+
+    // A newer sequence number replaces the item
+    dataA.SequenceNumber = 2;
+    cache.Insert(targetA, dataA);
+    BOOST_CHECK_EQUAL(cache.GetSize(), 1U);
+    BOOST_CHECK(cache.Get(targetA, data));
+    BOOST_CHECK_EQUAL(data.SequenceNumber, 2);
+    const size_t nItemUsage = cache.DynamicMemoryUsage();
+    cache.Erase(targetA);
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), 0U);
+
+    // The least recently used item goes first
+    CMutableDataCache smallCache(nItemUsage * 3 / 2);
+    smallCache.Insert(targetA, dataA);
+    smallCache.Insert(targetB, dataB);
+    BOOST_CHECK_EQUAL(smallCache.GetSize(), 1U);
+    BOOST_CHECK(!smallCache.Get(targetA, data));
+    BOOST_CHECK(smallCache.Get(targetB, data));
+    BOOST_CHECK(smallCache.DynamicMemoryUsage() <= nItemUsage * 3 / 2);
+}
+
+BOOST_AUTO_TEST_CASE(dht_mutable_put_newer)
+{
+    const CharString vchInfoHash = vchFromString("cccccccccccccccccccccccccccccccccccccccc");
+    CMutableData data(vchInfoHash, vchFromString("pubkey"), vchFromString("sig"), 2, vchFromString("salt"), vchFromString("value"));
+    CMutableData readData;
+    bool fNewer;
+
+    // Nothing is cached when the database write fails
+    BOOST_CHECK(!PutNewerMutableData(vchInfoHash, data, fNewer));
+    BOOST_CHECK(fNewer);
+    BOOST_CHECK(!GetCachedMutableData(vchInfoHash, readData));
+
+    pMutableDataDB = new CMutableDataDB(1 << 20, true, false, false);
+    BOOST_CHECK(PutNewerMutableData(vchInfoHash, data, fNewer));
+    BOOST_CHECK(fNewer);
+
+    // An older sequence number does not replace the stored item
+    CMutableData olderData(data);
+    olderData.SequenceNumber = 1;
+    olderData.vchValue = vchFromString("older value");
+    BOOST_CHECK(!PutNewerMutableData(vchInfoHash, olderData, fNewer));
+    BOOST_CHECK(!fNewer);
+    BOOST_CHECK(GetCachedMutableData(vchInfoHash, readData));
+    BOOST_CHECK_EQUAL(readData.SequenceNumber, 2);
+    BOOST_CHECK(readData.vchValue == data.vchValue);
+
+    delete pMutableDataDB;
+    pMutableDataDB = NULL;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
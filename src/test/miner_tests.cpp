@@ -11,6 +11,7 @@
 #include "validation.h"
 #include "masternode-payments.h"
 #include "miner/miner.h"
+#include "policy/policy.h"
 #include "pubkey.h"
 #include "script/standard.h"
 #include "txmempool.h"
@@ -114,6 +115,69 @@ BOOST_AUTO_TEST_CASE(ScanNoncesGPU_check)
 #endif //ENABLE_GPU
 
 
+// Test suite for ancestor feerate transaction selection.
+// Implemented as an additional function, rather than a separate test case,
+// to allow reusing the blockchain created in CreateNewBlock_validity.
+void TestPackageSelection(const CChainParams& chainparams, CScript scriptPubKey, std::vector<CTransactionRef>& txFirst)
+{
+    // Disable free transactions, otherwise TX selection is non-deterministic
+    ForceSetArg("-blockprioritysize", 0);
+
+    // Test that a medium fee transaction will be selected after a higher fee
+    // rate package with a low fee rate parent.
+    TestMemPoolEntryHelper entry;
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << OP_1;
+    tx.vin[0].prevout.hash = txFirst[0]->GetHash();
+    tx.vin[0].prevout.n = 0;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 49000000000LL - 100000;
+    // This tx has a low fee: 100000 satoshis
+    uint256 hashParentTx = tx.GetHash(); // save this txid for later use
+    mempool.addUnchecked(hashParentTx, entry.Fee(100000).Time(GetTime()).SpendsCoinbase(true).FromTx(tx));
+
+    // This tx has a medium fee: 1000000 satoshis
+    tx.vin[0].prevout.hash = txFirst[1]->GetHash();
+    tx.vout[0].nValue = 49000000000LL - 1000000;
+    uint256 hashMediumFeeTx = tx.GetHash();
+    mempool.addUnchecked(hashMediumFeeTx, entry.Fee(1000000).Time(GetTime()).SpendsCoinbase(true).FromTx(tx));
+
+    // This tx has a high fee, but depends on the first transaction
+    tx.vin[0].prevout.hash = hashParentTx;
+    tx.vout[0].nValue = 49000000000LL - 100000 - 5000000; // 5M satoshi fee
+    uint256 hashHighFeeTx = tx.GetHash();
+    mempool.addUnchecked(hashHighFeeTx, entry.Fee(5000000).Time(GetTime()).SpendsCoinbase(false).FromTx(tx));
+
+    std::unique_ptr<CBlockTemplate> pblocktemplate = CreateNewBlock(chainparams, scriptPubKey);
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 4);
+    BOOST_CHECK(pblocktemplate->block.vtx[1]->GetHash() == hashParentTx);
+    BOOST_CHECK(pblocktemplate->block.vtx[2]->GetHash() == hashHighFeeTx);
+    BOOST_CHECK(pblocktemplate->block.vtx[3]->GetHash() == hashMediumFeeTx);
+
+    // A transaction arriving later is appended to the existing template
+    tx.vin[0].prevout.hash = txFirst[2]->GetHash();
+    tx.vout[0].nValue = 49000000000LL - 2000000;
+    uint256 hashLateTx = tx.GetHash();
+    mempool.addUnchecked(hashLateTx, entry.Fee(2000000).Time(GetTime()).SpendsCoinbase(true).FromTx(tx));
+
+    std::unique_ptr<CBlockTemplate> pblocktemplateUpdated = UpdateBlockTemplate(chainparams, *pblocktemplate);
+    BOOST_CHECK(pblocktemplateUpdated);
+    BOOST_CHECK_EQUAL(pblocktemplateUpdated->block.vtx.size(), 5);
+    for (size_t i = 1; i < pblocktemplate->block.vtx.size(); i++)
+        BOOST_CHECK(pblocktemplateUpdated->block.vtx[i]->GetHash() == pblocktemplate->block.vtx[i]->GetHash());
+    BOOST_CHECK(pblocktemplateUpdated->block.vtx[4]->GetHash() == hashLateTx);
+    BOOST_CHECK_EQUAL(pblocktemplateUpdated->vTxFees[0], pblocktemplate->vTxFees[0] - 2000000);
+
+    // A template with a transaction that left the mempool has to be recreated
+    mempool.removeRecursive(*pblocktemplateUpdated->block.vtx[4]);
+    BOOST_CHECK(UpdateBlockTemplate(chainparams, *pblocktemplate));
+    BOOST_CHECK(!UpdateBlockTemplate(chainparams, *pblocktemplateUpdated));
+
+    mempool.clear();
+    ForceSetArg("-blockprioritysize", DEFAULT_BLOCK_PRIORITY_SIZE);
+}
+
 // NOTE: These tests rely on CreateNewBlock doing its own self-validation!
 BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
 {
@@ -167,6 +231,8 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     // Just to make sure we can still make simple blocks
     BOOST_CHECK(pblocktemplate = CreateNewBlock(chainparams, scriptPubKey));
 
+    TestPackageSelection(chainparams, scriptPubKey, txFirst);
+
     // block sigops > limit: 1000 CHECKMULTISIG + 1
     tx.vin.resize(1);
     // NOTE: OP_NOP is used to force 20 SigOps for the CHECKMULTISIG
@@ -4,8 +4,11 @@
 
 #include "chain.h"
 #include "chainparams.h"
+#include "hash.h"
 #include "pow.h"
+#include "primitives/block.h"
 #include "random.h"
+#include "streams.h"
 #include "util.h"
 #include "test/test_cash.h"
 
@@ -94,4 +97,84 @@ BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
     }
 }
 
+static uint256 UncachedHeaderHash(const CBlockHeader& header)
+{
+    CBlockHeader copy;
+    copy.nVersion = header.nVersion;
+    copy.hashPrevBlock = header.hashPrevBlock;
+    copy.hashMerkleRoot = header.hashMerkleRoot;
+    copy.nTime = header.nTime;
+    copy.nBits = header.nBits;
+    copy.nNonce = header.nNonce;
+    return copy.GetHash();
+}
+
+BOOST_AUTO_TEST_CASE(block_header_hash_cache)
+{
+    SelectParams(CBaseChainParams::MAIN);
+
+    CBlockHeader header;
+    header.nVersion = 1;
+    header.hashPrevBlock = GetRandHash();
+    header.hashMerkleRoot = GetRandHash();
+    header.nTime = 1408732505;
+    header.nBits = 0x1b1418d4;
+    header.nNonce = 42;
+
+    const uint256 hash = header.GetHash();
+    BOOST_CHECK(hash == header.GetHash());
+    BOOST_CHECK(hash == UncachedHeaderHash(header));
+
+    // Copies carry the cached hash, blocks built from the header too
+    CBlockHeader headerCopy(header);
+    BOOST_CHECK(hash == headerCopy.GetHash());
+    CBlock block(header);
+    BOOST_CHECK(hash == block.GetHash());
+    BOOST_CHECK(hash == block.GetBlockHeader().GetHash());
+
+    // Every header field invalidates the cached hash
+    header.nNonce++;
+    BOOST_CHECK(hash != header.GetHash());
+    BOOST_CHECK(header.GetHash() == UncachedHeaderHash(header));
+    header.nVersion++;
+    BOOST_CHECK(header.GetHash() == UncachedHeaderHash(header));
+    header.hashPrevBlock = GetRandHash();
+    BOOST_CHECK(header.GetHash() == UncachedHeaderHash(header));
+    header.hashMerkleRoot = GetRandHash();
+    BOOST_CHECK(header.GetHash() == UncachedHeaderHash(header));
+    header.nTime++;
+    BOOST_CHECK(header.GetHash() == UncachedHeaderHash(header));
+    header.nBits++;
+    BOOST_CHECK(header.GetHash() == UncachedHeaderHash(header));
+
+    // Deserializing into a header with a stale cache must not return the old hash
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << header;
+    ss >> headerCopy;
+    BOOST_CHECK(headerCopy.GetHash() == header.GetHash());
+    BOOST_CHECK(headerCopy.GetHash() != hash);
+}
+
+BOOST_AUTO_TEST_CASE(argon2d_phase_selection)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    const CChainParams& params = Params();
+    BOOST_CHECK_EQUAL(GetArgon2dPhase(params.FirstArgon2SwitchTime() - 1), 0U);
+    BOOST_CHECK_EQUAL(GetArgon2dPhase(params.FirstArgon2SwitchTime()), 1U);
+    BOOST_CHECK_EQUAL(GetArgon2dPhase(params.SecondArgon2SwitchTime() - 1), 1U);
+    BOOST_CHECK_EQUAL(GetArgon2dPhase(params.SecondArgon2SwitchTime()), 2U);
+
+    // Headers hash with the phase of their own time
+    CBlockHeader header;
+    header.nTime = params.FirstArgon2SwitchTime();
+    std::vector<unsigned char> vchHeader(BEGIN(header.nVersion), END(header.nNonce));
+    BOOST_CHECK(header.GetHash() == hash_Argon2d<1>(vchHeader.begin(), vchHeader.end()));
+    BOOST_CHECK(header.GetHash() == hash_Argon2d(vchHeader.begin(), vchHeader.end(), 1));
+
+    // Selecting another chain switches the cached switch times
+    SelectParams(CBaseChainParams::REGTEST);
+    BOOST_CHECK_EQUAL(GetArgon2dPhase(params.FirstArgon2SwitchTime()), 0U);
+    SelectParams(CBaseChainParams::MAIN);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
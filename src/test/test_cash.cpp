@@ -10,6 +10,7 @@
 #include "chainparams.h"
 #include "consensus/consensus.h"
 #include "consensus/validation.h"
+#include "crypto/argon2d_dispatch.h"
 #include "key.h"
 #include "validation.h"
 #include "miner/miner.h"
@@ -45,6 +46,7 @@ extern void noui_connect();
 BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
 {
         RandomInit();
+        Argon2dAutoDetect();
         ECC_Start();
         ECC_Start_Stealth();
         SetupEnvironment();
@@ -16,6 +16,7 @@
 #include <vector>
 
 #include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
 
 extern std::map<std::string, std::string> mapArgs;
 
@@ -595,4 +596,15 @@ BOOST_AUTO_TEST_CASE(version_info_helper)
     BOOST_CHECK_THROW(IntVersionToString(0), std::bad_cast);
 }
 
+BOOST_AUTO_TEST_CASE(util_SetThreadAffinity)
+{
+#ifdef __linux__
+    // Pin a thread of its own, threads started by later tests would inherit the affinity
+    bool fPinned = false;
+    boost::thread thread([&fPinned] { fPinned = SetThreadAffinity(GetNumCores() + 1); });
+    thread.join();
+    BOOST_CHECK(fPinned);
+#endif
+}
+
 BOOST_AUTO_TEST_SUITE_END()
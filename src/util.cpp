@@ -41,6 +41,9 @@
 
 #include <algorithm>
 #include <fcntl.h>
+#ifdef __linux__
+#include <sched.h> // for sched_setaffinity
+#endif
 #include <sys/resource.h>
 #include <sys/stat.h>
 
@@ -985,6 +988,60 @@ void SetThreadPriority(int nPriority)
 #endif // WIN32
 }
 
+bool SetThreadAffinity(int nIndex)
+{
+#ifdef WIN32
+    DWORD_PTR processMask, systemMask;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask) || processMask == 0)
+        return false;
+    std::vector<DWORD_PTR> vMasks;
+    for (unsigned int i = 0; i < sizeof(DWORD_PTR) * 8; i++) {
+        if (processMask & ((DWORD_PTR)1 << i))
+            vMasks.push_back((DWORD_PTR)1 << i);
+    }
+    return SetThreadAffinityMask(GetCurrentThread(), vMasks[(size_t)nIndex % vMasks.size()]) != 0;
+#elif defined(__linux__)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0)
+        return false;
+    std::vector<int> vCpus;
+    for (int i = 0; i < CPU_SETSIZE; i++) {
+        if (CPU_ISSET(i, &allowed))
+            vCpus.push_back(i);
+    }
+    cpu_set_t target;
+    CPU_ZERO(&target);
+    CPU_SET(vCpus[(size_t)nIndex % vCpus.size()], &target);
+    // On Linux a pid of 0 is the calling thread, not the whole process
+    return sched_setaffinity(0, sizeof(target), &target) == 0;
+#else
+    (void)nIndex;
+    return false;
+#endif
+}
+
+int GetNumAffinityProcessors()
+{
+#ifdef WIN32
+    DWORD_PTR processMask, systemMask;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask) && processMask != 0) {
+        int nCount = 0;
+        for (unsigned int i = 0; i < sizeof(DWORD_PTR) * 8; i++) {
+            if (processMask & ((DWORD_PTR)1 << i))
+                nCount++;
+        }
+        return nCount;
+    }
+#elif defined(__linux__)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0 && CPU_COUNT(&allowed) > 0)
+        return CPU_COUNT(&allowed);
+#endif
+    return boost::thread::hardware_concurrency();
+}
+
 int GetNumCores()
 {
 #if BOOST_VERSION >= 105600
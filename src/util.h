@@ -250,6 +250,17 @@ std::string HelpMessageOpt(const std::string& option, const std::string& message
 int GetNumCores();
 
 void SetThreadPriority(int nPriority);
+/**
+ * Pin the calling thread to one processor: the nIndex'th (modulo their count)
+ * of the processors the process may run on.
+ * @return false if pinning is not supported on this platform or failed
+ */
+bool SetThreadAffinity(int nIndex);
+/**
+ * Return the number of logical processors the process may run on, the ones
+ * SetThreadAffinity pins to. Falls back to all logical processors.
+ */
+int GetNumAffinityProcessors();
 void RenameThread(const char* name);
 std::string GetThreadName();
 
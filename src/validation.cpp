@@ -95,6 +95,7 @@ std::condition_variable g_best_block_cv;
 uint256 g_best_block;
 std::map<unsigned int, unsigned int> mapHashedBlocks;
 int nScriptCheckThreads = 0;
+int nHeaderVerifyThreads = 0;
 std::atomic_bool fImporting(false);
 bool fReindex = false;
 bool fTxIndex = true;
@@ -809,7 +810,7 @@ static bool IsCurrentForFeeEstimation()
 }
 
 // Check if BDAP entry is valid
-bool ValidateBDAPInputs(const CTransactionRef& tx, CValidationState& state, const CCoinsViewCache& inputs, const CBlock& block, bool fJustCheck, int nHeight, bool bSanity)
+bool ValidateBDAPInputs(const CTransactionRef& tx, CValidationState& state, const CCoinsViewCache& inputs, const CBlock& block, bool fJustCheck, int nHeight, bool bSanity, bool fPreChecked)
 {
     if (!CheckDomainEntryDB())
         return true;
@@ -893,7 +894,7 @@ bool ValidateBDAPInputs(const CTransactionRef& tx, CValidationState& state, cons
                 return true;
             }
             else if (strOpType == "bdap_new_audit") {
-                bValid = CheckAuditTx(tx, scriptOp, op1, op2, vvchBDAPArgs, fJustCheck, nHeight, block.nTime, bSanity, errorMessage);
+                bValid = CheckAuditTx(tx, scriptOp, op1, op2, vvchBDAPArgs, fJustCheck, nHeight, block.nTime, bSanity, errorMessage, fPreChecked);
                 if (!bValid) {
                     errorMessage = "ValidateBDAPInputs: " + errorMessage;
                     return state.DoS(100, false, REJECT_INVALID, errorMessage);
@@ -904,7 +905,7 @@ bool ValidateBDAPInputs(const CTransactionRef& tx, CValidationState& state, cons
                 return true;
             }
             else if (strOpType == "bdap_new_certificate" || strOpType == "bdap_approve_certificate") {
-                bValid = CheckCertificateTx(tx, scriptOp, op1, op2, vvchBDAPArgs, fJustCheck, nHeight, block.nTime, bSanity, errorMessage);
+                bValid = CheckCertificateTx(tx, scriptOp, op1, op2, vvchBDAPArgs, fJustCheck, nHeight, block.nTime, bSanity, errorMessage, fPreChecked);
                 if (!bValid) {
                     errorMessage = "ValidateBDAPInputs: " + errorMessage;
                     return state.DoS(100, false, REJECT_INVALID, errorMessage);
@@ -1941,6 +1942,44 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+{
+    // The block is preceded by the network magic and its size, see WriteBlockToDisk
+    CDiskBlockPos hpos = pos;
+    if (hpos.nPos < CMessageHeader::MESSAGE_START_SIZE + sizeof(unsigned int))
+        return error("ReadRawBlockFromDisk: Invalid position %s", pos.ToString());
+    hpos.nPos -= CMessageHeader::MESSAGE_START_SIZE + sizeof(unsigned int);
+
+    // Open history file to read
+    CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("ReadRawBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+
+    try {
+        CMessageHeader::MessageStartChars blkStart;
+        unsigned int nSize;
+        filein >> FLATDATA(blkStart) >> nSize;
+
+        if (memcmp(blkStart, messageStart, CMessageHeader::MESSAGE_START_SIZE))
+            return error("ReadRawBlockFromDisk: Block magic mismatch for %s", pos.ToString());
+
+        if (nSize > MAX_BLOCK_SIZE)
+            return error("ReadRawBlockFromDisk: Block data is larger than maximum deserialization size for %s: %u", pos.ToString(), nSize);
+
+        block.resize(nSize);
+        filein >> REF(CFlatData(block));
+    } catch (const std::exception& e) {
+        return error("%s: Read from block file failed - %s at %s", __func__, e.what(), pos.ToString());
+    }
+
+    return true;
+}
+
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart)
+{
+    return ReadRawBlockFromDisk(block, pindex->GetBlockPos(), messageStart);
+}
+
 bool IsInitialBlockDownload()
 {
     // Once this function has returned false, it must remain false.
@@ -2323,6 +2362,69 @@ int ApplyTxInUndo(Coin&& undo, CCoinsViewCache& view, const COutPoint& out)
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
 
+// The BDAP databases, whose changes while a block connects are staged and
+// committed in one batch per database with the undo record of the block
+static std::vector<CBDAPDB*> GetBDAPDatabases()
+{
+    std::vector<CBDAPDB*> vDatabases;
+    if (pDomainEntryDB)
+        vDatabases.push_back(pDomainEntryDB);
+    if (pLinkDB)
+        vDatabases.push_back(pLinkDB);
+    if (pAuditDB)
+        vDatabases.push_back(pAuditDB);
+    if (pCertificateDB)
+        vDatabases.push_back(pCertificateDB);
+    return vDatabases;
+}
+
+/** Stages the BDAP database changes of one block, dropping them unless committed */
+class CBDAPBlockStage
+{
+private:
+    std::vector<CBDAPDB*> vDatabases;
+
+public:
+    ~CBDAPBlockStage()
+    {
+        for (CBDAPDB* pdb : vDatabases)
+            pdb->AbortBlock();
+    }
+
+    void Begin(const CBDAPBlock& block)
+    {
+        vDatabases = GetBDAPDatabases();
+        for (CBDAPDB* pdb : vDatabases)
+            pdb->BeginBlock(block);
+    }
+
+    bool Commit()
+    {
+        bool fResult = true;
+        for (CBDAPDB* pdb : vDatabases) {
+            if (!pdb->CommitBlock())
+                fResult = false;
+        }
+        vDatabases.clear();
+        return fResult;
+    }
+};
+
+// Undo the BDAP changes of a block from the undo records of the databases.
+// fFound is false if none has a record, for blocks connected before they were kept.
+static bool DisconnectBDAPBlock(const CBDAPBlock& block, bool& fFound)
+{
+    fFound = false;
+    bool fResult = true;
+    for (CBDAPDB* pdb : GetBDAPDatabases()) {
+        bool fDatabaseFound = false;
+        if (!pdb->DisconnectBlock(block, fDatabaseFound))
+            fResult = false;
+        fFound |= fDatabaseFound;
+    }
+    return fResult;
+}
+
 /** Undo the effects of this block (with given index) on the UTXO set represented by coins.
  *  When UNCLEAN or FAILED is returned, view is left in an indeterminate state. */
 static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockIndex* pindex, CCoinsViewCache& view, int nCheckLevel)
@@ -2350,13 +2452,19 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
     std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
 
+    bool fBDAPUndone = false;
+    if (!fReindex && nCheckLevel >= 4 && !DisconnectBDAPBlock(CBDAPBlock(pindex->nHeight, pindex->GetBlockHash()), fBDAPUndone)) {
+        error("DisconnectBlock(): failure undoing BDAP database changes");
+        fClean = false;
+    }
+
     // undo transactions in reverse order
     for (int i = block.vtx.size() - 1; i >= 0; i--) {
         const CTransaction& tx = *block.vtx[i];
         uint256 hash = tx.GetHash();
         bool is_coinbase = tx.IsCoinBase();
         bool fIsBDAP = tx.nVersion == BDAP_TX_VERSION;
-        if (fIsBDAP && !fReindex && nCheckLevel >= 4) {
+        if (fIsBDAP && !fReindex && nCheckLevel >= 4 && !fBDAPUndone) {
             LogPrintf("%s -- BDAP tx found. Hash %s\n", __func__, hash.ToString());
             // get BDAP object
             CScript scriptBDAPOp;
@@ -2591,6 +2699,52 @@ void ThreadScriptCheck()
     scriptcheckqueue.Thread();
 }
 
+// Argon2d hashes are expensive, so hand them out to the workers in small batches
+static CCheckQueue<CHeaderHashCheck> headerhashcheckqueue(8);
+
+void ThreadHeaderVerify()
+{
+    RenameThread("cash-headerver");
+    headerhashcheckqueue.Thread();
+}
+
+bool CHeaderHashCheck::operator()()
+{
+    pheader->GetHash();
+    return true;
+}
+
+static CCheckQueue<CBDAPCheck> bdapcheckqueue(16);
+
+void ThreadBDAPCheck()
+{
+    RenameThread("cash-bdapcheck");
+    bdapcheckqueue.Thread();
+}
+
+bool CBDAPCheck::operator()()
+{
+    std::vector<std::vector<unsigned char> > vvchBDAPArgs;
+    int op1 = -1;
+    int op2 = -1;
+    CScript scriptOp;
+    if (!GetBDAPOpScript(ptx, scriptOp, vvchBDAPArgs, op1, op2))
+        return true;
+
+    std::string strOpType = GetBDAPOpTypeString(op1, op2);
+    if (strOpType == "bdap_new_audit")
+        presult->fValid = PreCheckAuditTx(ptx, vvchBDAPArgs, nHeight, presult->vvchObjectPaths, presult->strError);
+    else if (strOpType == "bdap_new_certificate" || strOpType == "bdap_approve_certificate")
+        presult->fValid = PreCheckCertificateTx(ptx, nHeight, presult->vvchObjectPaths, presult->strError);
+    else
+        return true;
+
+    presult->fChecked = true;
+    // A failed check only invalidates the block once ConnectBlock knows it
+    // did not read an account an earlier operation changes
+    return true;
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -2775,6 +2929,51 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
     std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
 
+    // BDAP database changes of the block are read back from memory until the
+    // whole block is valid, then written at once
+    CBDAPBlockStage bdapStage;
+    if (!fJustCheck)
+        bdapStage.Begin(CBDAPBlock(pindex->nHeight, block.GetHash()));
+
+    // Run the signature and certificate checks of the audits and certificates
+    // of the block on the BDAP check threads against the databases before the
+    // block. The accounts changed by the block are kept with the first
+    // operation changing them, a check that read one of them after that
+    // operation is run again in block order.
+    std::vector<CBDAPCheckResult> vBDAPCheckResults;
+    std::map<std::vector<unsigned char>, unsigned int> mapBDAPAccountChanges;
+    if (!fJustCheck && nScriptCheckThreads && CheckDomainEntryDB()) {
+        int64_t nTimeBDAPStart = GetTimeMicros();
+        vBDAPCheckResults.resize(block.vtx.size());
+        std::vector<CBDAPCheck> vBDAPChecks;
+        for (unsigned int i = 0; i < block.vtx.size(); i++) {
+            const CTransactionRef& ptx = block.vtx[i];
+            if (ptx->nVersion != BDAP_TX_VERSION || ptx->IsCoinBase())
+                continue;
+            std::vector<std::vector<unsigned char> > vvchBDAPArgs;
+            int op1 = -1;
+            int op2 = -1;
+            CScript scriptOp;
+            if (!GetBDAPOpScript(ptx, scriptOp, vvchBDAPArgs, op1, op2))
+                continue;
+            std::string strOpType = GetBDAPOpTypeString(op1, op2);
+            if (strOpType == "bdap_new_account" || strOpType == "bdap_update_account" || strOpType == "bdap_delete_account") {
+                if (vvchBDAPArgs.size() > 0)
+                    mapBDAPAccountChanges.emplace(vvchBDAPArgs[0], i);
+            }
+            else if (strOpType == "bdap_new_audit" || strOpType == "bdap_new_certificate" || strOpType == "bdap_approve_certificate") {
+                vBDAPChecks.push_back(CBDAPCheck(ptx, pindex->nHeight, vBDAPCheckResults[i]));
+            }
+        }
+        if (!vBDAPChecks.empty()) {
+            size_t nBDAPChecks = vBDAPChecks.size();
+            CCheckQueueControl<CBDAPCheck> bdapControl(&bdapcheckqueue);
+            bdapControl.Add(vBDAPChecks);
+            bdapControl.Wait();
+            LogPrint("bench", "    - BDAP checks: %u [%.2fms]\n", (unsigned int)nBDAPChecks, 0.001 * (GetTimeMicros() - nTimeBDAPStart));
+        }
+    }
+
     for (unsigned int i = 0; i < block.vtx.size(); i++) {
         const CTransaction& tx = *block.vtx[i];
         const uint256 txhash = tx.GetHash();
@@ -2897,11 +3096,26 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
             }
         }
 
-        CCoinsViewCache viewCoinCache(pcoinsTip);
-        CTransactionRef ptx = MakeTransactionRef(tx);
-
-        if (tx.nVersion == BDAP_TX_VERSION && !ValidateBDAPInputs(ptx, state, viewCoinCache, block, fJustCheck, pindex->nHeight)) {
-            return error("ConnectBlock(): ValidateBDAPInputs on block %s failed\n", block.GetHash().ToString());
+        if (tx.nVersion == BDAP_TX_VERSION) {
+            bool fBDAPPreChecked = false;
+            if (i < vBDAPCheckResults.size() && vBDAPCheckResults[i].fChecked) {
+                const CBDAPCheckResult& result = vBDAPCheckResults[i];
+                fBDAPPreChecked = true;
+                for (const std::vector<unsigned char>& vchObjectPath : result.vvchObjectPaths) {
+                    std::map<std::vector<unsigned char>, unsigned int>::const_iterator it = mapBDAPAccountChanges.find(vchObjectPath);
+                    if (it != mapBDAPAccountChanges.end() && it->second < i) {
+                        fBDAPPreChecked = false;
+                        break;
+                    }
+                }
+                if (fBDAPPreChecked && !result.fValid) {
+                    state.DoS(100, false, REJECT_INVALID, "ValidateBDAPInputs: " + result.strError);
+                    return error("ConnectBlock(): ValidateBDAPInputs on block %s failed\n", block.GetHash().ToString());
+                }
+            }
+            CCoinsViewCache viewCoinCache(pcoinsTip);
+            if (!ValidateBDAPInputs(block.vtx[i], state, viewCoinCache, block, fJustCheck, pindex->nHeight, false, fBDAPPreChecked))
+                return error("ConnectBlock(): ValidateBDAPInputs on block %s failed\n", block.GetHash().ToString());
         }
 
         CTxUndo undoDummy;
@@ -3046,6 +3260,17 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     if (fJustCheck)
         return true;
 
+    // Expired BDAP entries are removed as part of the block, so every node
+    // removes the same ones and disconnecting the block restores them
+    int nExpiredRemoved = 0;
+    if (pDomainEntryDB && !pDomainEntryDB->RemoveExpired(pindex->GetMedianTimePast(), std::numeric_limits<unsigned int>::max(), nExpiredRemoved))
+        return AbortNode(state, "Failed to remove expired BDAP entries");
+    if (nExpiredRemoved > 0)
+        LogPrint("bdap", "%s -- Removed %d expired BDAP entries at height %d\n", __func__, nExpiredRemoved, pindex->nHeight);
+
+    if (!bdapStage.Commit())
+        return AbortNode(state, "Failed to write BDAP database changes");
+
     // Write undo information to disk
     if (pindex->GetUndoPos().IsNull() || !pindex->IsValid(BLOCK_VALID_SCRIPTS)) {
         if (pindex->GetUndoPos().IsNull()) {
@@ -3202,9 +3427,23 @@ bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode, int n
             // overwrite one. Still, use a conservative safety factor of 2.
             if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
                 return state.Error("out of disk space");
+            // Sync the BDAP databases first, so that the chainstate on disk
+            // never has a tip whose BDAP changes could still be lost.
+            for (CBDAPDB* pdb : GetBDAPDatabases()) {
+                if (!pdb->Sync())
+                    return AbortNode(state, "Failed to write to BDAP database");
+            }
             // Flush the chainstate (which may refer to block index entries).
             if (!pcoinsTip->Flush())
                 return AbortNode(state, "Failed to write to coin database");
+            // BDAP undo and redo records are only kept as deep as block undo data,
+            // counted from the tip of the chainstate now on disk
+            if (chainActive.Height() > (int)MIN_BLOCKS_TO_KEEP) {
+                for (CBDAPDB* pdb : GetBDAPDatabases()) {
+                    if (!pdb->PruneUndo(chainActive.Height() - MIN_BLOCKS_TO_KEEP))
+                        return AbortNode(state, "Failed to write to BDAP database");
+                }
+            }
             nLastFlush = nNow;
         }
         if (fDoFullFlush || ((mode == FLUSH_STATE_ALWAYS || mode == FLUSH_STATE_PERIODIC) && nNow > nLastSetChain + (int64_t)DATABASE_WRITE_INTERVAL * 1000000)) {
@@ -4314,9 +4553,25 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
     return true;
 }
 
+void PrecomputeHeaderHashes(const std::vector<CBlockHeader>& headers)
+{
+    if (!nHeaderVerifyThreads || headers.size() < 2)
+        return;
+
+    std::vector<CHeaderHashCheck> vChecks;
+    vChecks.reserve(headers.size());
+    for (const CBlockHeader& header : headers)
+        vChecks.push_back(CHeaderHashCheck(header));
+
+    CCheckQueueControl<CHeaderHashCheck> control(&headerhashcheckqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
+
 // Exposed wrapper for AcceptBlockHeader
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex)
 {
+    PrecomputeHeaderHashes(headers);
     {
         LOCK(cs_main);
         for (const CBlockHeader& header : headers) {
@@ -4960,6 +5215,16 @@ static bool AddGenesisBlock(const CChainParams& chainparams, const CBlock& block
 }
 
 
+bool SyncBDAPDatabases()
+{
+    LOCK(cs_main);
+    for (CBDAPDB* pdb : GetBDAPDatabases()) {
+        if (!pdb->SyncToChain(chainActive))
+            return false;
+    }
+    return true;
+}
+
 bool InitBlockIndex(const CChainParams& chainparams)
 {
     LOCK(cs_main);
@@ -90,6 +90,10 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x600000; // 6 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 64;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of header proof-of-work hashing threads allowed */
+static const int MAX_HEADERVERIFY_THREADS = 64;
+/** -headerverifythreads default (number of header proof-of-work hashing threads, 0 = auto) */
+static const int DEFAULT_HEADERVERIFY_THREADS = 0;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 96;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -185,6 +189,7 @@ extern uint256 g_best_block;
 extern std::atomic_bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
+extern int nHeaderVerifyThreads;
 extern bool fTxIndex;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
@@ -264,6 +269,14 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
  */
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& block, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex = NULL);
 
+/**
+ * Compute the Argon2d proof-of-work hashes of a batch of headers on the header
+ * verification threads. The hashes are cached in the headers themselves, so the
+ * linkage checks and AcceptBlockHeader that follow in order on the calling
+ * thread no longer pay for them. Does nothing without -headerverifythreads.
+ */
+void PrecomputeHeaderHashes(const std::vector<CBlockHeader>& headers);
+
 /** Check whether enough disk space is available for an incoming block */
 bool CheckDiskSpace(uint64_t nAdditionalBytes = 0);
 /** Open a block file (blk?????.dat) */
@@ -280,8 +293,14 @@ bool InitBlockIndex(const CChainParams& chainparams);
 bool LoadBlockIndex(const CChainParams& chainparams);
 /** Unload database information */
 void UnloadBlockIndex();
+/** Undo or redo the BDAP database changes of blocks the chainstate on disk does not or does hold, after an unclean shutdown */
+bool SyncBDAPDatabases();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the header proof-of-work hashing thread */
+void ThreadHeaderVerify();
+/** Run an instance of the BDAP operation checking thread */
+void ThreadBDAPCheck();
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Format a string that describes several potential problems detected by the core.
@@ -337,7 +356,7 @@ void PruneAndFlush();
 void PruneBlockFilesManual(int nPruneUpToHeight);
 
 /** Checks inputs for a BDAP transaction. */
-bool ValidateBDAPInputs(const CTransactionRef& tx, CValidationState& state, const CCoinsViewCache& inputs, const CBlock& block, bool fJustCheck, int nHeight, bool bSanity = false);
+bool ValidateBDAPInputs(const CTransactionRef& tx, CValidationState& state, const CCoinsViewCache& inputs, const CBlock& block, bool fJustCheck, int nHeight, bool bSanity = false, bool fPreChecked = false);
 /** (try to) add transaction to memory pool
  * plTxnReplaced will be appended to with all transactions replaced from mempool **/
 
@@ -482,6 +501,67 @@ public:
     ScriptError GetScriptError() const { return error; }
 };
 
+/**
+ * Closure representing the proof-of-work hash of one header, computed on a
+ * header verification thread so that it ends up cached in the header.
+ */
+class CHeaderHashCheck
+{
+private:
+    const CBlockHeader* pheader;
+
+public:
+    CHeaderHashCheck() : pheader(NULL) {}
+    CHeaderHashCheck(const CBlockHeader& headerIn) : pheader(&headerIn) {}
+
+    bool operator()();
+
+    void swap(CHeaderHashCheck& check)
+    {
+        std::swap(pheader, check.pheader);
+    }
+};
+
+/** Outcome of the checks a CBDAPCheck ran on one BDAP operation */
+struct CBDAPCheckResult
+{
+    bool fChecked;
+    bool fValid;
+    std::string strError;
+    //! Accounts the checks read
+    std::vector<std::vector<unsigned char> > vvchObjectPaths;
+
+    CBDAPCheckResult() : fChecked(false), fValid(false) {}
+};
+
+/**
+ * Closure representing the signature and certificate checks of one audit or
+ * certificate operation in a block. They only read the BDAP databases, so they
+ * run on the BDAP check threads against the databases as they were before the
+ * block. The result only stands when no earlier operation in the block changes
+ * one of the accounts it read.
+ */
+class CBDAPCheck
+{
+private:
+    CTransactionRef ptx;
+    int nHeight;
+    CBDAPCheckResult* presult;
+
+public:
+    CBDAPCheck() : nHeight(0), presult(NULL) {}
+    CBDAPCheck(const CTransactionRef& ptxIn, int nHeightIn, CBDAPCheckResult& resultIn) : ptx(ptxIn), nHeight(nHeightIn), presult(&resultIn) {}
+
+    bool operator()();
+
+    void swap(CBDAPCheck& check)
+    {
+        ptx.swap(check.ptx);
+        std::swap(nHeight, check.nHeight);
+        std::swap(presult, check.presult);
+    }
+};
+
 bool GetTimestampIndex(const unsigned int& high, const unsigned int& low, std::vector<uint256>& hashes);
 bool GetSpentIndex(CSpentIndexKey& key, CSpentIndexValue& value);
 bool GetAddressIndex(uint160 addressHash, int type, std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex, int start = 0, int end = 0);
@@ -491,6 +571,13 @@ bool GetAddressUnspent(uint160 addressHash, int type, std::vector<std::pair<CAdd
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/**
+ * Read the serialized block at pos straight from its block file, without
+ * deserializing it or checking its proof of work. The pindex variant trusts
+ * the block index, so only use it for blocks that have been validated before.
+ */
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -439,6 +439,7 @@ bool CWallet::AddDHTKey(const CKeyEd25519& key, const std::vector<unsigned char>
     if (!CCryptoKeyStore::AddDHTKey(key, pubkey)) {
         return false;
     }
+    ClearLinkSharedKeys();
 
     if (!fFileBacked)
         return true;
@@ -458,6 +459,7 @@ bool CWallet::AddCryptedDHTKey(const std::vector<unsigned char>& vchPubKey, cons
         LogPrint("dht", "CWallet::AddCryptedDHTKey AddCryptedDHTKey failed.\n");
         return false;
     }
+    ClearLinkSharedKeys();
     if (!fFileBacked)
         return true;
     {
@@ -506,9 +508,20 @@ bool CWallet::LoadCryptedKey(const CPubKey& vchPubKey, const std::vector<unsigne
     return CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret);
 }
 
+bool CWallet::LoadDHTKey(const CKeyEd25519& key, const std::vector<unsigned char>& pubkey)
+{
+    if (!CCryptoKeyStore::AddDHTKey(key, pubkey))
+        return false;
+    ClearLinkSharedKeys();
+    return true;
+}
+
 bool CWallet::LoadCryptedDHTKey(const std::vector<unsigned char>& vchPubKey, const std::vector<unsigned char>& vchCryptedSecret)
 {
-    return CCryptoKeyStore::AddCryptedDHTKey(vchPubKey, vchCryptedSecret);
+    if (!CCryptoKeyStore::AddCryptedDHTKey(vchPubKey, vchCryptedSecret))
+        return false;
+    ClearLinkSharedKeys();
+    return true;
 }
 
 void CWallet::UpdateTimeFirstKey(int64_t nCreateTime)
@@ -1905,6 +1918,53 @@ bool CWallet::GetDHTPubKeys(std::vector<std::vector<unsigned char>>& vvchDHTPubK
     return CBasicKeyStore::GetDHTPubKeys(vvchDHTPubKeys);
 }
 
+void CWallet::ClearLinkSharedKeys()
+{
+    LOCK(cs_linksharedkeys);
+    mapLinkSharedKeys.clear();
+    setLinkSharedKeysDerived.clear();
+}
+
+bool CWallet::GetLinkSharedKey(const std::vector<unsigned char>& vchLinkPubKey, const std::vector<unsigned char>& vchSharedPubKey, CKeyID& keyIDOut, std::vector<unsigned char>& vchMyPubKeyOut)
+{
+    // The key store calls ClearLinkSharedKeys while holding cs_KeyStore, so take it first
+    LOCK2(cs_KeyStore, cs_linksharedkeys);
+    if (setLinkSharedKeysDerived.count(vchLinkPubKey) == 0) {
+        if (setLinkSharedKeysDerived.size() >= MAX_LINK_SHARED_KEY_LINKS) {
+            mapLinkSharedKeys.clear();
+            setLinkSharedKeysDerived.clear();
+        }
+        std::vector<std::vector<unsigned char>> vvchMyDHTPubKeys;
+        if (!GetDHTPubKeys(vvchMyDHTPubKeys))
+            return false;
+
+        bool fAllKeys = true;
+        for (const std::vector<unsigned char>& vchMyDHTPubKey : vvchMyDHTPubKeys) {
+            CKeyID keyID(Hash160(vchMyDHTPubKey.begin(), vchMyDHTPubKey.end()));
+            CKeyEd25519 dhtKey;
+            if (!GetDHTKey(keyID, dhtKey)) {
+                fAllKeys = false;
+                continue;
+            }
+            CLinkSharedKey& sharedKey = mapLinkSharedKeys[GetLinkSharedPubKey(dhtKey, vchLinkPubKey)];
+            sharedKey.keyID = keyID;
+            sharedKey.vchMyPubKey = vchMyDHTPubKey;
+            sharedKey.vchLinkPubKey = vchLinkPubKey;
+        }
+        // Keys of a locked wallet are derived again once it is unlocked
+        if (fAllKeys)
+            setLinkSharedKeysDerived.insert(vchLinkPubKey);
+    }
+
+    std::map<std::vector<unsigned char>, CLinkSharedKey>::const_iterator it = mapLinkSharedKeys.find(vchSharedPubKey);
+    if (it == mapLinkSharedKeys.end() || it->second.vchLinkPubKey != vchLinkPubKey)
+        return false;
+
+    keyIDOut = it->second.keyID;
+    vchMyPubKeyOut = it->second.vchMyPubKey;
+    return true;
+}
+
 bool CWallet::WriteLinkMessageInfo(const uint256& subjectID, const std::vector<unsigned char>& vchPubKey)
 {
     CWalletDB walletdb(strWalletFile);
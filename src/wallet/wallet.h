@@ -82,6 +82,9 @@ extern const char* DEFAULT_WALLET_DAT_MNEMONIC;
 //! if set, all keys will be derived by using BIP32
 static const bool DEFAULT_USE_HD_WALLET = true;
 
+//! Link pubkeys the shared link key cache derives shared pubkeys for before it starts over
+static const unsigned int MAX_LINK_SHARED_KEY_LINKS = 10000;
+
 bool AutoBackupWallet(CWallet* wallet, std::string strWalletFile, std::string& strBackupWarning, std::string& strBackupError);
 
 class CAccountingEntry;
@@ -812,6 +815,23 @@ private:
 
     std::vector<std::vector<unsigned char>> reservedEd25519PubKeys;
 
+    /** A shared link pubkey derived from one of our DHT keys and a link pubkey */
+    struct CLinkSharedKey
+    {
+        CKeyID keyID;
+        std::vector<unsigned char> vchMyPubKey;
+        std::vector<unsigned char> vchLinkPubKey;
+    };
+
+    //! Lock order: cs_KeyStore before cs_linksharedkeys
+    mutable CCriticalSection cs_linksharedkeys;
+    //! Shared link pubkeys of every DHT key with each link pubkey in setLinkSharedKeysDerived
+    std::map<std::vector<unsigned char>, CLinkSharedKey> mapLinkSharedKeys;
+    std::set<std::vector<unsigned char>> setLinkSharedKeysDerived;
+
+    //! Drop the shared link keys after the DHT keys changed
+    void ClearLinkSharedKeys();
+
     int64_t nTimeFirstKey;
 
     /**
@@ -1060,7 +1080,7 @@ public:
     //! Adds a key to the store, without saving it to disk (used by LoadWallet)
     bool LoadKey(const CKey& key, const CPubKey& pubkey) { return CCryptoKeyStore::AddKeyPubKey(key, pubkey); }
     //! Adds a key to the store, without saving it to disk (used by LoadWallet)
-    bool LoadDHTKey(const CKeyEd25519& key, const std::vector<unsigned char>& pubkey) { return CCryptoKeyStore::AddDHTKey(key, pubkey); }
+    bool LoadDHTKey(const CKeyEd25519& key, const std::vector<unsigned char>& pubkey);
     //! Load metadata (used by LoadWallet)
     bool LoadKeyMetadata(const CTxDestination& pubKey, const CKeyMetadata& metadata);
 
@@ -1345,6 +1365,8 @@ public:
     void DeriveNewChildKeyBIP44BychainChildKey(CExtKey& chainChildKey, CKey& secret, bool internal, uint32_t* nInternalChainCounter, uint32_t* nExternalChainCounter);
     // Returns local BDAP DHT Public keys
     bool GetDHTPubKeys(std::vector<std::vector<unsigned char>>& vvchDHTPubKeys) const override;
+    //! Finds the DHT key whose shared link pubkey with vchLinkPubKey is vchSharedPubKey
+    bool GetLinkSharedKey(const std::vector<unsigned char>& vchLinkPubKey, const std::vector<unsigned char>& vchSharedPubKey, CKeyID& keyIDOut, std::vector<unsigned char>& vchMyPubKeyOut);
 
     bool WriteLinkMessageInfo(const uint256& subjectID, const std::vector<unsigned char>& vchPubKey);
     bool EraseLinkMessageInfo(const uint256& subjectID);